@@ -1,98 +1,259 @@
-#include "celero/Celero.h"
+#include <benchmark/benchmark.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
-constexpr int number_of_samples = 10;
-constexpr int number_of_operations = 1;
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
-namespace {
-
-    int run(const std::string &cmd, const std::string &file) {
-        std::string command = cmd + " " + file + " > /dev/null";
-        return system(command.data());
-    }
-} // namespace
-
-std::string mid_file = "3200.txt";
-std::string small_file = "plot_benchmark_results.py";
-
-CELERO_MAIN
-
-BASELINE(small_file, md5sum, number_of_samples, number_of_operations) { ::run("md5sum", small_file); }
+#define XXH_INLINE_ALL
+#include "xxhash.h"
 
-BENCHMARK(small_file, aquahash, number_of_samples, number_of_operations) {
-    ::run("../commands/aquahash", small_file);
-}
-
-BENCHMARK(small_file, xxhash, number_of_samples, number_of_operations) {
-    ::run("../3p/bin/xxhsum", small_file);
-}
+#include "aquahash.h"
+#include "aquahash_policy.h"
+#include "params.h"
+#include "reader.h"
 
-BENCHMARK(small_file, sha1sum, number_of_samples, number_of_operations) { ::run("sha1sum", small_file); }
+namespace {
+    // Test files are written to $BENCHMARK_DIR, or the current folder, and reused by later runs. Use a disk backed
+    // folder since cold cache results are meaningless for tmpfs.
+    std::string test_file(const size_t size) {
+        const char *dir = std::getenv("BENCHMARK_DIR");
+        const std::string path = std::string(dir ? dir : ".") + "/aquahash_" + std::to_string(size) + ".dat";
+        struct stat buf;
+        if ((stat(path.c_str(), &buf) == 0) && (static_cast<size_t>(buf.st_size) == size)) return path;
 
-BENCHMARK(small_file, sha224sum, number_of_samples, number_of_operations) {
-    ::run("sha224sum", small_file);
-}
+        FILE *fp = fopen(path.c_str(), "wb");
+        if (fp == nullptr) {
+            fprintf(stderr, "Cannot create test file: '%s'. Error: %s\n", path.c_str(), strerror(errno));
+            std::exit(EXIT_FAILURE);
+        }
+        std::mt19937_64 rng(size);
+        std::vector<uint64_t> block(1 << 17);
+        for (size_t written = 0; written < size;) {
+            for (auto &value : block) value = rng();
+            const size_t len = std::min(size - written, block.size() * sizeof(uint64_t));
+            if (fwrite(block.data(), 1, len, fp) != len) {
+                fprintf(stderr, "Cannot write test file: '%s'. Error: %s\n", path.c_str(), strerror(errno));
+                std::exit(EXIT_FAILURE);
+            }
+            written += len;
+        }
+        // Dirty pages cannot be dropped from the page cache.
+        if ((fflush(fp) != 0) || (fsync(fileno(fp)) != 0) || (fclose(fp) != 0)) {
+            fprintf(stderr, "Cannot flush test file: '%s'. Error: %s\n", path.c_str(), strerror(errno));
+            std::exit(EXIT_FAILURE);
+        }
+        return path;
+    }
 
-BENCHMARK(small_file, sha256sum, number_of_samples, number_of_operations) {
-    ::run("sha256sum", small_file);
-}
+    void drop_page_cache(const std::string &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
 
-BENCHMARK(small_file, sha384sum, number_of_samples, number_of_operations) {
-    ::run("sha384sum", small_file);
-}
+    void set_counters(benchmark::State &state, const size_t size) {
+        state.SetBytesProcessed(state.iterations() * size);
+        state.counters["GB"] = benchmark::Counter(static_cast<double>(state.iterations()) * size / 1e9,
+                                                    benchmark::Counter::kIsRate);
+    }
 
-BENCHMARK(small_file, sha512sum, number_of_samples, number_of_operations) {
-    ::run("sha512sum", small_file);
-}
+    // Read the file without hashing to measure the cost of the reader itself.
+    struct ReadOnlyPolicy {
+        static constexpr size_t BUFFER_SIZE = 1 << 16;
+        explicit ReadOnlyPolicy(const int) {}
+        void process(const char *buffer, const size_t len) { benchmark::DoNotOptimize(buffer[len - 1]); }
+        void finalize(const std::string &) {}
+    };
 
-// Mid file size benchmark
-BASELINE(mid_file, md5sum, number_of_samples, number_of_operations) { ::run("md5sum", mid_file); }
+    struct XXHashPolicy {
+        static constexpr size_t BUFFER_SIZE = 1 << 16;
+        explicit XXHashPolicy(const int) { XXH64_reset(&state, 0); }
+        void process(const char *buffer, const size_t len) { XXH64_update(&state, buffer, len); }
+        void finalize(const std::string &) { benchmark::DoNotOptimize(XXH64_digest(&state)); }
+        XXH64_state_t state;
+    };
 
-BENCHMARK(mid_file, aquahash, number_of_samples, number_of_operations) {
-    ::run("../commands/aquahash", mid_file);
-}
+    // A portable SHA-256 which is the baseline of cryptographic file checksums such as sha256sum.
+    class Sha256 {
+      public:
+        void update(const uint8_t *data, size_t len) {
+            total += len;
+            if (used) {
+                const size_t count = std::min(len, sizeof(buffer) - used);
+                memcpy(buffer + used, data, count);
+                used += count;
+                data += count;
+                len -= count;
+                if (used < sizeof(buffer)) return;
+                compress(buffer);
+                used = 0;
+            }
+            for (; len >= sizeof(buffer); data += sizeof(buffer), len -= sizeof(buffer)) compress(data);
+            memcpy(buffer, data, len);
+            used = len;
+        }
 
-BENCHMARK(mid_file, xxhash, number_of_samples, number_of_operations) {
-    ::run("../3p/bin/xxhsum", mid_file);
-}
+        void digest(uint8_t *out) {
+            const uint64_t bits = total * 8;
+            const uint8_t pad = 0x80;
+            update(&pad, 1);
+            const uint8_t zero = 0;
+            while (used != 56) update(&zero, 1);
+            uint8_t length[8];
+            for (int idx = 0; idx < 8; ++idx) length[idx] = static_cast<uint8_t>(bits >> (56 - 8 * idx));
+            update(length, 8);
+            for (int idx = 0; idx < 32; ++idx) out[idx] = static_cast<uint8_t>(h[idx / 4] >> (24 - 8 * (idx % 4)));
+        }
 
-BENCHMARK(mid_file, sha1sum, number_of_samples, number_of_operations) { ::run("sha1sum", mid_file); }
+      private:
+        uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        uint8_t buffer[64];
+        size_t used = 0;
+        uint64_t total = 0;
 
-BENCHMARK(mid_file, sha224sum, number_of_samples, number_of_operations) { ::run("sha224sum", mid_file); }
+        static uint32_t rotr(const uint32_t x, const int n) { return (x >> n) | (x << (32 - n)); }
 
-BENCHMARK(mid_file, sha256sum, number_of_samples, number_of_operations) { ::run("sha256sum", mid_file); }
+        void compress(const uint8_t *block) {
+            static const uint32_t k[64] = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+                0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+                0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+                0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+                0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+                0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+            uint32_t w[64];
+            for (int idx = 0; idx < 16; ++idx) {
+                w[idx] = (uint32_t(block[4 * idx]) << 24) | (uint32_t(block[4 * idx + 1]) << 16) |
+                         (uint32_t(block[4 * idx + 2]) << 8) | uint32_t(block[4 * idx + 3]);
+            }
+            for (int idx = 16; idx < 64; ++idx) {
+                const uint32_t s0 = rotr(w[idx - 15], 7) ^ rotr(w[idx - 15], 18) ^ (w[idx - 15] >> 3);
+                const uint32_t s1 = rotr(w[idx - 2], 17) ^ rotr(w[idx - 2], 19) ^ (w[idx - 2] >> 10);
+                w[idx] = w[idx - 16] + s0 + w[idx - 7] + s1;
+            }
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+            for (int idx = 0; idx < 64; ++idx) {
+                const uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[idx] + w[idx];
+                const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                hh = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e, h[5] += f, h[6] += g, h[7] += hh;
+        }
+    };
 
-BENCHMARK(mid_file, sha384sum, number_of_samples, number_of_operations) { ::run("sha384sum", mid_file); }
+    struct Sha256Policy {
+        static constexpr size_t BUFFER_SIZE = 1 << 16;
+        explicit Sha256Policy(const int) {}
+        void process(const char *buffer, const size_t len) {
+            sha.update(reinterpret_cast<const uint8_t *>(buffer), len);
+        }
+        void finalize(const std::string &) {
+            uint8_t out[32];
+            sha.digest(out);
+            benchmark::DoNotOptimize(out);
+        }
+        Sha256 sha;
+    };
 
-BENCHMARK(mid_file, sha512sum, number_of_samples, number_of_operations) { ::run("sha512sum", mid_file); }
+    // The reader and its policy are created per run since a policy cannot be reused after finalize.
+    template <typename Policy> bool hash_file(const std::string &path) {
+        std::unique_ptr<aquahash::FileReader<Policy>> reader(
+            new aquahash::FileReader<Policy>(aquahash::Params::QUIET));
+        return (*reader)(path.c_str());
+    }
 
-// Large file
-const std::string large_file = ".database";
+    void file_sizes(benchmark::internal::Benchmark *b) {
+        b->ArgNames({"bytes"})->RangeMultiplier(16)->Range(4 << 10, int64_t(4) << 30)->UseManualTime();
+    }
 
-BASELINE(large_file, md5sum, number_of_samples, number_of_operations) { ::run("md5sum", large_file); }
+    void memory_sizes(benchmark::internal::Benchmark *b) {
+        b->ArgNames({"bytes"})->RangeMultiplier(16)->Range(4 << 10, 256 << 20);
+    }
+} // namespace
 
-BENCHMARK(large_file, aquahash, number_of_samples, number_of_operations) {
-    ::run("../commands/aquahash", large_file);
+// Files are read through the page cache, which is populated by a first untimed run.
+template <typename Policy> void warm_cache(benchmark::State &state) {
+    const size_t size = state.range(0);
+    const std::string path = test_file(size);
+    hash_file<Policy>(path);
+    for (auto _ : state) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        benchmark::DoNotOptimize(hash_file<Policy>(path));
+        const auto stop = std::chrono::high_resolution_clock::now();
+        state.SetIterationTime(std::chrono::duration<double>(stop - start).count());
+    }
+    set_counters(state, size);
 }
 
-BENCHMARK(large_file, xxhash, number_of_samples, number_of_operations) {
-    ::run("../3p/bin/xxhsum", large_file);
+// Every run reads the file from the storage device.
+template <typename Policy> void cold_cache(benchmark::State &state) {
+    const size_t size = state.range(0);
+    const std::string path = test_file(size);
+    for (auto _ : state) {
+        drop_page_cache(path);
+        const auto start = std::chrono::high_resolution_clock::now();
+        benchmark::DoNotOptimize(hash_file<Policy>(path));
+        const auto stop = std::chrono::high_resolution_clock::now();
+        state.SetIterationTime(std::chrono::duration<double>(stop - start).count());
+    }
+    set_counters(state, size);
 }
 
-BENCHMARK(large_file, sha1sum, number_of_samples, number_of_operations) { ::run("sha1sum", large_file); }
+#define FILE_BENCHMARK(policy)                                                                                         \
+    BENCHMARK_TEMPLATE(warm_cache, policy)->Apply(file_sizes);                                                         \
+    BENCHMARK_TEMPLATE(cold_cache, policy)->Apply(file_sizes)
 
-BENCHMARK(large_file, sha224sum, number_of_samples, number_of_operations) {
-    ::run("sha224sum", large_file);
-}
+FILE_BENCHMARK(ReadOnlyPolicy);
+FILE_BENCHMARK(aquahash::AquaHashPolicy);
+FILE_BENCHMARK(XXHashPolicy);
+FILE_BENCHMARK(Sha256Policy);
 
-BENCHMARK(large_file, sha256sum, number_of_samples, number_of_operations) {
-    ::run("sha256sum", large_file);
+// Hash cost without the reader. The difference from the warm cache results is the reader overhead.
+void aquahash_memory(benchmark::State &state) {
+    const std::vector<uint8_t> data(state.range(0), 'a');
+    for (auto _ : state) benchmark::DoNotOptimize(AquaHash::Hash(data.data(), data.size()));
+    set_counters(state, data.size());
 }
+BENCHMARK(aquahash_memory)->Apply(memory_sizes);
 
-BENCHMARK(large_file, sha384sum, number_of_samples, number_of_operations) {
-    ::run("sha384sum", large_file);
+void xxhash_memory(benchmark::State &state) {
+    const std::vector<uint8_t> data(state.range(0), 'a');
+    for (auto _ : state) benchmark::DoNotOptimize(XXH64(data.data(), data.size(), 0));
+    set_counters(state, data.size());
 }
+BENCHMARK(xxhash_memory)->Apply(memory_sizes);
 
-BENCHMARK(large_file, sha512sum, number_of_samples, number_of_operations) {
-    ::run("sha512sum", large_file);
+void sha256_memory(benchmark::State &state) {
+    const std::vector<uint8_t> data(state.range(0), 'a');
+    for (auto _ : state) {
+        Sha256 sha;
+        uint8_t out[32];
+        sha.update(data.data(), data.size());
+        sha.digest(out);
+        benchmark::DoNotOptimize(out);
+    }
+    set_counters(state, data.size());
 }
+BENCHMARK(sha256_memory)->Apply(memory_sizes);
 
+BENCHMARK_MAIN();
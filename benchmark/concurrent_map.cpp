@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "aquahash.h"
+#include "concurrent_map.h"
+#include "interface.h"
+#include "utils.h"
+
+namespace {
+    constexpr int NUMBER_OF_KEYS = 1 << 20;
+
+    std::vector<std::string> create_test_data() {
+        aquahash::CharGenerator gen;
+        std::vector<std::string> keys;
+        keys.reserve(2 * NUMBER_OF_KEYS);
+        for (int idx = 0; idx < 2 * NUMBER_OF_KEYS; ++idx) keys.push_back(gen(16 + idx % 48));
+        return keys;
+    }
+
+    // The first half of the keys is loaded up front and the second half is used by the insert operations.
+    const std::vector<std::string> keys = create_test_data();
+
+    struct LockedMap {
+        LockedMap() {
+            for (int idx = 0; idx < NUMBER_OF_KEYS; ++idx) data.emplace(keys[idx], idx);
+        }
+        bool find(const std::string &key, int &value) {
+            std::lock_guard<std::mutex> guard(mutex);
+            auto it = data.find(key);
+            if (it == data.end()) return false;
+            value = it->second;
+            return true;
+        }
+        bool insert(const std::string &key, int value) {
+            std::lock_guard<std::mutex> guard(mutex);
+            return data.emplace(key, value).second;
+        }
+        std::mutex mutex;
+        std::unordered_map<std::string, int, aquahash::hash<std::string>> data;
+    };
+
+    struct ShardedMap : aquahash::concurrent_map<std::string, int> {
+        ShardedMap() : aquahash::concurrent_map<std::string, int>(256) {
+            for (int idx = 0; idx < NUMBER_OF_KEYS; ++idx) insert(keys[idx], idx);
+        }
+    };
+
+    // Every thread works on its own slice of the keys and performs one insert per 16 lookups.
+    template <typename Map> void run(benchmark::State &state, Map &map) {
+        const int slice = NUMBER_OF_KEYS / state.threads();
+        const int begin = state.thread_index() * slice;
+        int idx = 0;
+        int value = 0;
+        for (auto _ : state) {
+            const int pos = begin + (idx++ % slice);
+            if ((idx & 15) == 0) {
+                benchmark::DoNotOptimize(map.insert(keys[NUMBER_OF_KEYS + pos], pos));
+            } else {
+                benchmark::DoNotOptimize(map.find(keys[pos], value));
+            }
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+} // namespace
+
+void std_unordered_map_mutex(benchmark::State &state) {
+    static LockedMap map;
+    run(state, map);
+}
+BENCHMARK(std_unordered_map_mutex)->ThreadRange(1, std::thread::hardware_concurrency())->UseRealTime();
+
+void aquahash_concurrent_map(benchmark::State &state) {
+    static ShardedMap map;
+    run(state, map);
+}
+BENCHMARK(aquahash_concurrent_map)->ThreadRange(1, std::thread::hardware_concurrency())->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,108 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+#include "aquahash.h"
+#include "consistent_hash.h"
+#include "interface.h"
+#include "utils.h"
+
+namespace {
+    constexpr int NUMBER_OF_KEYS = 1 << 16;
+
+    std::vector<std::string> create_keys() {
+        aquahash::CharGenerator gen;
+        std::vector<std::string> keys;
+        for (int idx = 0; idx < NUMBER_OF_KEYS; ++idx) keys.push_back(gen(24));
+        return keys;
+    }
+
+    std::vector<std::string> create_names(const size_t n) {
+        std::vector<std::string> names;
+        for (size_t idx = 0; idx < n; ++idx) names.push_back("cache-node-" + std::to_string(idx));
+        return names;
+    }
+
+    const std::vector<std::string> keys = create_keys();
+
+    aquahash::Rendezvous create_rendezvous(const size_t n) {
+        aquahash::Rendezvous hrw;
+        for (auto const &name : create_names(n)) hrw.add(name);
+        return hrw;
+    }
+
+    // Report the fraction of keys whose node changes when one node joins or leaves.
+    template <typename First, typename Second> double moved_keys(const First &before, const Second &after) {
+        size_t moved = 0;
+        for (auto const &key : keys) moved += before(key) != after(key);
+        return static_cast<double>(moved) / keys.size();
+    }
+} // namespace
+
+// Every routing decision includes hashing the key.
+void jump_hash(benchmark::State &state) {
+    const int32_t n = state.range(0);
+    size_t idx = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(aquahash::jump_hash(aquahash::digest_of(keys[idx++ % NUMBER_OF_KEYS]), n));
+    }
+    state.SetItemsProcessed(state.iterations());
+    auto before = [n](const std::string &key) { return aquahash::jump_hash(aquahash::digest_of(key), n); };
+    auto after = [n](const std::string &key) { return aquahash::jump_hash(aquahash::digest_of(key), n + 1); };
+    state.counters["moved_join"] = moved_keys(before, after);
+
+    // Only the last bucket can leave.
+    auto smaller = [n](const std::string &key) { return aquahash::jump_hash(aquahash::digest_of(key), n - 1); };
+    state.counters["moved_leave"] = moved_keys(before, smaller);
+}
+BENCHMARK(jump_hash)->RangeMultiplier(4)->Range(4, 1024);
+
+void rendezvous(benchmark::State &state) {
+    const size_t n = state.range(0);
+    const auto hrw = create_rendezvous(n);
+    size_t idx = 0;
+    for (auto _ : state) benchmark::DoNotOptimize(hrw(keys[idx++ % NUMBER_OF_KEYS]));
+    state.SetItemsProcessed(state.iterations());
+    auto larger = create_rendezvous(n);
+    larger.add("new-node");
+    state.counters["moved_join"] = moved_keys(hrw, larger);
+
+    // A node in the middle leaves, so later nodes shift down by one index.
+    const size_t removed = n / 2;
+    auto smaller = create_rendezvous(n);
+    smaller.remove(removed);
+    auto after = [&smaller, removed](const std::string &key) {
+        const size_t node = smaller(key);
+        return node < removed ? node : node + 1;
+    };
+    state.counters["moved_leave"] = moved_keys(hrw, after);
+}
+BENCHMARK(rendezvous)->RangeMultiplier(4)->Range(4, 1024);
+
+void maglev(benchmark::State &state) {
+    const size_t n = state.range(0);
+    auto names = create_names(n);
+    const aquahash::Maglev table(names);
+    size_t idx = 0;
+    for (auto _ : state) benchmark::DoNotOptimize(table(keys[idx++ % NUMBER_OF_KEYS]));
+    state.SetItemsProcessed(state.iterations());
+
+    // Node indexes are positions in the name list so new nodes are appended.
+    names.push_back("new-node");
+    const aquahash::Maglev larger(names);
+    state.counters["moved_join"] = moved_keys(table, larger);
+
+    // A node in the middle leaves, so later nodes shift down by one index.
+    names.pop_back();
+    const int32_t removed = static_cast<int32_t>(n / 2);
+    names.erase(names.begin() + removed);
+    const aquahash::Maglev smaller(names);
+    auto after = [&smaller, removed](const std::string &key) {
+        const int32_t node = smaller(key);
+        return node < removed ? node : node + 1;
+    };
+    state.counters["moved_leave"] = moved_keys(table, after);
+}
+BENCHMARK(maglev)->RangeMultiplier(4)->Range(4, 1024);
+
+BENCHMARK_MAIN();
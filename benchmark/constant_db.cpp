@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "constant_db.h"
+
+namespace {
+    constexpr size_t NUMBER_OF_KEYS = 4 << 20;
+
+    std::string key_of(const size_t idx) { return "user:" + std::to_string(idx * 7919); }
+
+    // Build a database of 4M keys with 32-byte values once and return its path.
+    const std::string &database() {
+        static const std::string path = [] {
+            const std::string output = "/tmp/aquahash_constant_db_" + std::to_string(::getpid()) + ".cdb";
+            aquahash::ConstantDBBuilder builder;
+            builder.open(output);
+            const std::string value(32, 'v');
+            for (size_t idx = 0; idx < NUMBER_OF_KEYS; ++idx) builder.add(key_of(idx), value);
+            builder.finish();
+            return output;
+        }();
+        return path;
+    }
+
+    std::vector<std::string> random_queries(const size_t n) {
+        std::mt19937 gen(48);
+        std::vector<std::string> queries;
+        for (size_t idx = 0; idx < n; ++idx) queries.push_back(key_of(gen() % NUMBER_OF_KEYS));
+        return queries;
+    }
+} // namespace
+
+void build(benchmark::State &state) {
+    const std::string output = database() + ".build";
+    const std::string value(32, 'v');
+    for (auto _ : state) {
+        aquahash::ConstantDBBuilder builder(state.range(0));
+        builder.open(output);
+        for (size_t idx = 0; idx < NUMBER_OF_KEYS; ++idx) builder.add(key_of(idx), value);
+        benchmark::DoNotOptimize(builder.finish());
+    }
+    ::unlink(output.data());
+    state.SetItemsProcessed(state.iterations() * NUMBER_OF_KEYS);
+}
+BENCHMARK(build)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void open(benchmark::State &state) {
+    const std::string &path = database();
+    for (auto _ : state) {
+        aquahash::ConstantDB db;
+        benchmark::DoNotOptimize(db.open(path));
+    }
+}
+BENCHMARK(open);
+
+void find(benchmark::State &state) {
+    aquahash::ConstantDB db;
+    db.open(database());
+    const auto queries = random_queries(1 << 16);
+    for (auto _ : state) {
+        size_t found = 0;
+        for (auto const &key : queries) found += db.find(key).found();
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(find);
+
+void find_batch(benchmark::State &state) {
+    aquahash::ConstantDB db;
+    db.open(database());
+    const auto queries = random_queries(1 << 16);
+    std::vector<aquahash::ConstantDB::Value> values(queries.size());
+    for (auto _ : state) {
+        db.find(queries, values.data());
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(find_batch);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    ::unlink(database().data());
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "aquahash.h"
+
+namespace {
+    // Page aligned buffers like a receive ring and its destination.
+    struct Buffers {
+        explicit Buffers(const size_t len)
+            : src(static_cast<uint8_t *>(aligned_alloc(4096, len)), &free),
+              dst(static_cast<uint8_t *>(aligned_alloc(4096, len)), &free) {
+            for (size_t idx = 0; idx < len; ++idx) src.get()[idx] = static_cast<uint8_t>(idx * 31 + 7);
+            memset(dst.get(), 0, len);
+        }
+
+        std::unique_ptr<uint8_t, decltype(&free)> src;
+        std::unique_ptr<uint8_t, decltype(&free)> dst;
+    };
+
+    // From payloads which stay in the L1 cache to copies which are much larger than the last level cache.
+    void payload_sizes(benchmark::internal::Benchmark *b) { b->RangeMultiplier(8)->Range(1 << 10, 1 << 25); }
+} // namespace
+
+// The baseline: copy first, then hash the copy in a second pass.
+void memcpy_then_hash(benchmark::State &state) {
+    const size_t len = state.range(0);
+    Buffers buffers(len);
+    for (auto _ : state) {
+        memcpy(buffers.dst.get(), buffers.src.get(), len);
+        benchmark::DoNotOptimize(AquaHash::Hash(buffers.dst.get(), len));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(memcpy_then_hash)->Apply(payload_sizes);
+
+void copy_and_hash(benchmark::State &state) {
+    const size_t len = state.range(0);
+    Buffers buffers(len);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(AquaHash::CopyAndHash(buffers.dst.get(), buffers.src.get(), len));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(copy_and_hash)->Apply(payload_sizes);
+
+void copy_and_hash_non_temporal(benchmark::State &state) {
+    const size_t len = state.range(0);
+    Buffers buffers(len);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            AquaHash::CopyAndHash(buffers.dst.get(), buffers.src.get(), len, _mm_setzero_si128(), true));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(copy_and_hash_non_temporal)->Apply(payload_sizes);
+
+// Incremental copies of 1500-byte packets.
+void copy_and_update(benchmark::State &state) {
+    constexpr size_t PACKET = 1500;
+    const size_t len = state.range(0);
+    Buffers buffers(len);
+    for (auto _ : state) {
+        AquaHash hasher;
+        for (size_t pos = 0; pos < len; pos += PACKET) {
+            const size_t bytes = std::min(PACKET, len - pos);
+            hasher.CopyAndUpdate(buffers.dst.get() + pos, buffers.src.get() + pos, bytes);
+        }
+        benchmark::DoNotOptimize(hasher.Finalize());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(copy_and_update)->Apply(payload_sizes);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "delta.h"
+
+namespace {
+    struct NullWriter {
+        bool write(const void *, const size_t) { return true; }
+    };
+
+    std::vector<uint8_t> random_bytes(const size_t len, const uint64_t seed) {
+        std::mt19937_64 gen(seed);
+        std::vector<uint8_t> data(len);
+        for (auto &c : data) c = static_cast<uint8_t>(gen());
+        return data;
+    }
+
+    constexpr size_t FILE_SIZE = 64 << 20;
+
+    const std::vector<uint8_t> &old_file() {
+        static const std::vector<uint8_t> data = random_bytes(FILE_SIZE, 1);
+        return data;
+    }
+
+    void delta(benchmark::State &state, const std::vector<uint8_t> &new_data) {
+        aquahash::Signature sig;
+        sig.compute(old_file().data(), old_file().size(), state.range(0));
+        NullWriter writer;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(aquahash::compute_delta(sig, new_data.data(), new_data.size(), writer));
+        }
+        state.SetBytesProcessed(state.iterations() * new_data.size());
+    }
+} // namespace
+
+void weak_checksum(benchmark::State &state) {
+    const auto data = random_bytes(state.range(0), 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(aquahash::weak_checksum(data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(weak_checksum)->RangeMultiplier(4)->Range(512, 1 << 16);
+
+void rolling_checksum(benchmark::State &state) {
+    const auto data = random_bytes(1 << 20, 3);
+    const size_t window = 4096;
+    for (auto _ : state) {
+        aquahash::RollingChecksum checksum(data.data(), window);
+        for (size_t pos = 0; pos + window < data.size(); ++pos) checksum.roll(data[pos], data[pos + window]);
+        benchmark::DoNotOptimize(checksum.value());
+    }
+    state.SetBytesProcessed(state.iterations() * (data.size() - window));
+}
+BENCHMARK(rolling_checksum);
+
+// Every block of the new file is found at the position where the previous match ended.
+void delta_identical(benchmark::State &state) { delta(state, old_file()); }
+BENCHMARK(delta_identical)->Arg(1024)->Arg(4096)->Arg(65536)->Unit(benchmark::kMillisecond);
+
+// One inserted byte every 1MB, so the weak checksum is rolled after every edit until blocks match again.
+void delta_shifted(benchmark::State &state) {
+    static const std::vector<uint8_t> new_data = [] {
+        std::vector<uint8_t> data;
+        const auto &old_data = old_file();
+        for (size_t pos = 0; pos < old_data.size(); pos += 1 << 20) {
+            data.push_back('x');
+            data.insert(data.end(), old_data.begin() + pos, old_data.begin() + pos + (1 << 20));
+        }
+        return data;
+    }();
+    delta(state, new_data);
+}
+BENCHMARK(delta_shifted)->Arg(1024)->Arg(4096)->Arg(65536)->Unit(benchmark::kMillisecond);
+
+// The worst case: the weak checksum is rolled over every byte and nothing matches.
+void delta_unrelated(benchmark::State &state) {
+    static const std::vector<uint8_t> new_data = random_bytes(FILE_SIZE, 4);
+    delta(state, new_data);
+}
+BENCHMARK(delta_unrelated)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,78 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "aquahash.h"
+#include "hash_join.h"
+#include "interface.h"
+#include "utils.h"
+
+namespace {
+    // Keys are drawn from a pool so both sides have duplicates and the probe side has misses.
+    std::vector<std::string> create_keys(const size_t n, const size_t distinct, const size_t seed) {
+        aquahash::CharGenerator gen;
+        std::vector<std::string> pool;
+        for (size_t idx = 0; idx < distinct; ++idx) pool.push_back(gen(16));
+        std::vector<std::string> keys;
+        for (size_t idx = 0; idx < n; ++idx) keys.push_back(pool[(idx * 2654435761ULL + seed) % distinct]);
+        return keys;
+    }
+
+    using Table = std::unordered_multimap<std::string, uint64_t, aquahash::hash<std::string>>;
+} // namespace
+
+void unordered_map_join(benchmark::State &state) {
+    const size_t n = state.range(0);
+    const auto build = create_keys(n, n / 2, 0), probe = create_keys(2 * n, n, 1);
+    for (auto _ : state) {
+        Table table(build.size());
+        for (size_t idx = 0; idx < build.size(); ++idx) table.emplace(build[idx], idx);
+        size_t matches = 0;
+        for (auto const &key : probe) {
+            auto range = table.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) ++matches;
+        }
+        benchmark::DoNotOptimize(matches);
+    }
+    state.SetItemsProcessed(state.iterations() * (build.size() + probe.size()));
+}
+BENCHMARK(unordered_map_join)->RangeMultiplier(8)->Range(1 << 14, 1 << 23)->Unit(benchmark::kMillisecond);
+
+void radix_join(benchmark::State &state) {
+    const size_t n = state.range(0);
+    const size_t threads = state.range(1);
+    const auto build = create_keys(n, n / 2, 0), probe = create_keys(2 * n, n, 1);
+    for (auto _ : state) benchmark::DoNotOptimize(aquahash::hash_join(build, probe, threads).size());
+    state.SetItemsProcessed(state.iterations() * (build.size() + probe.size()));
+}
+BENCHMARK(radix_join)
+    ->ArgsProduct({benchmark::CreateRange(1 << 14, 1 << 23, 8), {1, 4, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+void unordered_map_group_by(benchmark::State &state) {
+    const size_t n = state.range(0);
+    const auto keys = create_keys(n, n / 8, 0);
+    for (auto _ : state) {
+        std::unordered_map<std::string, uint64_t, aquahash::hash<std::string>> counts;
+        for (auto const &key : keys) ++counts[key];
+        benchmark::DoNotOptimize(counts.size());
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(unordered_map_group_by)->RangeMultiplier(8)->Range(1 << 14, 1 << 23)->Unit(benchmark::kMillisecond);
+
+void radix_group_by(benchmark::State &state) {
+    const size_t n = state.range(0);
+    const size_t threads = state.range(1);
+    const auto keys = create_keys(n, n / 8, 0);
+    for (auto _ : state) benchmark::DoNotOptimize(aquahash::group_by_count(keys, threads).size());
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(radix_group_by)
+    ->ArgsProduct({benchmark::CreateRange(1 << 14, 1 << 23, 8), {1, 4, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,51 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <string>
+
+#include "aquahash.h"
+#include "utils.h"
+
+namespace {
+    void arguments(benchmark::internal::Benchmark *b) {
+        for (const int len : {8, 16, 32, 48}) {
+            for (const int k : {2, 4, 8, 16}) b->Args({len, k});
+        }
+    }
+
+    constexpr size_t MAX_SEEDS = 16;
+
+    void create_seeds(__m128i *seeds) {
+        for (size_t j = 0; j < MAX_SEEDS; ++j) seeds[j] = _mm_set_epi64x(j * 0x9e3779b97f4a7c15ULL, j + 1);
+    }
+} // namespace
+
+// The baseline: one Hash call per seed.
+void separate_calls(benchmark::State &state) {
+    const std::string key = aquahash::CharGenerator()(state.range(0));
+    const size_t k = state.range(1);
+    __m128i seeds[MAX_SEEDS], hashes[MAX_SEEDS];
+    create_seeds(seeds);
+    for (auto _ : state) {
+        for (size_t j = 0; j < k; ++j) {
+            hashes[j] = AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.data()), key.size(), seeds[j]);
+        }
+        benchmark::DoNotOptimize(hashes);
+    }
+    state.SetItemsProcessed(state.iterations() * k);
+}
+BENCHMARK(separate_calls)->Apply(arguments);
+
+void hash_multi(benchmark::State &state) {
+    const std::string key = aquahash::CharGenerator()(state.range(0));
+    const size_t k = state.range(1);
+    __m128i seeds[MAX_SEEDS], hashes[MAX_SEEDS];
+    create_seeds(seeds);
+    for (auto _ : state) {
+        AquaHash::HashMulti(reinterpret_cast<const uint8_t *>(key.data()), key.size(), seeds, k, hashes);
+        benchmark::DoNotOptimize(hashes);
+    }
+    state.SetItemsProcessed(state.iterations() * k);
+}
+BENCHMARK(hash_multi)->Apply(arguments);
+
+BENCHMARK_MAIN();
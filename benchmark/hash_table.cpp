@@ -1,22 +1,205 @@
+#include "boost/container_hash/hash.hpp"
+#include <algorithm>
 #include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
 #include "aquahash.h"
 #include "interface.h"
+#include "utils.h"
+#include "wyhash.h"
+
+namespace {
+    // Key shapes seen in real tables: short identifiers (column names, symbols) and long URLs.
+    enum Shape : int { IDENTIFIER = 0, URL = 1 };
+
+    constexpr size_t NUMBER_OF_QUERIES = 1 << 16;
+    constexpr double ZIPF_EXPONENT = 0.99;
+
+    // Identifier lengths follow a geometric distribution starting at 4 bytes with a mean of about 10 bytes. URLs
+    // have a host, one to five path segments and an optional query string, which gives 30 to 120 bytes.
+    class KeyGenerator {
+      public:
+        KeyGenerator(const Shape shape, const uint64_t seed) : shape(shape), rng(seed) {}
+
+        std::string operator()() { return shape == IDENTIFIER ? identifier() : url(); }
+
+      private:
+        Shape shape;
+        std::mt19937_64 rng;
+        aquahash::CharGenerator gen;
+
+        size_t uniform(const size_t low, const size_t high) {
+            return std::uniform_int_distribution<size_t>(low, high)(rng);
+        }
+
+        std::string identifier() {
+            const size_t len = 4 + std::min<size_t>(std::geometric_distribution<size_t>(0.15)(rng), 36);
+            return gen(len);
+        }
+
+        std::string url() {
+            std::string key = "https://www." + gen(uniform(4, 12)) + ".com";
+            const size_t segments = uniform(1, 5);
+            for (size_t idx = 0; idx < segments; ++idx) key += "/" + gen(uniform(3, 16));
+            if (uniform(0, 1)) key += "?id=" + std::to_string(rng() % 1000000);
+            return key;
+        }
+    };
+
+    // Distinct keys stored in a table, a pool of keys that are not in the table and a query stream.
+    struct Workload {
+        std::vector<std::string> keys;
+        std::vector<std::string> misses;
+    };
+
+    const Workload &get_workload(const Shape shape, const size_t size) {
+        static std::map<std::pair<int, size_t>, Workload> workloads;
+        auto it = workloads.find(std::make_pair(shape, size));
+        if (it != workloads.end()) return it->second;
+
+        Workload &workload = workloads[std::make_pair(shape, size)];
+        std::unordered_set<std::string> seen;
+        KeyGenerator gen(shape, size);
+        while (workload.keys.size() < size) {
+            std::string key = gen();
+            if (seen.insert(key).second) workload.keys.push_back(std::move(key));
+        }
+        while (workload.misses.size() < std::min(size, NUMBER_OF_QUERIES)) {
+            std::string key = gen();
+            if (seen.insert(key).second) workload.misses.push_back(std::move(key));
+        }
+        return workload;
+    }
+
+    // Zipf distributed lookups of stored keys mixed with a given percentage of misses.
+    std::vector<const std::string *> create_queries(const Workload &workload, const int miss_percent) {
+        std::vector<double> cdf(workload.keys.size());
+        double sum = 0;
+        for (size_t idx = 0; idx < cdf.size(); ++idx) {
+            sum += 1.0 / std::pow(static_cast<double>(idx + 1), ZIPF_EXPONENT);
+            cdf[idx] = sum;
+        }
+
+        std::mt19937_64 rng(miss_percent);
+        std::uniform_real_distribution<double> uniform(0, sum);
+        std::vector<const std::string *> queries;
+        for (size_t idx = 0; idx < NUMBER_OF_QUERIES; ++idx) {
+            if (static_cast<int>(rng() % 100) < miss_percent) {
+                queries.push_back(&workload.misses[rng() % workload.misses.size()]);
+            } else {
+                const size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+                queries.push_back(&workload.keys[std::min(rank, cdf.size() - 1)]);
+            }
+        }
+        return queries;
+    }
+
+    struct XXHash {
+        size_t operator()(const std::string &key) const noexcept { return XXH64(key.data(), key.size(), 0); }
+    };
+
+    struct WyHash {
+        size_t operator()(const std::string &key) const noexcept { return wyhash(key.data(), key.size(), 0); }
+    };
+
+    // Table sizes are chosen so tables fit in L1, L2, L3 and DRAM respectively.
+    void lookup_arguments(benchmark::internal::Benchmark *b) {
+        b->ArgNames({"shape", "keys", "miss%"});
+        for (const int shape : {IDENTIFIER, URL}) {
+            for (const int size : {1 << 8, 1 << 12, 1 << 16, 1 << 20}) {
+                for (const int miss_percent : {0, 50, 90}) b->Args({shape, size, miss_percent});
+            }
+        }
+    }
+
+    void build_arguments(benchmark::internal::Benchmark *b) {
+        b->ArgNames({"shape", "keys"});
+        for (const int shape : {IDENTIFIER, URL}) {
+            for (const int size : {1 << 8, 1 << 12, 1 << 16, 1 << 20}) b->Args({shape, size});
+        }
+    }
+} // namespace
+
+#if defined(__GLIBCXX__)
+// libstdc++ assumes that user defined hash functions are cheap and does not store hash codes in table nodes, so keys
+// are rehashed while walking a bucket. It does store them for std::hash<std::string>, so every hash function gets the
+// same node layout and the tables compare hash functions only.
+namespace std {
+    template <> struct __is_fast_hash<boost::hash<std::string>> : public std::false_type {};
+    template <> struct __is_fast_hash<XXHash> : public std::false_type {};
+    template <> struct __is_fast_hash<WyHash> : public std::false_type {};
+    template <typename T> struct __is_fast_hash<aquahash::hash<T>> : public std::false_type {};
+} // namespace std
+#endif
 
-std::vector<std::string> data;
-std::unordered_set<std::string> std_hash;
-std::unordered_set<std::string, aquahash::hash<std::string>, std::equal_to<std::string>> aquahash;
+// Lookups in an unordered_set, which includes hashing, bucket traversal and key comparisons.
+template <typename Hash> void set_lookup(benchmark::State &state) {
+    const Workload &workload = get_workload(static_cast<Shape>(state.range(0)), state.range(1));
+    const std::unordered_set<std::string, Hash> table(workload.keys.begin(), workload.keys.end());
+    const auto queries = create_queries(workload, state.range(2));
+    for (auto _ : state) {
+        size_t hits = 0;
+        for (auto key : queries) hits += table.count(*key);
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
 
-std:vector<std::string> create_test_data(const int N) {
-    
+// Read-modify-write of a counter stored in an unordered_map, for example counting word frequencies.
+template <typename Hash> void map_update(benchmark::State &state) {
+    const Workload &workload = get_workload(static_cast<Shape>(state.range(0)), state.range(1));
+    std::unordered_map<std::string, uint64_t, Hash> table;
+    for (auto const &key : workload.keys) table.emplace(key, 0);
+    const auto queries = create_queries(workload, state.range(2));
+    for (auto _ : state) {
+        for (auto key : queries) {
+            auto it = table.find(*key);
+            if (it != table.end()) ++it->second;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
 }
 
-void std_hash(benchmark::State &state) {
+// Build a map from scratch including memory allocations and rehashing.
+template <typename Hash> void map_build(benchmark::State &state) {
+    const Workload &workload = get_workload(static_cast<Shape>(state.range(0)), state.range(1));
     for (auto _ : state) {
-        benchmark::DoNotOptimize(h(test_string));
+        std::unordered_map<std::string, uint64_t, Hash> table;
+        for (size_t idx = 0; idx < workload.keys.size(); ++idx) table.emplace(workload.keys[idx], idx);
+        benchmark::DoNotOptimize(table.size());
     }
+    state.SetItemsProcessed(state.iterations() * workload.keys.size());
 }
-BENCHMARK(std_hash);
 
+#if defined(__GLIBCXX__)
+static_assert(std::__cache_default<std::string, boost::hash<std::string>>::value &&
+                  std::__cache_default<std::string, XXHash>::value &&
+                  std::__cache_default<std::string, WyHash>::value &&
+                  std::__cache_default<std::string, aquahash::hash<std::string>>::value &&
+                  std::__cache_default<std::string, std::hash<std::string>>::value,
+              "Every table stores hash codes");
+#endif
 
-BENCHMARK_MAIN();
+#define TABLE_BENCHMARK(hasher)                                                                                        \
+    BENCHMARK_TEMPLATE(set_lookup, hasher)->Apply(lookup_arguments);                                                   \
+    BENCHMARK_TEMPLATE(map_update, hasher)->Apply(lookup_arguments);                                                   \
+    BENCHMARK_TEMPLATE(map_build, hasher)->Apply(build_arguments)->Unit(benchmark::kMicrosecond)
 
+TABLE_BENCHMARK(std::hash<std::string>);
+TABLE_BENCHMARK(boost::hash<std::string>);
+TABLE_BENCHMARK(XXHash);
+TABLE_BENCHMARK(WyHash);
+TABLE_BENCHMARK(aquahash::hash<std::string>);
+
+BENCHMARK_MAIN();
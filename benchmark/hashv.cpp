@@ -0,0 +1,84 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+#include "aquahash.h"
+#include "utils.h"
+
+namespace {
+    // A record made of a 16-byte header, a 24-byte key and a payload which makes up the rest of the total length.
+    struct Record {
+        explicit Record(const size_t len) : data(aquahash::CharGenerator()(len)) {
+            const size_t header = std::min<size_t>(16, len), key = std::min<size_t>(24, len - header);
+            iov[0] = iovec{&data[0], header};
+            iov[1] = iovec{&data[header], key};
+            iov[2] = iovec{&data[header + key], len - header - key};
+        }
+
+        std::string data;
+        struct iovec iov[3];
+    };
+
+    void record_lengths(benchmark::internal::Benchmark *b) { b->Arg(48)->Arg(63)->Arg(64)->Arg(200)->Arg(4096); }
+
+    // Every hash code is the seed of the next call so the benchmarks measure latency.
+    void set_counters(benchmark::State &state, const __m128i seed) {
+        benchmark::DoNotOptimize(seed);
+        state.SetBytesProcessed(state.iterations() * state.range(0));
+        state.SetItemsProcessed(state.iterations());
+    }
+} // namespace
+
+// The baseline: the fields are already contiguous.
+void contiguous(benchmark::State &state) {
+    const Record record(state.range(0));
+    __m128i seed = _mm_setzero_si128();
+    for (auto _ : state) {
+        seed = AquaHash::Hash(reinterpret_cast<const uint8_t *>(record.data.data()), record.data.size(), seed);
+    }
+    set_counters(state, seed);
+}
+BENCHMARK(contiguous)->Apply(record_lengths);
+
+void gather(benchmark::State &state) {
+    const Record record(state.range(0));
+    __m128i seed = _mm_setzero_si128();
+    for (auto _ : state) seed = AquaHash::HashV(record.iov, 3, seed);
+    set_counters(state, seed);
+}
+BENCHMARK(gather)->Apply(record_lengths);
+
+void copy_then_hash(benchmark::State &state) {
+    const Record record(state.range(0));
+    __m128i seed = _mm_setzero_si128();
+    std::vector<uint8_t> buffer(record.data.size());
+    for (auto _ : state) {
+        uint8_t *ptr = buffer.data();
+        for (auto const &field : record.iov) {
+            memcpy(ptr, field.iov_base, field.iov_len);
+            ptr += field.iov_len;
+        }
+        seed = AquaHash::Hash(buffer.data(), buffer.size(), seed);
+    }
+    set_counters(state, seed);
+}
+BENCHMARK(copy_then_hash)->Apply(record_lengths);
+
+void incremental(benchmark::State &state) {
+    const Record record(state.range(0));
+    __m128i seed = _mm_setzero_si128();
+    for (auto _ : state) {
+        AquaHash hasher(seed);
+        for (auto const &field : record.iov) {
+            hasher.Update(static_cast<const uint8_t *>(field.iov_base), field.iov_len);
+        }
+        seed = hasher.Finalize();
+    }
+    set_counters(state, seed);
+}
+BENCHMARK(incremental)->Apply(record_lengths);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+#include "aquahash.h"
+#include "minhash.h"
+#include "utils.h"
+
+namespace {
+    constexpr size_t SHINGLE_WIDTH = 8;
+
+    // A 4KB document gives about 4K shingles.
+    const std::string document = aquahash::CharGenerator()(4096);
+    const size_t number_of_shingles = document.size() - SHINGLE_WIDTH + 1;
+} // namespace
+
+// Multi-lane AES expansion of one AquaHash digest per shingle.
+template <size_t K> void aquahash_minhash(benchmark::State &state) {
+    aquahash::MinHash<K> minhash;
+    for (auto _ : state) {
+        minhash.clear();
+        minhash.add_shingles(reinterpret_cast<const uint8_t *>(document.data()), document.size(), SHINGLE_WIDTH);
+        benchmark::DoNotOptimize(minhash.signature());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["shingles/s"] =
+        benchmark::Counter(state.iterations() * number_of_shingles, benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE(aquahash_minhash, 64);
+BENCHMARK_TEMPLATE(aquahash_minhash, 128);
+BENCHMARK_TEMPLATE(aquahash_minhash, 256);
+
+// The baseline: K seeded AquaHash::Hash calls per shingle.
+template <size_t K> void aquahash_k_seeds(benchmark::State &state) {
+    std::vector<uint32_t> mins(K);
+    for (auto _ : state) {
+        std::fill(mins.begin(), mins.end(), UINT32_MAX);
+        for (size_t pos = 0; pos < number_of_shingles; ++pos) {
+            const uint8_t *shingle = reinterpret_cast<const uint8_t *>(document.data()) + pos;
+            for (size_t idx = 0; idx < K; ++idx) {
+                const uint32_t h = _mm_cvtsi128_si32(AquaHash::Hash(shingle, SHINGLE_WIDTH, _mm_set1_epi32(idx)));
+                mins[idx] = std::min(mins[idx], h);
+            }
+        }
+        benchmark::DoNotOptimize(mins.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["shingles/s"] =
+        benchmark::Counter(state.iterations() * number_of_shingles, benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE(aquahash_k_seeds, 64);
+BENCHMARK_TEMPLATE(aquahash_k_seeds, 128);
+BENCHMARK_TEMPLATE(aquahash_k_seeds, 256);
+
+BENCHMARK_MAIN();
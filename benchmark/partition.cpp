@@ -0,0 +1,48 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+#include "partition.h"
+
+namespace {
+    // A 64MB tab separated file of about 100-byte records with the key in the second field.
+    std::string create_input() {
+        const std::string path = "/tmp/aquahash_partition_" + std::to_string(::getpid()) + ".tsv";
+        std::mt19937 gen(47);
+        std::string data;
+        for (size_t idx = 0; data.size() < (64 << 20); ++idx) {
+            data += std::to_string(idx) + "\tuser" + std::to_string(gen() % 1000000) + "\t" +
+                    std::string(50 + gen() % 60, 'x') + "\n";
+        }
+        FILE *fp = fopen(path.data(), "wb");
+        fwrite(data.data(), 1, data.size(), fp);
+        fclose(fp);
+        return path;
+    }
+} // namespace
+
+// Read, hash the key field and write 16 partitions, which is aquahash --partition 16 --key-field 2.
+void partition_file(benchmark::State &state) {
+    const std::string input = create_input();
+    aquahash::PartitionOptions options;
+    options.partitions = 16;
+    options.key_field = 2;
+    options.threads = state.range(0);
+    size_t bytes = 0;
+    for (auto _ : state) {
+        const int fd = ::open(input.data(), O_RDONLY);
+        aquahash::Partitioner partitioner(options);
+        benchmark::DoNotOptimize(partitioner(fd, input + "."));
+        bytes += ::lseek(fd, 0, SEEK_END);
+        ::close(fd);
+    }
+    for (size_t part = 0; part < options.partitions; ++part) ::unlink((input + "." + std::to_string(part)).data());
+    ::unlink(input.data());
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(partition_file)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -2,100 +2,64 @@
 import argparse
 import matplotlib.pyplot as plt
 import json
+import re
 import numpy as np
 
-def plot_results(prefix, N, YLIM):
-    # Get the benchmark results for each hash functions.
-    std_hash_results = np.zeros(N, dtype=float)
-    boost_hash_results = np.zeros(N, dtype=float)
-    xxhash_results = np.zeros(N, dtype=float)
-    farmhash_results = np.zeros(N, dtype=float)
-    clhash_results = np.zeros(N, dtype=float)
-    aquahash_results = np.zeros(N, dtype=float)
-    aquahash64_results = np.zeros(N, dtype=float)
-    wyhash_results = np.zeros(N, dtype=float)
-    results = np.zeros((N,9), dtype=float);
-    x = np.zeros(N, dtype=float)
-    for idx in range(1, N, 1):
-        data_file = prefix + str(idx) + ".json"
-        x[idx] = idx;
-        col = 0;
-        results[idx - 1][col] = idx;
-        data = json.load(open(data_file))
-        benchmark_results = data["benchmarks"]
-        for info in benchmark_results:
-            benchmark_name = info["name"]
-            value = info["real_time"]
-            if (benchmark_name == "std_hash_string"):
-                std_hash_results[idx] = value
-                col = 1
-            elif (benchmark_name == "boost_hash_string"):
-                boost_hash_results[idx] = value
-                col = 2
-            elif (benchmark_name == "xxhash_string"):
-                xxhash_results[idx] = value
-                col = 3
-            elif (benchmark_name == "farmhash_string"):
-                farmhash_results[idx] = value
-                col = 4
-            elif (benchmark_name == "clhash_string"):
-                clhash_results[idx] = value
-                col = 5
-            elif (benchmark_name == "aquahash_string"):
-                aquahash_results[idx] = value
-                col = 6
-            elif (benchmark_name == "aquahash64_string"):
-                aquahash64_results[idx] = value
-                col = 7
-            elif (benchmark_name == "wyhash_string"):
-                wyhash_results[idx] = value
-                col = 8
-            else:
-                print(f"Unrecognized benchmark_name: '{benchmark_name}'")
+def load_results(data_file, counter):
+    # Benchmark names look like "throughput<AquaHash128>/64".
+    results = {}
+    pattern = re.compile(r"(\w+)<(\w+)>/(\d+)")
+    data = json.load(open(data_file))
+    for info in data["benchmarks"]:
+        match = pattern.match(info["name"])
+        if not match:
+            print(f"Unrecognized benchmark_name: '{info['name']}'")
+            continue
+        mode, hasher, length = match.group(1), match.group(2), int(match.group(3))
+        results.setdefault(mode, {}).setdefault(hasher, []).append((length, info[counter]))
+    return results
 
-            results[idx-1][col] = value;
-
-    # Plot results
-    lines = plt.plot(
-        x, std_hash_results, "r^-",
-        x, boost_hash_results, "bv-",
-        x, xxhash_results, 'kp-',
-        x, farmhash_results, 'y8-',
-        x, clhash_results, 'cs-',
-        x, aquahash_results, 'go-',
-        x, aquahash64_results, 'gx-',
-        x, wyhash_results, 'bo-',
-    )
-    plt.xlabel("String length (bytes)")
-    plt.ylabel("Run time (ns)")
-    plt.ylim(0, YLIM)
-    plt.xlim(1, N)
-    plt.grid()
-    benchmarks = ('std::hash', 'boost::hash', 'xxHash', 'farmhash', 'clhash', 'aquahash', 'aquahash64', "wyhash")
-    plt.legend(lines, benchmarks)
-    plt.title("Hash function performance analysis using random strings");
+def plot_results(results, counter, ylim):
+    modes = sorted(results.keys(), reverse=True)
+    fig, axes = plt.subplots(1, len(modes), figsize=(8 * len(modes), 6), squeeze=False)
+    for ax, mode in zip(axes[0], modes):
+        for hasher, values in sorted(results[mode].items()):
+            values.sort()
+            x = [item[0] for item in values]
+            y = [item[1] for item in values]
+            ax.plot(x, y, "o-", markersize=3, label=hasher)
+        ax.set_xscale("log", base=2)
+        ax.set_xlabel("String length (bytes)")
+        ax.set_ylabel(counter)
+        if ylim > 0:
+            ax.set_ylim(0, ylim)
+        ax.grid()
+        ax.legend()
+        ax.set_title(f"Hash function {mode} using random strings")
     plt.show()
 
-    # Write data to CSV files
-    header_string = "len," + ','.join(benchmarks);
-    np.savetxt("data.csv", results, fmt="%4f", delimiter=',',header=header_string);
+def write_csv(results, counter):
+    # One row per (mode, length) and one column per hash function.
+    for mode, hashers in results.items():
+        names = sorted(hashers.keys())
+        lengths = sorted({item[0] for values in hashers.values() for item in values})
+        table = np.zeros((len(lengths), len(names) + 1), dtype=float)
+        for row, length in enumerate(lengths):
+            table[row][0] = length
+            for col, name in enumerate(names):
+                table[row][col + 1] = dict(hashers[name]).get(length, np.nan)
+        np.savetxt(f"{mode}.csv", table, fmt="%4f", delimiter=',', header="len," + ','.join(names))
 
 # Parse input arguments
 parser = argparse.ArgumentParser(description='Required input arguments.')
-parser.add_argument('prefix', metavar='prefix', type=str,
-                    help='Prefix of JSON data files')
-parser.add_argument('maximum_length', metavar='maximum_length', type=int,
-                    help='The maximum length of tested strings')
-parser.add_argument('ylim', metavar='ylim', type=int,
-                    help='The maximum length of tested strings')
+parser.add_argument('data_file', metavar='data_file', type=str,
+                    help='JSON output of the random_string benchmark')
+parser.add_argument('--counter', type=str, default="cycles/byte",
+                    help='The reported value, for example cycles/byte, bytes/cycle or real_time')
+parser.add_argument('--ylim', type=float, default=0,
+                    help='The upper limit of the y axis')
 
 args = parser.parse_args()
-prefix = args.prefix
-N = args.maximum_length
-ylim = args.ylim
-print("Prefix: ", prefix)
-print("Maximum string length: ", N)
-N = args.maximum_length
-
-# Plot benchmark results
-plot_results(prefix, N, ylim)
+results = load_results(args.data_file, args.counter)
+write_csv(results, args.counter)
+plot_results(results, args.counter, args.ylim)
@@ -1,11 +1,9 @@
 #include "boost/container_hash/hash.hpp"
-#include <algorithm>
 #include <benchmark/benchmark.h>
-#include <iostream>
-#include <iterator>
-#include <random>
-#include <stdexcept>
-#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <x86intrin.h>
 
 #define XXH_INLINE_ALL
 #include "xxhash.h"
@@ -15,77 +13,108 @@
 #include "aquahash.h"
 #include "interface.h"
 #include "utils.h"
-#include "test_utils.h"
 #include "clhash.h"
 #include "wyhash.h"
 
+namespace {
+    // Keys of the same length which are small enough to stay in the L1 cache.
+    constexpr size_t NUMBER_OF_KEYS = 16;
 
-const std::string test_string = generate_random_string();
+    std::vector<std::string> create_keys(const size_t len) {
+        aquahash::CharGenerator gen;
+        std::vector<std::string> keys;
+        for (size_t idx = 0; idx < NUMBER_OF_KEYS; ++idx) keys.push_back(gen(len));
+        return keys;
+    }
 
-// std::hash benchmark
-void std_hash_string(benchmark::State &state) {
-    std::hash<std::string> h;
-    for (auto _ : state) { benchmark::DoNotOptimize(h(test_string)); }
-}
-BENCHMARK(std_hash_string);
+    // rdtsc counts reference cycles, which are core cycles only if frequency scaling and turbo boost are disabled.
+    void set_counters(benchmark::State &state, const uint64_t cycles, const size_t bytes_per_iteration) {
+        const double bytes = static_cast<double>(state.iterations()) * bytes_per_iteration;
+        state.SetBytesProcessed(static_cast<int64_t>(bytes));
+        state.counters["cycles/byte"] = cycles / bytes;
+        state.counters["bytes/cycle"] = bytes / cycles;
+    }
 
-// boost::hash
-void boost_hash_string(benchmark::State &state) {
-    boost::hash<std::string> h;
-    for (auto _ : state) { benchmark::DoNotOptimize(h(test_string)); }
-}
-BENCHMARK(boost_hash_string);
+    struct StdHash {
+        std::hash<std::string> h;
+        uint64_t operator()(const std::string &key) const { return h(key); }
+    };
 
-// xxHash
-void xxhash_string(benchmark::State &state) {
-    unsigned long long const seed = 0;
-    for (auto _ : state) {
-        benchmark::DoNotOptimize(XXH64(test_string.data(), test_string.size(), seed));
-    }
-}
-// Register the function as a benchmark
-BENCHMARK(xxhash_string);
+    struct BoostHash {
+        boost::hash<std::string> h;
+        uint64_t operator()(const std::string &key) const { return h(key); }
+    };
 
-// FarmHash
-void farmhash_string(benchmark::State &state) {
-    for (auto _ : state) {
-        benchmark::DoNotOptimize(util::Hash64(test_string.data(), test_string.size()));
-    }
-}
-BENCHMARK(farmhash_string);
+    struct XXHash {
+        uint64_t operator()(const std::string &key) const { return XXH64(key.data(), key.size(), 0); }
+    };
 
-// clhash benchmark
-void clhash_string(benchmark::State &state) {
-    util::CLHash clhash;
-    for (auto _ : state) {
-        benchmark::DoNotOptimize(clhash(test_string.data(), test_string.size()));
-    }
-}
-BENCHMARK(clhash_string);
+    struct FarmHash {
+        uint64_t operator()(const std::string &key) const { return util::Hash64(key.data(), key.size()); }
+    };
 
-// AquaHash
-const __m128i seed = _mm_setzero_si128();
-void aquahash_string(benchmark::State &state) {
-    for (auto _ : state) {
-        benchmark::DoNotOptimize(AquaHash::Hash((const uint8_t*)test_string.data(), test_string.size(), seed));
+    struct CLHash {
+        util::CLHash clhash;
+        uint64_t operator()(const std::string &key) const { return clhash(key.data(), key.size()); }
+    };
+
+    struct AquaHash128 {
+        uint64_t operator()(const std::string &key) const {
+            return aquahash::low_bits(AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.data()), key.size()));
+        }
+    };
+
+    struct AquaHash64 {
+        aquahash::hash<std::string> h;
+        uint64_t operator()(const std::string &key) const { return h(key); }
+    };
+
+    struct WyHash {
+        uint64_t operator()(const std::string &key) const { return wyhash(key.data(), key.size(), 0); }
+    };
+
+    void key_lengths(benchmark::internal::Benchmark *b) {
+        b->DenseRange(1, 64, 1)->RangeMultiplier(2)->Range(128, 4096);
     }
-}
-BENCHMARK(aquahash_string);
+} // namespace
 
-void aquahash64_string(benchmark::State &state) {
-    aquahash::hash<std::string> h;
+// Independent keys so the CPU overlaps consecutive hash calls.
+template <typename Hasher> void throughput(benchmark::State &state) {
+    const size_t len = state.range(0);
+    const auto keys = create_keys(len);
+    const Hasher hasher{};
+    const uint64_t start = __rdtsc();
     for (auto _ : state) {
-        benchmark::DoNotOptimize(h(test_string));
+        for (auto const &key : keys) benchmark::DoNotOptimize(hasher(key));
     }
+    set_counters(state, __rdtsc() - start, NUMBER_OF_KEYS * len);
+    state.SetItemsProcessed(state.iterations() * NUMBER_OF_KEYS);
 }
-BENCHMARK(aquahash64_string);
 
-void wyhash_string(benchmark::State &state) {
-    uint64_t seed = 0;
-    for (auto _ : state) {
-        benchmark::DoNotOptimize(wyhash(test_string.data(), test_string.size(), seed));
-    }
+// Every hash code selects the next key so a hash call cannot start before the previous one has finished.
+template <typename Hasher> void latency(benchmark::State &state) {
+    const size_t len = state.range(0);
+    const auto keys = create_keys(len);
+    const Hasher hasher{};
+    uint64_t h = 0;
+    const uint64_t start = __rdtsc();
+    for (auto _ : state) h = hasher(keys[h % NUMBER_OF_KEYS]);
+    set_counters(state, __rdtsc() - start, len);
+    state.SetItemsProcessed(state.iterations());
+    benchmark::DoNotOptimize(h);
 }
-BENCHMARK(wyhash_string);
+
+#define HASH_BENCHMARK(hasher)                                                                                         \
+    BENCHMARK_TEMPLATE(throughput, hasher)->Apply(key_lengths);                                                        \
+    BENCHMARK_TEMPLATE(latency, hasher)->Apply(key_lengths)
+
+HASH_BENCHMARK(StdHash);
+HASH_BENCHMARK(BoostHash);
+HASH_BENCHMARK(XXHash);
+HASH_BENCHMARK(FarmHash);
+HASH_BENCHMARK(CLHash);
+HASH_BENCHMARK(AquaHash128);
+HASH_BENCHMARK(AquaHash64);
+HASH_BENCHMARK(WyHash);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "aquahash.h"
+#include "record_policy.h"
+#include "records.h"
+
+namespace {
+    // 64MB of lines whose lengths are uniformly distributed in [len / 2, 3 * len / 2].
+    std::string random_lines(const size_t len) {
+        std::mt19937 gen(len);
+        std::string data;
+        while (data.size() < (64 << 20)) {
+            const size_t n = len / 2 + gen() % (len + 1);
+            for (size_t idx = 0; idx < n; ++idx) data.push_back(static_cast<char>('a' + gen() % 26));
+            data.push_back('\n');
+        }
+        return data;
+    }
+
+    template <typename Function> void for_each_buffer(const std::string &data, Function &&f) {
+        constexpr size_t BUFFER_SIZE = aquahash::RecordPolicy::BUFFER_SIZE;
+        for (size_t pos = 0; pos < data.size(); pos += BUFFER_SIZE) {
+            f(data.data() + pos, std::min(BUFFER_SIZE, data.size() - pos));
+        }
+    }
+
+    void line_lengths(benchmark::internal::Benchmark *b) { b->Arg(16)->Arg(100)->Arg(1000); }
+} // namespace
+
+void split_lines(benchmark::State &state) {
+    const std::string data = random_lines(state.range(0));
+    for (auto _ : state) {
+        aquahash::RecordSplitter splitter;
+        size_t total = 0;
+        auto count = [&total](const char *, const size_t len, const uint64_t) { total += len; };
+        for_each_buffer(data, [&](const char *buffer, const size_t len) { splitter(buffer, len, count); });
+        splitter.finish(count);
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(split_lines)->Apply(line_lengths);
+
+void split_lines_memchr(benchmark::State &state) {
+    const std::string data = random_lines(state.range(0));
+    for (auto _ : state) {
+        size_t total = 0;
+        const char *end = data.data() + data.size();
+        for (const char *ptr = data.data(); ptr < end;) {
+            const char *next = static_cast<const char *>(memchr(ptr, '\n', end - ptr));
+            if (next == nullptr) next = end;
+            total += next - ptr;
+            ptr = next + 1;
+        }
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(split_lines_memchr)->Apply(line_lengths);
+
+// Split lines and write 16-byte hash codes, which is aquahash --per-line --binary without reading the file.
+void hash_lines(benchmark::State &state) {
+    const std::string data = random_lines(state.range(0));
+    aquahash::RecordOptions options;
+    options.binary = true;
+    options.output = fopen("/dev/null", "wb");
+    for (auto _ : state) {
+        aquahash::RecordPolicy policy(options);
+        for_each_buffer(data, [&](const char *buffer, const size_t len) { policy.process(buffer, len); });
+        policy.finalize("");
+    }
+    fclose(options.output);
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(hash_lines)->Apply(line_lengths);
+
+// The same with offsets and hex hash codes.
+void hash_lines_text(benchmark::State &state) {
+    const std::string data = random_lines(state.range(0));
+    aquahash::RecordOptions options;
+    options.output = fopen("/dev/null", "wb");
+    for (auto _ : state) {
+        aquahash::RecordPolicy policy(options);
+        for_each_buffer(data, [&](const char *buffer, const size_t len) { policy.process(buffer, len); });
+        policy.finalize("");
+    }
+    fclose(options.output);
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(hash_lines_text)->Apply(line_lengths);
+
+BENCHMARK_MAIN();
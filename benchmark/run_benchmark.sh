@@ -1,6 +1,6 @@
 #!/bin/bash
-N=$1
-echo "Maximum string length: $N"
+# Collect throughput and latency results of all hash functions for key lengths 1-4096. Extra arguments are passed to
+# the benchmark binary, for example --benchmark_filter='AquaHash'.
 
 # Create output folder if neccesary.
 mkdir -p data
@@ -11,10 +11,6 @@ cmake ./
 make -j5
 
 # Run all benchmark and plot the collected data.
-data_dir="data/$osType/string/"
+data_dir="data/$osType"
 mkdir -p $data_dir
-for idx in `seq 1 1 $N`;
-do
-    LEN=$idx ./random_string --benchmark_format=json --benchmark_out="$data_dir/data_$idx.json"
-done
-
+./random_string --benchmark_format=json --benchmark_out="$data_dir/string.json" "$@"
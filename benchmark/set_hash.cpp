@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "aquahash.h"
+#include "parallel.h"
+#include "set_hash.h"
+
+namespace {
+    // The keys of a partition in the order of one replica.
+    std::vector<std::string> create_keys() {
+        std::vector<std::string> keys;
+        for (size_t idx = 0; idx < (1 << 20); ++idx) keys.push_back("user:" + std::to_string(idx * 7919));
+        std::mt19937 gen(50);
+        std::shuffle(keys.begin(), keys.end(), gen);
+        return keys;
+    }
+} // namespace
+
+// The baseline: sort a copy of the keys and hash them in order.
+void sort_then_hash(benchmark::State &state) {
+    const auto keys = create_keys();
+    for (auto _ : state) {
+        std::vector<const std::string *> sorted;
+        sorted.reserve(keys.size());
+        for (auto const &key : keys) sorted.push_back(&key);
+        std::sort(sorted.begin(), sorted.end(), [](auto lhs, auto rhs) { return *lhs < *rhs; });
+        AquaHash hasher;
+        for (auto key : sorted) {
+            const uint64_t size = key->size();
+            hasher.Update(reinterpret_cast<const uint8_t *>(&size), sizeof(size));
+            hasher.Update(reinterpret_cast<const uint8_t *>(key->data()), key->size());
+        }
+        benchmark::DoNotOptimize(hasher.Finalize());
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(sort_then_hash)->Unit(benchmark::kMillisecond);
+
+void set_hash(benchmark::State &state) {
+    const auto keys = create_keys();
+    const size_t threads = state.range(0), parts = 64;
+    for (auto _ : state) {
+        std::vector<aquahash::SetHash> partial(threads);
+        aquahash::parallel_for(parts, threads, [&](const size_t part, const size_t tid) {
+            const size_t begin = part * keys.size() / parts, end = (part + 1) * keys.size() / parts;
+            for (size_t idx = begin; idx < end; ++idx) partial[tid].add(keys[idx]);
+        });
+        aquahash::SetHash accumulator;
+        for (auto const &item : partial) accumulator.merge(item);
+        benchmark::DoNotOptimize(accumulator.digest());
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(set_hash)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
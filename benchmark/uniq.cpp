@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "mapped_file.h"
+#include "uniq.h"
+
+namespace {
+    // 64MB of about 100-byte lines where every distinct line appears about four times.
+    std::string random_lines() {
+        std::mt19937 gen(46);
+        std::string data;
+        const size_t vocabulary = (64 << 20) / 100 / 4;
+        while (data.size() < (64 << 20)) {
+            const uint32_t word = gen() % vocabulary;
+            std::mt19937 line_gen(word);
+            const size_t n = 50 + line_gen() % 101;
+            for (size_t idx = 0; idx < n; ++idx) data.push_back(static_cast<char>('a' + line_gen() % 26));
+            data.push_back('\n');
+        }
+        return data;
+    }
+
+    void run(benchmark::State &state, const aquahash::UniqOptions &options) {
+        const std::string data = random_lines();
+        for (auto _ : state) {
+            aquahash::FileWriter writer;
+            writer.open("/dev/null");
+            aquahash::Uniq uniq(options);
+            benchmark::DoNotOptimize(uniq(reinterpret_cast<const uint8_t *>(data.data()), data.size(), writer));
+            writer.close();
+        }
+        state.SetBytesProcessed(state.iterations() * data.size());
+    }
+} // namespace
+
+void uniq_in_memory(benchmark::State &state) { run(state, aquahash::UniqOptions()); }
+BENCHMARK(uniq_in_memory);
+
+void uniq_verify(benchmark::State &state) {
+    aquahash::UniqOptions options;
+    options.verify = true;
+    run(state, options);
+}
+BENCHMARK(uniq_verify);
+
+// The digest set is limited to 1MB so almost all lines go through partitions on disk.
+void uniq_partitioned(benchmark::State &state) {
+    aquahash::UniqOptions options;
+    options.memory = 1 << 20;
+    run(state, options);
+}
+BENCHMARK(uniq_partitioned);
+
+BENCHMARK_MAIN();
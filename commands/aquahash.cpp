@@ -15,11 +15,23 @@
 #include "aquahash.h"
 #include "aquahash_policy.h"
 #include "clara.hpp"
+#include "delta.h"
+#include "digest_cache.h"
+#include "digest_client.h"
 #include "interface.h"
 #include "params.h"
+#include "partition.h"
 #include "reader.h"
+#include "record_policy.h"
+#include "stats.h"
+#include "uniq.h"
 #include "utils.h"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <string>
+#include <unistd.h>
+#include <vector>
 
 namespace {
     void disp_version() { printf("%s\n", "aquahash version 1.0"); }
@@ -27,6 +39,280 @@ namespace {
     void usage() {
         printf("\nExamples:\n");
         printf("\taquahash file1 file2 file3:\n");
+        printf("\taquahash --no-cache file1 file2 file3:\n");
+        printf("\taquahash --cache /tmp/digests.cache file1 file2 file3:\n");
+        printf("\taquahash --offset 4096 --length 1048576 file1:\n");
+        printf("\taquahash --sample 64 file1 file2 file3:\n");
+        printf("\taquahash --stats file1 file2 file3 2> stats.json:\n");
+        printf("\taquahash --no-daemon file1 file2 file3:\n");
+        printf("\taquahash --per-line access.log:\n");
+        printf("\taquahash --per-line --delimiter '\\0' --binary records.bin > digests.bin:\n");
+        printf("\taquahash --record-size 512 --binary blocks.bin > digests.bin:\n");
+        printf("\taquahash --uniq --memory 4096 access.log > unique.log:\n");
+        printf("\taquahash --partition 16 --key-field 2 --output users. users.tsv:\n");
+        printf("\tzcat users.tsv.gz | aquahash --partition 16 --key-field 2 --output users. -:\n");
+        printf("\taquahash --signature old.sig old_file:\n");
+        printf("\taquahash --delta old.sig --output file.delta new_file:\n");
+        printf("\taquahash --patch file.delta --output new_file old_file:\n");
+    }
+
+    struct Range {
+        size_t offset = 0;
+        size_t length = 0;
+        size_t windows = 0;
+    };
+
+    // Ask aquahashd for the digests of all files in one batch. Files which the daemon does not know, or all files if
+    // it is not running, are not found.
+    std::vector<aquahash::DigestClient::Reply> query_daemon(const std::string &socket_path,
+                                                            const std::vector<std::string> &files) {
+        std::vector<aquahash::DigestClient::Reply> replies;
+        if (::access(socket_path.data(), F_OK) == 0) {
+            std::vector<std::string> paths(files.size());
+            char buffer[PATH_MAX];
+            for (size_t idx = 0; idx < files.size(); ++idx) {
+                if (::realpath(files[idx].data(), buffer) != nullptr) paths[idx] = buffer;
+            }
+            if (aquahash::DigestClient::query(socket_path, paths, replies)) return replies;
+        }
+        replies.assign(files.size(), aquahash::DigestClient::Reply{0, {0, 0}});
+        return replies;
+    }
+
+    // Compute the hash code of a file unless aquahashd or the digest cache has a digest for the same file metadata.
+    void hash_file(const std::string &file, const int flags, const Range &range, aquahash::DigestCache &cache,
+                   const aquahash::DigestClient::Reply *known, aquahash::Stats *stats) {
+        aquahash::FileReader<aquahash::AquaHashPolicy> hasher(flags);
+        hasher.collect(stats);
+        if (aquahash::Params::sampled(flags)) {
+            hasher.sample(file.data(), range.windows);
+            return;
+        }
+
+        if (range.offset || range.length) {
+            hasher(file.data(), range.offset, range.length);
+            return;
+        }
+
+        if (known != nullptr && known->found) {
+            if (stats) stats->cached = true;
+            hasher.print(_mm_loadu_si128(reinterpret_cast<const __m128i *>(known->digest)), file);
+            return;
+        }
+
+        struct stat before;
+        if (!cache.is_open() || ::stat(file.data(), &before) != 0 || !S_ISREG(before.st_mode)) {
+            hasher(file.data());
+            return;
+        }
+
+        const auto key = aquahash::DigestCache::make_key(before);
+        __m128i digest;
+        if (cache.lookup(key, digest)) {
+            if (stats) stats->cached = true;
+            hasher.print(digest, file);
+            return;
+        }
+
+        // Only cache a digest if the file did not change while we were reading it.
+        struct stat after;
+        if (hasher(file.data()) && aquahash::DigestCache::is_stable(key) && ::stat(file.data(), &after) == 0) {
+            const auto current = aquahash::DigestCache::make_key(after);
+            if (memcmp(&key, &current, sizeof(key)) == 0) cache.insert(key, hasher.digest());
+        }
+    }
+
+    struct DeltaOptions {
+        std::string signature;
+        std::string delta;
+        std::string patch;
+        std::string output;
+        uint32_t block_size = aquahash::Signature::DEFAULT_BLOCK_SIZE;
+        uint32_t strong_bytes = aquahash::Signature::DEFAULT_STRONG_BYTES;
+    };
+
+    // Run --signature, --delta or --patch on the only input file and return the exit code.
+    int run_delta(const DeltaOptions &options, const std::vector<std::string> &files) {
+        if (files.size() != 1) {
+            fprintf(stderr, "--signature, --delta and --patch need exactly one input file\n");
+            return EXIT_FAILURE;
+        }
+        if (options.signature.empty() && options.output.empty()) {
+            fprintf(stderr, "--delta and --patch need an output file\n");
+            return EXIT_FAILURE;
+        }
+
+        aquahash::MappedFile input;
+        if (!input.open(files[0])) {
+            fprintf(stderr, "Cannot open '%s': %s\n", files[0].data(), strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        if (!options.signature.empty()) {
+            aquahash::Signature sig;
+            if (!sig.compute(input.data(), input.size(), options.block_size, options.strong_bytes)) {
+                fprintf(stderr, "Invalid block size or number of strong checksum bytes\n");
+                return EXIT_FAILURE;
+            }
+            if (!sig.save(options.signature)) {
+                fprintf(stderr, "Cannot write the signature to '%s'\n", options.signature.data());
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+
+        // Write to a temporary file next to the output and rename it when it is complete, so a rejected delta does not
+        // leave a partial file behind and the output can be the input file itself.
+        const std::string temp_path = options.output + "." + std::to_string(::getpid()) + ".tmp";
+        aquahash::FileWriter writer;
+        if (!writer.open(temp_path)) {
+            fprintf(stderr, "Cannot create '%s': %s\n", temp_path.data(), strerror(errno));
+            return EXIT_FAILURE;
+        }
+        auto commit = [&writer, &temp_path, &options](const bool ok) {
+            if (writer.close() && ok && ::rename(temp_path.data(), options.output.data()) == 0) return true;
+            ::unlink(temp_path.data());
+            return false;
+        };
+
+        if (!options.delta.empty()) {
+            aquahash::Signature sig;
+            if (!sig.load(options.delta)) {
+                fprintf(stderr, "Invalid signature file: '%s'\n", options.delta.data());
+                commit(false);
+                return EXIT_FAILURE;
+            }
+            if (!commit(aquahash::compute_delta(sig, input.data(), input.size(), writer))) {
+                fprintf(stderr, "Cannot write the delta to '%s'\n", options.output.data());
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+
+        aquahash::MappedFile delta;
+        if (!delta.open(options.patch)) {
+            fprintf(stderr, "Cannot open '%s': %s\n", options.patch.data(), strerror(errno));
+            commit(false);
+            return EXIT_FAILURE;
+        }
+        if (!commit(aquahash::apply_delta(input.data(), input.size(), delta.data(), delta.size(), writer))) {
+            fprintf(stderr, "Cannot apply '%s' to '%s'\n", options.patch.data(), files[0].data());
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Accept a single character or one of the escapes \n, \t, \r and \0.
+    bool parse_delimiter(const std::string &value, char &delimiter) {
+        if (value.size() == 1) {
+            delimiter = value[0];
+            return true;
+        }
+        if (value.size() != 2 || value[0] != '\\') return false;
+        switch (value[1]) {
+        case 'n':
+            delimiter = '\n';
+            return true;
+        case 't':
+            delimiter = '\t';
+            return true;
+        case 'r':
+            delimiter = '\r';
+            return true;
+        case '0':
+            delimiter = 0;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Hash every record of a file.
+    bool hash_records(const std::string &file, const aquahash::RecordOptions &options, aquahash::Stats *stats) {
+        aquahash::FileReader<aquahash::RecordPolicy> reader(options);
+        reader.collect(stats);
+        const bool ok = reader(file.data());
+        if (!reader.good()) {
+            fprintf(stderr, "Cannot write the hash codes of records: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        return ok;
+    }
+
+    // Write the unique records of the only input file to stdout and return the exit code.
+    int run_uniq(const aquahash::UniqOptions &options, const std::vector<std::string> &files, const bool verbose) {
+        if (files.size() != 1) {
+            fprintf(stderr, "--uniq needs exactly one input file\n");
+            return EXIT_FAILURE;
+        }
+
+        aquahash::MappedFile input;
+        if (!input.open(files[0])) {
+            fprintf(stderr, "Cannot open '%s': %s\n", files[0].data(), strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        aquahash::FileWriter writer;
+        writer.attach(STDOUT_FILENO);
+        aquahash::Uniq uniq(options);
+        const bool ok = uniq(input.data(), input.size(), writer);
+        if (!writer.close() || !ok) {
+            fprintf(stderr, "Cannot write the unique records of '%s': %s\n", files[0].data(), strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "{\"records\":%zu,\"unique\":%zu,\"partitions\":%zu}\n", uniq.number_of_records(),
+                    uniq.number_of_unique_records(), uniq.number_of_partitions());
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Split the records of the only input file, or stdin if it is '-', into prefix0 ... prefixN-1 and return the exit
+    // code. The prefix defaults to the input file name and a dot.
+    int run_partition(const aquahash::PartitionOptions &options, const std::vector<std::string> &files,
+                      std::string prefix, const bool verbose) {
+        if (files.size() != 1) {
+            fprintf(stderr, "--partition needs exactly one input file\n");
+            return EXIT_FAILURE;
+        }
+
+        const bool use_stdin = files[0] == "-";
+        if (prefix.empty()) prefix = (use_stdin ? "stdin" : files[0]) + ".";
+        const int fd = use_stdin ? STDIN_FILENO : ::open(files[0].data(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "Cannot open '%s': %s\n", files[0].data(), strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        aquahash::Partitioner partitioner(options);
+        const bool ok = partitioner(fd, prefix);
+        if (!use_stdin) ::close(fd);
+        if (!ok) {
+            fprintf(stderr, "Cannot partition '%s' into '%s*': %s\n", files[0].data(), prefix.data(), strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "{\"records\":%zu,\"partitions\":[", partitioner.number_of_records());
+            auto const &counts = partitioner.records_per_partition();
+            for (size_t part = 0; part < counts.size(); ++part) fprintf(stderr, "%s%zu", part ? "," : "", counts[part]);
+            fprintf(stderr, "]}\n");
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Write per file and total statistics as one JSON document to stderr so stdout only has digests.
+    void print_stats(const std::vector<std::string> &files, const std::vector<aquahash::Stats> &stats) {
+        aquahash::Stats total;
+        fprintf(stderr, "{\"files\":[");
+        for (size_t idx = 0; idx < files.size(); ++idx) {
+            total += stats[idx];
+            fprintf(stderr, "%s{\"file\":%s,%s,\"cached\":%s}", idx ? "," : "",
+                    aquahash::json_string(files[idx]).c_str(), stats[idx].json().c_str(),
+                    stats[idx].cached ? "true" : "false");
+        }
+        fprintf(stderr, "],\"total\":{\"files\":%zu,%s}}\n", files.size(), total.json().c_str());
     }
 
     void parse_input_arguments(int argc, char *argv[]) {
@@ -35,7 +321,25 @@ namespace {
         bool color = false;
         bool big_endian = false;
         bool use_xxhash = false;
+        bool no_cache = false;
+        bool no_daemon = false;
+        bool stats = false;
         bool help = false;
+        std::string cache_file;
+        std::string socket_path = aquahash::DigestClient::default_socket();
+        Range range;
+        DeltaOptions delta;
+        bool per_line = false;
+        std::string delimiter = "\\n";
+        aquahash::RecordOptions record_options;
+        bool uniq = false;
+        aquahash::UniqOptions uniq_options;
+        size_t memory = uniq_options.memory >> 20;
+        if (const char *tmp = getenv("TMPDIR")) uniq_options.temp_dir = tmp;
+        aquahash::PartitionOptions partition_options;
+        partition_options.partitions = 0;
+        std::string field_delimiter = "\\t";
+        size_t threads = aquahash::default_threads();
         int flags = 0;
         std::vector<std::string> files;
         auto cli = clara::Help(help) |
@@ -44,6 +348,40 @@ namespace {
                    clara::Opt(color)["--color"]("Use color text.") |
                    clara::Opt(use_xxhash)["--use-xxhash"]("Compute checksum using XXHASH64 algorithm.") |
                    clara::Opt(big_endian)["--big-endian"]("Display a hash string using big endian order.") |
+                   clara::Opt(no_cache)["--no-cache"]("Always read input files instead of using the digest cache.") |
+                   clara::Opt(cache_file, "cache_file")["--cache"]("The digest cache file.") |
+                   clara::Opt(no_daemon)["--no-daemon"]("Do not ask aquahashd for digests.") |
+                   clara::Opt(socket_path, "socket")["--socket"]("The Unix domain socket of aquahashd.") |
+                   clara::Opt(range.offset, "offset")["--offset"]("Hash data starting from this byte offset.") |
+                   clara::Opt(range.length, "length")["--length"]("Hash at most this number of bytes.") |
+                   clara::Opt(range.windows, "windows")["--sample"](
+                       "Compute a sampled fingerprint from the file size and this number of 4KB windows.") |
+                   clara::Opt(stats)["--stats"](
+                       "Write bytes, read and hash time, read calls, GB/s and CPU counters to stderr as JSON.") |
+                   clara::Opt(per_line)["--per-line"]("Print the offset and the hash code of every line.") |
+                   clara::Opt(delimiter, "delimiter")["--delimiter"]("The record delimiter of --per-line and --uniq.") |
+                   clara::Opt(record_options.record_size, "record_size")["--record-size"](
+                       "Hash every record of this number of bytes.") |
+                   clara::Opt(record_options.binary)["--binary"]("Write 16-byte record hash codes to stdout.") |
+                   clara::Opt(uniq)["--uniq"]("Print the first copy of every distinct line in input order.") |
+                   clara::Opt(uniq_options.verify)["--verify"]("Compare lines with equal hash codes byte by byte.") |
+                   clara::Opt(memory, "MB")["--memory"]("The memory of --uniq before lines are partitioned on disk.") |
+                   clara::Opt(uniq_options.temp_dir, "temp_dir")["--temp-dir"]("Where --uniq writes partitions.") |
+                   clara::Opt(partition_options.partitions, "N")["--partition"](
+                       "Split lines into N files by the hash code of their key field.") |
+                   clara::Opt(partition_options.key_field, "K")["--key-field"](
+                       "The 1-based key field of --partition, 0 for the whole line.") |
+                   clara::Opt(field_delimiter, "field_delimiter")["--field-delimiter"](
+                       "The field delimiter of --key-field.") |
+                   clara::Opt(threads, "threads")["--threads"]("The number of threads of --uniq and --partition.") |
+                   clara::Opt(delta.signature, "signature")["--signature"]("Write the signature of a file.") |
+                   clara::Opt(delta.delta, "signature")["--delta"]("Write the delta of a file against a signature.") |
+                   clara::Opt(delta.patch, "delta")["--patch"]("Rebuild a file from its old version and a delta.") |
+                   clara::Opt(delta.output, "output")["--output"](
+                       "The output file of --delta and --patch, or the output prefix of --partition.") |
+                   clara::Opt(delta.block_size, "block_size")["--block-size"]("The block size of a signature.") |
+                   clara::Opt(delta.strong_bytes, "strong_bytes")["--strong-bytes"](
+                       "The number of AquaHash digest bytes stored per signature block, at most 16.") |
                    clara::Arg(files, "files")("Input files");
 
         auto result = cli.parse(clara::Args(argc, argv));
@@ -67,20 +405,92 @@ namespace {
             exit(EXIT_SUCCESS);
         }
 
+        if (!delta.signature.empty() || !delta.delta.empty() || !delta.patch.empty()) {
+            exit(run_delta(delta, files));
+        }
+
+        if (!parse_delimiter(delimiter, record_options.delimiter)) {
+            fprintf(stderr, "Invalid delimiter: '%s'\n", delimiter.data());
+            exit(EXIT_FAILURE);
+        }
+
+        if (uniq) {
+            uniq_options.delimiter = record_options.delimiter;
+            uniq_options.record_size = record_options.record_size;
+            uniq_options.memory = memory << 20;
+            uniq_options.threads = threads;
+            exit(run_uniq(uniq_options, files, verbose));
+        }
+
+        if (partition_options.partitions) {
+            if (!parse_delimiter(field_delimiter, partition_options.field_delimiter)) {
+                fprintf(stderr, "Invalid field delimiter: '%s'\n", field_delimiter.data());
+                exit(EXIT_FAILURE);
+            }
+            partition_options.delimiter = record_options.delimiter;
+            partition_options.threads = threads;
+            exit(run_partition(partition_options, files, delta.output, verbose));
+        }
+
+        if (per_line || record_options.record_size) {
+
+            // Lines are prefixed with the file name if there are several files.
+            bool ok = true;
+            aquahash::StatsCollector collector;
+            std::vector<aquahash::Stats> stats_per_file(files.size());
+            for (size_t idx = 0; idx < files.size(); ++idx) {
+                if (files.size() > 1) record_options.prefix = files[idx] + ":";
+                if (stats) collector.start();
+                ok = hash_records(files[idx], record_options, stats ? &stats_per_file[idx] : nullptr) && ok;
+                if (stats) collector.stop(stats_per_file[idx]);
+            }
+            if (stats) print_stats(files, stats_per_file);
+            exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
         flags = (verbose ? aquahash::Params::VERBOSE : aquahash::Params::NONE) |
                 (use_xxhash ? aquahash::Params::XXHASH : aquahash::Params::NONE) |
-                (color ? aquahash::Params::COLOR : aquahash::Params::NONE);
+                (color ? aquahash::Params::COLOR : aquahash::Params::NONE) |
+                (range.windows ? aquahash::Params::SAMPLED : aquahash::Params::NONE) |
+                (stats ? aquahash::Params::STATS : aquahash::Params::NONE) |
+                (no_cache ? aquahash::Params::NONE : aquahash::Params::USE_CACHE) |
+                (no_daemon || range.windows || range.offset || range.length ? aquahash::Params::NONE
+                                                                             : aquahash::Params::USE_DAEMON);
 
         // Display input arguments in JSON format if verbose flag is on
         if (aquahash::Params::verbose(flags)) {
             aquahash::Params::print(flags);
         }
 
+        // The digest cache is optional so we silently fall back to reading files if it cannot be opened.
+        aquahash::DigestCache cache;
+        if (aquahash::Params::use_cache(flags)) {
+            if (cache_file.empty()) cache_file = aquahash::DigestCache::default_path();
+            if (!cache_file.empty() && !cache.open(cache_file) && aquahash::Params::verbose(flags)) {
+                fprintf(stderr, "Cannot open the digest cache: '%s'\n", cache_file.data());
+            }
+        }
+
+        std::vector<aquahash::DigestClient::Reply> known;
+        if (aquahash::Params::use_daemon(flags) && !files.empty()) known = query_daemon(socket_path, files);
+        auto known_digest = [&known](const size_t idx) { return known.empty() ? nullptr : &known[idx]; };
+
         // Compute the hash code
-        for (auto const &file : files) {
-            aquahash::FileReader<aquahash::AquaHashPolicy> hasher(flags);
-            hasher(file.data());
+        if (!aquahash::Params::stats(flags)) {
+            for (size_t idx = 0; idx < files.size(); ++idx) {
+                hash_file(files[idx], flags, range, cache, known_digest(idx), nullptr);
+            }
+            return;
+        }
+
+        aquahash::StatsCollector collector;
+        std::vector<aquahash::Stats> stats_per_file(files.size());
+        for (size_t idx = 0; idx < files.size(); ++idx) {
+            collector.start();
+            hash_file(files[idx], flags, range, cache, known_digest(idx), &stats_per_file[idx]);
+            collector.stop(stats_per_file[idx]);
         }
+        print_stats(files, stats_per_file);
     }
 } // namespace
 
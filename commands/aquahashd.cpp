@@ -0,0 +1,96 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "clara.hpp"
+#include "digest_server.h"
+#include "parallel.h"
+#include <csignal>
+#include <string>
+#include <vector>
+
+namespace {
+    aquahash::DigestServer *running_server = nullptr;
+
+    void disp_version() { printf("%s\n", "aquahashd version 1.0"); }
+    void copyright() { printf("\n%s\n", "Report bugs or enhancement requests to hungptit@gmail.com"); }
+    void usage() {
+        printf("\nExamples:\n");
+        printf("\taquahashd ~/project &:\n");
+        printf("\taquahashd --threads 4 --socket /tmp/project.sock ~/project /usr/include:\n");
+        printf("\taquahash --socket /tmp/project.sock ~/project/main.cpp:\n");
+    }
+
+    void stop_server(int) {
+        if (running_server != nullptr) running_server->stop();
+    }
+
+    int parse_input_arguments(int argc, char *argv[]) {
+        bool verbose = false;
+        bool version = false;
+        bool help = false;
+        size_t threads = aquahash::default_threads();
+        std::string socket_path = aquahash::DigestClient::default_socket();
+        std::vector<std::string> folders;
+        auto cli = clara::Help(help) | clara::Opt(verbose)["-v"]["--verbose"]("Display verbose information") |
+                   clara::Opt(version)["--version"]("Display the version of aquahashd command.") |
+                   clara::Opt(threads, "threads")["--threads"]("The number of threads which hash changed files.") |
+                   clara::Opt(socket_path, "socket")["--socket"]("The Unix domain socket used by aquahash.") |
+                   clara::Arg(folders, "folders")("Folders to watch");
+
+        auto result = cli.parse(clara::Args(argc, argv));
+        if (!result) {
+            fprintf(stderr, "Invalid option: %s\n", result.errorMessage().data());
+            return EXIT_FAILURE;
+        }
+
+        if (version) {
+            disp_version();
+            return EXIT_SUCCESS;
+        }
+
+        if (help || folders.empty()) {
+            std::ostringstream oss;
+            oss << cli;
+            printf("%s", oss.str().data());
+            usage();
+            copyright();
+            return help ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        aquahash::DigestServer server(threads);
+        if (!server.listen(socket_path)) {
+            fprintf(stderr, "Cannot listen on '%s', is aquahashd already running?\n", socket_path.data());
+            return EXIT_FAILURE;
+        }
+
+        for (auto const &folder : folders) {
+            if (!server.watch(folder)) {
+                fprintf(stderr, "Cannot watch '%s' or some of its folders, check fs.inotify.max_user_watches\n",
+                        folder.data());
+            } else if (verbose) {
+                fprintf(stderr, "Watching '%s'\n", folder.data());
+            }
+        }
+
+        // Queries are answered while the initial files are hashed, files which are not hashed yet are misses.
+        running_server = &server;
+        signal(SIGINT, stop_server);
+        signal(SIGTERM, stop_server);
+        server.run();
+        running_server = nullptr;
+        return EXIT_SUCCESS;
+    }
+} // namespace
+
+int main(int argc, char *argv[]) { return parse_input_arguments(argc, argv); }
@@ -0,0 +1,38 @@
+#!/bin/bash
+# Check that aquahash --patch leaves no partial output behind when a delta is rejected and that a file can be patched
+# in place. Usage: delta_test.sh path/to/aquahash
+set -e
+aquahash=$(realpath "$1")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir"
+
+head -c 200000 /dev/urandom > old
+(head -c 50000 old; head -c 1000 /dev/urandom; tail -c +50001 old) > new
+head -c 200000 /dev/urandom > other
+"$aquahash" --signature old.sig old
+"$aquahash" --delta old.sig --output new.delta new
+
+# A delta applied to the wrong basis fails without creating the output or a temporary file.
+if "$aquahash" --patch new.delta --output bad other 2> /dev/null; then
+    echo "A delta against the wrong basis was accepted"
+    exit 1
+fi
+if [ -n "$(ls | grep -v -x -e old -e new -e other -e old.sig -e new.delta)" ]; then
+    echo "A rejected delta left files behind: $(ls)"
+    exit 1
+fi
+
+# A rejected delta does not touch an existing output file.
+cp other keep
+if "$aquahash" --patch new.delta --output keep other 2> /dev/null; then
+    echo "A delta against the wrong basis was accepted"
+    exit 1
+fi
+cmp keep other
+
+# Patch in place.
+cp old basis
+"$aquahash" --patch new.delta --output basis basis
+cmp basis new
+echo "OK"
@@ -0,0 +1,203 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cpuid.h>
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+// Kernels which use AES instructions are compiled for their own target so a binary built for a baseline x86-64 CPU
+// still contains them. The attributes are dropped when the whole build already targets these instructions.
+#if defined(__AES__)
+#define AQUAHASH_TARGET_AES
+#else
+#define AQUAHASH_TARGET_AES __attribute__((target("aes")))
+#endif
+
+#if defined(__VAES__) && defined(__AVX2__)
+#define AQUAHASH_TARGET_VAES
+#else
+#define AQUAHASH_TARGET_VAES __attribute__((target("aes,vaes,avx2")))
+#endif
+
+namespace aquahash {
+    // AES implementations ordered by speed.
+    enum class Isa : int { SOFTWARE = 0, AESNI = 1, VAES = 2 };
+
+    inline const char *isa_name(const Isa isa) {
+        switch (isa) {
+        case Isa::VAES:
+            return "vaes";
+        case Isa::AESNI:
+            return "aesni";
+        default:
+            return "software";
+        }
+    }
+
+    // Return the fastest AES implementation supported by both the CPU and the operating system.
+    inline Isa detect_isa() {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return Isa::SOFTWARE;
+        if (!(ecx & (1u << 25))) return Isa::SOFTWARE;
+
+        // 256-bit AES needs AVX2 and an OS that saves the YMM registers.
+        const bool osxsave = ecx & (1u << 27), avx = ecx & (1u << 28);
+        if (osxsave && avx && __get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            const bool avx2 = ebx & (1u << 5), vaes = ecx & (1u << 9);
+            uint32_t xcr0 = 0, high = 0;
+            __asm__("xgetbv" : "=a"(xcr0), "=d"(high) : "c"(0));
+            if (avx2 && vaes && (xcr0 & 6) == 6) return Isa::VAES;
+        }
+        return Isa::AESNI;
+    }
+
+    namespace detail {
+        struct AESTable {
+            uint8_t sbox[256];
+            uint32_t round[256]; // (2S, S, S, 3S) in little endian order.
+        };
+
+        constexpr uint8_t rotl8(const uint8_t x, const int shift) {
+            return static_cast<uint8_t>((x << shift) | (x >> (8 - shift)));
+        }
+
+        constexpr uint8_t xtime(const uint8_t x) {
+            return static_cast<uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+        }
+
+        // Walk the multiplicative group with generator 3 and its inverse to build the S-box.
+        constexpr AESTable make_aes_table() {
+            AESTable table{};
+            uint8_t p = 1, q = 1;
+            do {
+                p = static_cast<uint8_t>(p ^ xtime(p));
+                q = static_cast<uint8_t>(q ^ (q << 1));
+                q = static_cast<uint8_t>(q ^ (q << 2));
+                q = static_cast<uint8_t>(q ^ (q << 4));
+                if (q & 0x80) q ^= 0x09;
+                table.sbox[p] = q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63;
+            } while (p != 1);
+            table.sbox[0] = 0x63;
+
+            for (int idx = 0; idx < 256; ++idx) {
+                const uint32_t s = table.sbox[idx], s2 = xtime(table.sbox[idx]);
+                table.round[idx] = s2 | (s << 8) | (s << 16) | ((s2 ^ s) << 24);
+            }
+            return table;
+        }
+
+        template <typename T = void> struct AESTables { static constexpr AESTable value = make_aes_table(); };
+        template <typename T> constexpr AESTable AESTables<T>::value;
+
+        constexpr uint32_t rotl32(const uint32_t x, const int shift) { return (x << shift) | (x >> (32 - shift)); }
+    } // namespace detail
+
+    // A 128-bit block as two 64-bit integers, same as _mm_set_epi64x(high, low). Used where __m128i cannot be used,
+    // for example in constant expressions.
+    struct Block128 {
+        uint64_t low;
+        uint64_t high;
+    };
+
+    // Table based AES round which gives the same result as _mm_aesenc_si128 on CPUs without AES-NI.
+    struct SoftwareAES {
+        static __m128i Round(const __m128i state, const __m128i key) {
+            const uint32_t *table = detail::AESTables<>::value.round;
+            alignas(16) uint8_t s[16];
+            alignas(16) uint32_t k[4], out[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(s), state);
+            _mm_store_si128(reinterpret_cast<__m128i *>(k), key);
+
+            // SubBytes, ShiftRows and MixColumns of one column using one table lookup per byte.
+            for (int c = 0; c < 4; ++c) {
+                out[c] = table[s[4 * c]] ^ detail::rotl32(table[s[4 * ((c + 1) & 3) + 1]], 8) ^
+                         detail::rotl32(table[s[4 * ((c + 2) & 3) + 2]], 16) ^
+                         detail::rotl32(table[s[4 * ((c + 3) & 3) + 3]], 24) ^ k[c];
+            }
+            return _mm_load_si128(reinterpret_cast<const __m128i *>(out));
+        }
+
+        // The same round on a Block128, which can be evaluated at compile time.
+        static constexpr Block128 Round(const Block128 state, const Block128 key) {
+            uint8_t s[16] = {};
+            for (int idx = 0; idx < 8; ++idx) {
+                s[idx] = static_cast<uint8_t>(state.low >> (8 * idx));
+                s[idx + 8] = static_cast<uint8_t>(state.high >> (8 * idx));
+            }
+
+            const uint32_t k[4] = {static_cast<uint32_t>(key.low), static_cast<uint32_t>(key.low >> 32),
+                                   static_cast<uint32_t>(key.high), static_cast<uint32_t>(key.high >> 32)};
+            uint32_t out[4] = {};
+            for (int c = 0; c < 4; ++c) {
+                out[c] = detail::AESTables<>::value.round[s[4 * c]] ^
+                         detail::rotl32(detail::AESTables<>::value.round[s[4 * ((c + 1) & 3) + 1]], 8) ^
+                         detail::rotl32(detail::AESTables<>::value.round[s[4 * ((c + 2) & 3) + 2]], 16) ^
+                         detail::rotl32(detail::AESTables<>::value.round[s[4 * ((c + 3) & 3) + 3]], 24) ^ k[c];
+            }
+            return Block128{out[0] | (uint64_t(out[1]) << 32), out[2] | (uint64_t(out[3]) << 32)};
+        }
+
+        // Hash count 64-byte stripes into 4 lanes.
+        static void Stripes(__m128i *block, const __m128i *ptr, const size_t count) {
+            for (size_t idx = 0; idx < count; ++idx, ptr += 4) {
+                block[0] = Round(block[0], _mm_loadu_si128(ptr));
+                block[1] = Round(block[1], _mm_loadu_si128(ptr + 1));
+                block[2] = Round(block[2], _mm_loadu_si128(ptr + 2));
+                block[3] = Round(block[3], _mm_loadu_si128(ptr + 3));
+            }
+        }
+    };
+
+    struct HardwareAES {
+        AQUAHASH_TARGET_AES static inline __m128i Round(const __m128i state, const __m128i key) {
+            return _mm_aesenc_si128(state, key);
+        }
+
+        AQUAHASH_TARGET_AES static inline void Stripes(__m128i *block, const __m128i *ptr, const size_t count) {
+            for (size_t idx = 0; idx < count; ++idx, ptr += 4) {
+                block[0] = _mm_aesenc_si128(block[0], _mm_loadu_si128(ptr));
+                block[1] = _mm_aesenc_si128(block[1], _mm_loadu_si128(ptr + 1));
+                block[2] = _mm_aesenc_si128(block[2], _mm_loadu_si128(ptr + 2));
+                block[3] = _mm_aesenc_si128(block[3], _mm_loadu_si128(ptr + 3));
+            }
+        }
+    };
+
+    // AES-NI for single rounds and 256-bit VAES for stripes, which hashes two lanes per instruction.
+    struct VectorAES : HardwareAES {
+        AQUAHASH_TARGET_VAES static inline void Stripes(__m128i *block, const __m128i *ptr, const size_t count) {
+            __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+            __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 2));
+            for (size_t idx = 0; idx < count; ++idx, ptr += 4) {
+                low = _mm256_aesenc_epi128(low, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr)));
+                high = _mm256_aesenc_epi128(high, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + 2)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(block), low);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(block + 2), high);
+        }
+    };
+
+    // One AES round for code that is built for a single target, for example sketches which mix digests.
+    inline __m128i aesenc(const __m128i state, const __m128i key) {
+#if defined(__AES__)
+        return _mm_aesenc_si128(state, key);
+#else
+        return SoftwareAES::Round(state, key);
+#endif
+    }
+} // namespace aquahash
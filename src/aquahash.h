@@ -15,15 +15,18 @@
 
 #pragma once
 
+#include "aes.h"
 #include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <immintrin.h>
 #include <limits>
 #include <stdint.h>
+#include <sys/uio.h>
 
-class AquaHash {
-  private:
+// Constants shared by the AquaHash kernels and the incremental hashing object.
+class AquaHashBase {
+  protected:
     static constexpr unsigned int THRESHOLD = 64;
     static constexpr size_t MAXLEN = std::numeric_limits<size_t>::max() - 1;
     // sentinel to prevent double finalization
@@ -84,21 +87,13 @@ class AquaHash {
         static constexpr int8_t CONSTANT_8_15 = static_cast<int8_t>(CONSTANT_64_8 >> 8 & MASK_8BITS);  // 0x31,
     };
 
-    // 4 x 128-bit hashing lanes
-    __m128i block[4];
-
-    // input block buffer
-    __m128i input[4];
-
-    // initialization vector
-    __m128i initialize;
-
-    // cumulative input bytes
-    size_t input_bytes;
+};
 
+// AquaHash algorithms for a given AES round implementation. All implementations give identical results.
+template <typename AES> class AquaHashKernel : AquaHashBase {
   public:
     // Reference implementation of AquaHash small key algorithm
-    static __m128i SmallKeyAlgorithm(const uint8_t *key, const size_t bytes, __m128i initialize = _mm_setzero_si128()) {
+    AQUAHASH_TARGET_AES static __m128i SmallKeyAlgorithm(const uint8_t *key, const size_t bytes, __m128i initialize) {
         assert(bytes <= MAXLEN);
         __m128i hash = initialize;
 
@@ -108,24 +103,36 @@ class AquaHash {
             __m128i temp = _mm_set_epi64x(Constants::Constants::CONSTANT_64_1, Constants::CONSTANT_64_2);
             for (uint32_t i = 0; i < bytes / sizeof(hash); ++i) {
                 __m128i b = _mm_loadu_si128(ptr128++);
-                hash = _mm_aesenc_si128(hash, b);
-                temp = _mm_aesenc_si128(temp, b);
+                hash = AES::Round(hash, b);
+                temp = AES::Round(temp, b);
             }
-            hash = _mm_aesenc_si128(hash, temp);
+            hash = AES::Round(hash, temp);
         }
 
         // AES sub-block processor
-        const uint8_t *ptr8 = reinterpret_cast<const uint8_t *>(ptr128);
+        hash = _mm_xor_si128(hash, SubBlocks(reinterpret_cast<const uint8_t *>(ptr128), bytes));
+
+        // this algorithm construction requires no less than three AES rounds to finalize
+        hash = AES::Round(hash, _mm_set_epi64x(Constants::CONSTANT_64_9, Constants::Constants::CONSTANT_64_10));
+        hash = AES::Round(
+            hash, _mm_set_epi64x(Constants::Constants::CONSTANT_64_11, Constants::Constants::CONSTANT_64_12));
+        return AES::Round(
+            hash, _mm_set_epi64x(Constants::Constants::CONSTANT_64_13, Constants::Constants::CONSTANT_64_14));
+    }
+
+    // The last bytes % 16 bytes of a small key as one block which is XORed into the hash lane.
+    AQUAHASH_TARGET_AES static __m128i SubBlocks(const uint8_t *ptr8, const size_t bytes) {
+        __m128i mix = _mm_setzero_si128();
         if (bytes & 8) {
             __m128i b = _mm_set_epi64x(*reinterpret_cast<const uint64_t *>(ptr8), Constants::Constants::CONSTANT_64_1);
-            hash = _mm_xor_si128(hash, b);
+            mix = _mm_xor_si128(mix, b);
             ptr8 += 8;
         }
 
         if (bytes & 4) {
             __m128i b = _mm_set_epi32(Constants::CONSTANT_32_1, Constants::CONSTANT_32_2,
                                       *reinterpret_cast<const uint32_t *>(ptr8), Constants::CONSTANT_32_3);
-            hash = _mm_xor_si128(hash, b);
+            mix = _mm_xor_si128(mix, b);
             ptr8 += 4;
         }
 
@@ -133,7 +140,7 @@ class AquaHash {
             __m128i b = _mm_set_epi16(Constants::CONSTANT_16_1, Constants::CONSTANT_16_2, Constants::CONSTANT_16_3,
                                       Constants::CONSTANT_16_4, Constants::CONSTANT_16_5, Constants::CONSTANT_16_6,
                                       *reinterpret_cast<const uint16_t *>(ptr8), Constants::CONSTANT_16_7);
-            hash = _mm_xor_si128(hash, b);
+            mix = _mm_xor_si128(mix, b);
             ptr8 += 2;
         }
 
@@ -144,19 +151,41 @@ class AquaHash {
                                      Constants::CONSTANT_8_10, Constants::CONSTANT_8_11, Constants::CONSTANT_8_12,
                                      Constants::CONSTANT_8_13, Constants::CONSTANT_8_14,
                                      *reinterpret_cast<const uint8_t *>(ptr8), Constants::CONSTANT_8_15);
-            hash = _mm_xor_si128(hash, b);
+            mix = _mm_xor_si128(mix, b);
         }
+        return mix;
+    }
 
-        // this algorithm construction requires no less than three AES rounds to finalize
-        hash = _mm_aesenc_si128(hash, _mm_set_epi64x(Constants::CONSTANT_64_9, Constants::Constants::CONSTANT_64_10));
-        hash = _mm_aesenc_si128(
-            hash, _mm_set_epi64x(Constants::Constants::CONSTANT_64_11, Constants::Constants::CONSTANT_64_12));
-        return _mm_aesenc_si128(
-            hash, _mm_set_epi64x(Constants::Constants::CONSTANT_64_13, Constants::Constants::CONSTANT_64_14));
+    // The small key algorithm for N seeds. Only the hash lane depends on the seed, so the key is loaded once, the
+    // second lane and the sub-blocks are computed once and the AES rounds of all N seeds are interleaved.
+    template <size_t N>
+    AQUAHASH_TARGET_AES static void SmallKeyMulti(const uint8_t *key, const size_t bytes, const __m128i *seeds,
+                                                  __m128i *out) {
+        const __m128i *ptr128 = reinterpret_cast<const __m128i *>(key);
+        const size_t blocks = bytes / sizeof(__m128i);
+        __m128i hash[N];
+        for (size_t j = 0; j < N; ++j) hash[j] = seeds[j];
+        if (blocks) {
+            __m128i temp = _mm_set_epi64x(Constants::Constants::CONSTANT_64_1, Constants::CONSTANT_64_2);
+            for (size_t i = 0; i < blocks; ++i) {
+                const __m128i b = _mm_loadu_si128(ptr128 + i);
+                for (size_t j = 0; j < N; ++j) hash[j] = AES::Round(hash[j], b);
+                temp = AES::Round(temp, b);
+            }
+            for (size_t j = 0; j < N; ++j) hash[j] = AES::Round(hash[j], temp);
+        }
+
+        const __m128i mix = SubBlocks(reinterpret_cast<const uint8_t *>(ptr128 + blocks), bytes);
+        const __m128i final1 = _mm_set_epi64x(Constants::CONSTANT_64_9, Constants::Constants::CONSTANT_64_10);
+        const __m128i final2 = _mm_set_epi64x(Constants::Constants::CONSTANT_64_11, Constants::CONSTANT_64_12);
+        const __m128i final3 = _mm_set_epi64x(Constants::Constants::CONSTANT_64_13, Constants::CONSTANT_64_14);
+        for (size_t j = 0; j < N; ++j) hash[j] = AES::Round(_mm_xor_si128(hash[j], mix), final1);
+        for (size_t j = 0; j < N; ++j) hash[j] = AES::Round(hash[j], final2);
+        for (size_t j = 0; j < N; ++j) out[j] = AES::Round(hash[j], final3);
     }
 
     // Reference implementation of AquaHash large key algorithm
-    static __m128i LargeKeyAlgorithm(const uint8_t *key, const size_t bytes, __m128i initialize = _mm_setzero_si128()) {
+    AQUAHASH_TARGET_AES static __m128i LargeKeyAlgorithm(const uint8_t *key, const size_t bytes, __m128i initialize) {
         assert(bytes <= MAXLEN);
 
         // initialize 4 x 128-bit hashing lanes, for a 512-bit block size
@@ -167,36 +196,138 @@ class AquaHash {
             _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_7, Constants::CONSTANT_64_8))};
 
         // bulk hashing loop -- 512-bit block size
-        const __m128i *ptr128 = reinterpret_cast<const __m128i *>(key);
-        for (size_t block_counter = 0; block_counter < bytes / sizeof(block); block_counter++) {
-            block[0] = _mm_aesenc_si128(block[0], _mm_loadu_si128(ptr128++));
-            block[1] = _mm_aesenc_si128(block[1], _mm_loadu_si128(ptr128++));
-            block[2] = _mm_aesenc_si128(block[2], _mm_loadu_si128(ptr128++));
-            block[3] = _mm_aesenc_si128(block[3], _mm_loadu_si128(ptr128++));
+        AES::Stripes(block, reinterpret_cast<const __m128i *>(key), bytes / sizeof(block));
+        return LargeKeyTail(block, key + bytes / sizeof(block) * sizeof(block), bytes);
+    }
+
+    // Hash the concatenation of count buffers. Stripes inside a buffer are hashed in place, only a stripe which spans
+    // two buffers and the last bytes % 64 bytes are copied.
+    AQUAHASH_TARGET_AES static __m128i HashV(const struct iovec *iov, const size_t count, __m128i initialize) {
+        size_t bytes = 0;
+        for (size_t idx = 0; idx < count; ++idx) bytes += iov[idx].iov_len;
+
+        __m128i block[4];
+        alignas(16) uint8_t buffer[sizeof(block)];
+        if (bytes < THRESHOLD) {
+            uint8_t *ptr = buffer;
+            for (size_t idx = 0; idx < count; ++idx) {
+                memcpy(ptr, iov[idx].iov_base, iov[idx].iov_len);
+                ptr += iov[idx].iov_len;
+            }
+            return SmallKeyAlgorithm(buffer, bytes, initialize);
+        }
+
+        block[0] = _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_1, Constants::CONSTANT_64_2));
+        block[1] = _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_3, Constants::CONSTANT_64_4));
+        block[2] = _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_5, Constants::CONSTANT_64_6));
+        block[3] = _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_7, Constants::CONSTANT_64_8));
+        size_t used = 0;
+        for (size_t idx = 0; idx < count; ++idx) {
+            const uint8_t *ptr = static_cast<const uint8_t *>(iov[idx].iov_base);
+            size_t len = iov[idx].iov_len;
+
+            // complete the stripe started by the previous buffers
+            if (used) {
+                const size_t copy_size = len < sizeof(buffer) - used ? len : sizeof(buffer) - used;
+                memcpy(buffer + used, ptr, copy_size);
+                used += copy_size;
+                ptr += copy_size;
+                len -= copy_size;
+                if (used < sizeof(buffer)) continue;
+                AES::Stripes(block, reinterpret_cast<const __m128i *>(buffer), 1);
+                used = 0;
+            }
+
+            AES::Stripes(block, reinterpret_cast<const __m128i *>(ptr), len / sizeof(block));
+            used = len % sizeof(block);
+            memcpy(buffer, ptr + len - used, used);
+        }
+
+        return LargeKeyTail(block, buffer, bytes);
+    }
+
+    // Copy count 64-byte stripes from src to dst and hash them from the same registers. Non-temporal stores keep a
+    // large copy out of the cache, they are only used if dst is 16-byte aligned.
+    AQUAHASH_TARGET_AES static void CopyStripes(__m128i *block, uint8_t *dst, const uint8_t *src, const size_t count,
+                                                const bool non_temporal) {
+        const __m128i *from = reinterpret_cast<const __m128i *>(src);
+        __m128i *to = reinterpret_cast<__m128i *>(dst);
+        if (non_temporal && (reinterpret_cast<uintptr_t>(dst) & 15) == 0) {
+            for (size_t idx = 0; idx < count; ++idx, from += 4, to += 4) {
+                const __m128i b0 = _mm_loadu_si128(from), b1 = _mm_loadu_si128(from + 1);
+                const __m128i b2 = _mm_loadu_si128(from + 2), b3 = _mm_loadu_si128(from + 3);
+                _mm_stream_si128(to, b0);
+                _mm_stream_si128(to + 1, b1);
+                _mm_stream_si128(to + 2, b2);
+                _mm_stream_si128(to + 3, b3);
+                block[0] = AES::Round(block[0], b0);
+                block[1] = AES::Round(block[1], b1);
+                block[2] = AES::Round(block[2], b2);
+                block[3] = AES::Round(block[3], b3);
+            }
+            _mm_sfence();
+            return;
         }
 
+        for (size_t idx = 0; idx < count; ++idx, from += 4, to += 4) {
+            const __m128i b0 = _mm_loadu_si128(from), b1 = _mm_loadu_si128(from + 1);
+            const __m128i b2 = _mm_loadu_si128(from + 2), b3 = _mm_loadu_si128(from + 3);
+            _mm_storeu_si128(to, b0);
+            _mm_storeu_si128(to + 1, b1);
+            _mm_storeu_si128(to + 2, b2);
+            _mm_storeu_si128(to + 3, b3);
+            block[0] = AES::Round(block[0], b0);
+            block[1] = AES::Round(block[1], b1);
+            block[2] = AES::Round(block[2], b2);
+            block[3] = AES::Round(block[3], b3);
+        }
+    }
+
+    // Copy a key from src to dst and return the same hash code as Hash(src, bytes, initialize).
+    AQUAHASH_TARGET_AES static __m128i CopyAndHash(uint8_t *dst, const uint8_t *src, const size_t bytes,
+                                                   __m128i initialize, const bool non_temporal) {
+        if (bytes < THRESHOLD) {
+            memcpy(dst, src, bytes);
+            return SmallKeyAlgorithm(src, bytes, initialize);
+        }
+
+        __m128i block[4] = {
+            _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_1, Constants::CONSTANT_64_2)),
+            _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_3, Constants::CONSTANT_64_4)),
+            _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_5, Constants::CONSTANT_64_6)),
+            _mm_xor_si128(initialize, _mm_set_epi64x(Constants::CONSTANT_64_7, Constants::CONSTANT_64_8))};
+        const size_t copied = bytes / sizeof(block) * sizeof(block);
+        CopyStripes(block, dst, src, bytes / sizeof(block), non_temporal);
+        memcpy(dst + copied, src + copied, bytes - copied);
+        return LargeKeyTail(block, src + copied, bytes);
+    }
+
+    // Finish the large key algorithm from the hashing lanes and the last bytes % 64 bytes of the key.
+    AQUAHASH_TARGET_AES static __m128i LargeKeyTail(__m128i *block, const uint8_t *tail, const size_t bytes) {
+        const __m128i *ptr128 = reinterpret_cast<const __m128i *>(tail);
+
         // process remaining AES blocks
         if (bytes & 32) {
-            block[0] = _mm_aesenc_si128(block[0], _mm_loadu_si128(ptr128++));
-            block[1] = _mm_aesenc_si128(block[1], _mm_loadu_si128(ptr128++));
+            block[0] = AES::Round(block[0], _mm_loadu_si128(ptr128++));
+            block[1] = AES::Round(block[1], _mm_loadu_si128(ptr128++));
         }
 
         if (bytes & 16) {
-            block[2] = _mm_aesenc_si128(block[2], _mm_loadu_si128(ptr128++));
+            block[2] = AES::Round(block[2], _mm_loadu_si128(ptr128++));
         }
 
         // AES sub-block processor
         const uint8_t *ptr8 = reinterpret_cast<const uint8_t *>(ptr128);
         if (bytes & 8) {
             __m128i b = _mm_set_epi64x(*reinterpret_cast<const uint64_t *>(ptr8), Constants::Constants::CONSTANT_64_1);
-            block[3] = _mm_aesenc_si128(block[3], b);
+            block[3] = AES::Round(block[3], b);
             ptr8 += 8;
         }
 
         if (bytes & 4) {
             __m128i b = _mm_set_epi32(Constants::CONSTANT_32_1, Constants::CONSTANT_32_2,
                                       *reinterpret_cast<const uint32_t *>(ptr8), Constants::CONSTANT_32_3);
-            block[0] = _mm_aesenc_si128(block[0], b);
+            block[0] = AES::Round(block[0], b);
             ptr8 += 4;
         }
 
@@ -204,7 +335,7 @@ class AquaHash {
             __m128i b = _mm_set_epi16(Constants::CONSTANT_16_1, Constants::CONSTANT_16_2, Constants::CONSTANT_16_3,
                                       Constants::CONSTANT_16_4, Constants::CONSTANT_16_5, Constants::CONSTANT_16_6,
                                       *reinterpret_cast<const uint16_t *>(ptr8), Constants::CONSTANT_16_7);
-            block[1] = _mm_aesenc_si128(block[1], b);
+            block[1] = AES::Round(block[1], b);
             ptr8 += 2;
         }
 
@@ -214,28 +345,318 @@ class AquaHash {
                 Constants::CONSTANT_8_05, Constants::CONSTANT_8_06, Constants::CONSTANT_8_07, Constants::CONSTANT_8_08,
                 Constants::CONSTANT_8_09, Constants::CONSTANT_8_10, Constants::CONSTANT_8_11, Constants::CONSTANT_8_12,
                 Constants::CONSTANT_8_13, Constants::CONSTANT_8_14, *ptr8, Constants::CONSTANT_8_15);
-            block[2] = _mm_aesenc_si128(block[2], b);
+            block[2] = AES::Round(block[2], b);
         }
 
         // indirectly mix hashing lanes
         const __m128i mix = _mm_xor_si128(_mm_xor_si128(block[0], block[1]), _mm_xor_si128(block[2], block[3]));
-        block[0] = _mm_aesenc_si128(block[0], mix);
-        block[1] = _mm_aesenc_si128(block[1], mix);
-        block[2] = _mm_aesenc_si128(block[2], mix);
-        block[3] = _mm_aesenc_si128(block[3], mix);
+        block[0] = AES::Round(block[0], mix);
+        block[1] = AES::Round(block[1], mix);
+        block[2] = AES::Round(block[2], mix);
+        block[3] = AES::Round(block[3], mix);
 
         // reduction from 512-bit block size to 128-bit hash
-        __m128i hash = _mm_aesenc_si128(_mm_aesenc_si128(block[0], block[1]), _mm_aesenc_si128(block[2], block[3]));
+        __m128i hash = AES::Round(AES::Round(block[0], block[1]), AES::Round(block[2], block[3]));
 
         // this algorithm construction requires no less than one round to finalize
-        return _mm_aesenc_si128(hash, _mm_set_epi64x(Constants::CONSTANT_64_9, Constants::Constants::CONSTANT_64_10));
+        return AES::Round(hash, _mm_set_epi64x(Constants::CONSTANT_64_9, Constants::Constants::CONSTANT_64_10));
+    }
+
+    AQUAHASH_TARGET_AES static __m128i Hash(const uint8_t *key, const size_t bytes, __m128i initialize) {
+        return bytes < THRESHOLD ? SmallKeyAlgorithm(key, bytes, initialize)
+                                 : LargeKeyAlgorithm(key, bytes, initialize);
+    }
+
+    // Large keys already keep four independent AES lanes busy, so they are hashed once per seed.
+    AQUAHASH_TARGET_AES static void HashMulti(const uint8_t *key, const size_t bytes, const __m128i *seeds,
+                                              const size_t k, __m128i *out) {
+        size_t j = 0;
+        if (bytes < THRESHOLD) {
+            for (; j + 8 <= k; j += 8) SmallKeyMulti<8>(key, bytes, seeds + j, out + j);
+            if (j + 4 <= k) {
+                SmallKeyMulti<4>(key, bytes, seeds + j, out + j);
+                j += 4;
+            }
+            if (j + 2 <= k) {
+                SmallKeyMulti<2>(key, bytes, seeds + j, out + j);
+                j += 2;
+            }
+            if (j < k) out[j] = SmallKeyAlgorithm(key, bytes, seeds[j]);
+            return;
+        }
+        for (; j < k; ++j) out[j] = LargeKeyAlgorithm(key, bytes, seeds[j]);
+    }
+
+    // Finish an incremental hash from its hashing lanes and the bytes left in its input buffer.
+    AQUAHASH_TARGET_AES static __m128i Finalize(__m128i *block, const __m128i *input, const size_t input_bytes,
+                                                const __m128i initialize) {
+        if (input_bytes < THRESHOLD) {
+            return SmallKeyAlgorithm(reinterpret_cast<const uint8_t *>(input), input_bytes, initialize);
+        }
+
+        // process remaining AES blocks
+        if (input_bytes & 32) {
+            block[0] = AES::Round(block[0], input[0]);
+            block[1] = AES::Round(block[1], input[1]);
+        }
+
+        if (input_bytes & 16) {
+            block[2] = AES::Round(block[2], input[2]);
+        }
+
+        // AES sub-block processor
+        const uint8_t *ptr8 = reinterpret_cast<const uint8_t *>(&input[3]);
+        if (input_bytes & 8) {
+            __m128i b =
+                _mm_set_epi64x(*reinterpret_cast<const uint64_t *>(ptr8), Constants::Constants::CONSTANT_64_1);
+            block[3] = AES::Round(block[3], b);
+            ptr8 += 8;
+        }
+
+        if (input_bytes & 4) {
+            __m128i b = _mm_set_epi32(Constants::CONSTANT_32_1, Constants::CONSTANT_32_2,
+                                      *reinterpret_cast<const uint32_t *>(ptr8), Constants::CONSTANT_32_3);
+            block[0] = AES::Round(block[0], b);
+            ptr8 += 4;
+        }
+
+        if (input_bytes & 2) {
+            __m128i b = _mm_set_epi16(Constants::CONSTANT_16_1, Constants::CONSTANT_16_2, Constants::CONSTANT_16_3,
+                                      Constants::CONSTANT_16_4, Constants::CONSTANT_16_5, Constants::CONSTANT_16_6,
+                                      *reinterpret_cast<const uint16_t *>(ptr8), Constants::CONSTANT_16_7);
+            block[1] = AES::Round(block[1], b);
+            ptr8 += 2;
+        }
+
+        if (input_bytes & 1) {
+            __m128i b =
+                _mm_set_epi8(Constants::CONSTANT_8_01, Constants::CONSTANT_8_02, Constants::CONSTANT_8_03,
+                             Constants::CONSTANT_8_04, Constants::CONSTANT_8_05, Constants::CONSTANT_8_06,
+                             Constants::CONSTANT_8_07, Constants::CONSTANT_8_08, Constants::CONSTANT_8_09,
+                             Constants::CONSTANT_8_10, Constants::CONSTANT_8_11, Constants::CONSTANT_8_12,
+                             Constants::CONSTANT_8_13, Constants::CONSTANT_8_14, *ptr8, Constants::CONSTANT_8_15);
+            block[2] = AES::Round(block[2], b);
+        }
+
+        // indirectly mix hashing lanes
+        const __m128i mix = _mm_xor_si128(_mm_xor_si128(block[0], block[1]), _mm_xor_si128(block[2], block[3]));
+        block[0] = AES::Round(block[0], mix);
+        block[1] = AES::Round(block[1], mix);
+        block[2] = AES::Round(block[2], mix);
+        block[3] = AES::Round(block[3], mix);
+
+        // reduction from 512-bit block size to 128-bit hash
+        __m128i hash = AES::Round(AES::Round(block[0], block[1]), AES::Round(block[2], block[3]));
+
+        // this algorithm construction requires no less than 1 round to finalize
+        return AES::Round(hash, _mm_set_epi64x(Constants::CONSTANT_64_9, Constants::Constants::CONSTANT_64_10));
+    }
+};
+
+namespace aquahash {
+#if defined(__AES__) && !defined(AQUAHASH_RUNTIME_DISPATCH)
+    // The build targets AES-NI so kernels are called directly and inlined.
+    struct Dispatcher {
+#if defined(__VAES__) && defined(__AVX2__)
+        using Kernel = AquaHashKernel<VectorAES>;
+        using AES = VectorAES;
+        static Isa isa() { return Isa::VAES; }
+#else
+        using Kernel = AquaHashKernel<HardwareAES>;
+        using AES = HardwareAES;
+        static Isa isa() { return Isa::AESNI; }
+#endif
+        static bool use(const Isa value) { return value == isa(); }
+
+        static __m128i SmallKeyAlgorithm(const uint8_t *key, const size_t bytes, const __m128i initialize) {
+            return Kernel::SmallKeyAlgorithm(key, bytes, initialize);
+        }
+
+        static __m128i LargeKeyAlgorithm(const uint8_t *key, const size_t bytes, const __m128i initialize) {
+            return Kernel::LargeKeyAlgorithm(key, bytes, initialize);
+        }
+
+        static __m128i Hash(const uint8_t *key, const size_t bytes, const __m128i initialize) {
+            return Kernel::Hash(key, bytes, initialize);
+        }
+
+        static __m128i HashV(const struct iovec *iov, const size_t count, const __m128i initialize) {
+            return Kernel::HashV(iov, count, initialize);
+        }
+
+        static void HashMulti(const uint8_t *key, const size_t bytes, const __m128i *seeds, const size_t k,
+                              __m128i *out) {
+            Kernel::HashMulti(key, bytes, seeds, k, out);
+        }
+
+        static __m128i CopyAndHash(uint8_t *dst, const uint8_t *src, const size_t bytes, const __m128i initialize,
+                                   const bool non_temporal) {
+            return Kernel::CopyAndHash(dst, src, bytes, initialize, non_temporal);
+        }
+
+        static void Stripes(__m128i *block, const __m128i *ptr, const size_t count) { AES::Stripes(block, ptr, count); }
+
+        static void CopyStripes(__m128i *block, uint8_t *dst, const uint8_t *src, const size_t count,
+                                const bool non_temporal) {
+            Kernel::CopyStripes(block, dst, src, count, non_temporal);
+        }
+
+        static __m128i Finalize(__m128i *block, const __m128i *input, const size_t bytes, const __m128i initialize) {
+            return Kernel::Finalize(block, input, bytes, initialize);
+        }
+    };
+#else
+    // The build does not assume AES-NI so the fastest kernel supported by the CPU is selected on first use.
+    struct Dispatcher {
+        using Algorithm = __m128i (*)(const uint8_t *, const size_t, __m128i);
+
+        struct Table {
+            Isa isa;
+            Algorithm small;
+            Algorithm large;
+            Algorithm hash;
+            __m128i (*hashv)(const struct iovec *, const size_t, __m128i);
+            void (*hash_multi)(const uint8_t *, const size_t, const __m128i *, const size_t, __m128i *);
+            __m128i (*copy_and_hash)(uint8_t *, const uint8_t *, const size_t, __m128i, const bool);
+            void (*stripes)(__m128i *, const __m128i *, const size_t);
+            void (*copy_stripes)(__m128i *, uint8_t *, const uint8_t *, const size_t, const bool);
+            __m128i (*finalize)(__m128i *, const __m128i *, const size_t, const __m128i);
+        };
+
+        template <typename AES> static Table make_table(const Isa isa) {
+            using Kernel = AquaHashKernel<AES>;
+            return Table{isa,
+                         &Kernel::SmallKeyAlgorithm,
+                         &Kernel::LargeKeyAlgorithm,
+                         &Kernel::Hash,
+                         &Kernel::HashV,
+                         &Kernel::HashMulti,
+                         &Kernel::CopyAndHash,
+                         &AES::Stripes,
+                         &Kernel::CopyStripes,
+                         &Kernel::Finalize};
+        }
+
+        static Table select(const Isa isa) {
+            switch (isa) {
+            case Isa::VAES:
+                return make_table<VectorAES>(isa);
+            case Isa::AESNI:
+                return make_table<HardwareAES>(isa);
+            default:
+                return make_table<SoftwareAES>(isa);
+            }
+        }
+
+        static Table &table() {
+            static Table current = select(detect_isa());
+            return current;
+        }
+
+        static Isa isa() { return table().isa; }
+
+        // Switch to a slower kernel, for example to compare kernels. It must be called before any hashing starts.
+        static bool use(const Isa value) {
+            if (value > detect_isa()) return false;
+            table() = select(value);
+            return true;
+        }
+
+        static __m128i SmallKeyAlgorithm(const uint8_t *key, const size_t bytes, const __m128i initialize) {
+            return table().small(key, bytes, initialize);
+        }
+
+        static __m128i LargeKeyAlgorithm(const uint8_t *key, const size_t bytes, const __m128i initialize) {
+            return table().large(key, bytes, initialize);
+        }
+
+        static __m128i Hash(const uint8_t *key, const size_t bytes, const __m128i initialize) {
+            return table().hash(key, bytes, initialize);
+        }
+
+        static __m128i HashV(const struct iovec *iov, const size_t count, const __m128i initialize) {
+            return table().hashv(iov, count, initialize);
+        }
+
+        static void HashMulti(const uint8_t *key, const size_t bytes, const __m128i *seeds, const size_t k,
+                              __m128i *out) {
+            table().hash_multi(key, bytes, seeds, k, out);
+        }
+
+        static __m128i CopyAndHash(uint8_t *dst, const uint8_t *src, const size_t bytes, const __m128i initialize,
+                                   const bool non_temporal) {
+            return table().copy_and_hash(dst, src, bytes, initialize, non_temporal);
+        }
+
+        static void Stripes(__m128i *block, const __m128i *ptr, const size_t count) {
+            if (count) table().stripes(block, ptr, count);
+        }
+
+        static void CopyStripes(__m128i *block, uint8_t *dst, const uint8_t *src, const size_t count,
+                                const bool non_temporal) {
+            if (count) table().copy_stripes(block, dst, src, count, non_temporal);
+        }
+
+        static __m128i Finalize(__m128i *block, const __m128i *input, const size_t bytes, const __m128i initialize) {
+            return table().finalize(block, input, bytes, initialize);
+        }
+    };
+#endif
+} // namespace aquahash
+
+class AquaHash : AquaHashBase {
+  private:
+    // 4 x 128-bit hashing lanes
+    __m128i block[4];
+
+    // input block buffer
+    __m128i input[4];
+
+    // initialization vector
+    __m128i initialize;
+
+    // cumulative input bytes
+    size_t input_bytes;
+
+  public:
+    // Reference implementation of AquaHash small key algorithm
+    static __m128i SmallKeyAlgorithm(const uint8_t *key, const size_t bytes, __m128i initialize = _mm_setzero_si128()) {
+        assert(bytes <= MAXLEN);
+        return aquahash::Dispatcher::SmallKeyAlgorithm(key, bytes, initialize);
+    }
+
+    // Reference implementation of AquaHash large key algorithm
+    static __m128i LargeKeyAlgorithm(const uint8_t *key, const size_t bytes, __m128i initialize = _mm_setzero_si128()) {
+        assert(bytes <= MAXLEN);
+        return aquahash::Dispatcher::LargeKeyAlgorithm(key, bytes, initialize);
     }
 
     // NON-INCREMENTAL HYBRID ALGORITHM
 
     static __m128i Hash(const uint8_t *key, const size_t bytes, __m128i initialize = _mm_setzero_si128()) {
-        return bytes < THRESHOLD ? SmallKeyAlgorithm(key, bytes, initialize)
-                                 : LargeKeyAlgorithm(key, bytes, initialize);
+        return aquahash::Dispatcher::Hash(key, bytes, initialize);
+    }
+
+    // Hash the concatenation of count buffers, for example the fields of a record, without copying them into one
+    // buffer. The hash code is the same as Hash of the concatenation.
+    static __m128i HashV(const struct iovec *iov, const size_t count, __m128i initialize = _mm_setzero_si128()) {
+        if (count == 1) return Hash(static_cast<const uint8_t *>(iov->iov_base), iov->iov_len, initialize);
+        return aquahash::Dispatcher::HashV(iov, count, initialize);
+    }
+
+    // Hash one key with k seeds, out[j] is the same as Hash(key, bytes, seeds[j]). Keys shorter than 64 bytes are
+    // loaded once and the AES rounds of all seeds are interleaved. This beats k calls of Hash from k = 2 on for keys
+    // of 16 to 63 bytes. Shorter keys only gain from k = 4 on, since every seed still needs its own three dependent
+    // final rounds. Keys of 64 bytes or more are hashed once per seed, as fast as calling Hash.
+    static void HashMulti(const uint8_t *key, const size_t bytes, const __m128i *seeds, const size_t k, __m128i *out) {
+        aquahash::Dispatcher::HashMulti(key, bytes, seeds, k, out);
+    }
+
+    // Copy bytes from src to dst and hash them in the same pass, which gives the same hash code as Hash(src, bytes).
+    // Non-temporal stores only pay off for copies much larger than the cache when dst is not read again soon.
+    static __m128i CopyAndHash(uint8_t *dst, const uint8_t *src, const size_t bytes,
+                               __m128i initialize = _mm_setzero_si128(), const bool non_temporal = false) {
+        return aquahash::Dispatcher::CopyAndHash(dst, src, bytes, initialize, non_temporal);
     }
 
     // INCREMENTAL HYBRID ALGORITHM
@@ -289,96 +710,54 @@ class AquaHash {
             key += copy_size;
 
             // hash input buffer
-            block[0] = _mm_aesenc_si128(block[0], input[0]);
-            block[1] = _mm_aesenc_si128(block[1], input[1]);
-            block[2] = _mm_aesenc_si128(block[2], input[2]);
-            block[3] = _mm_aesenc_si128(block[3], input[3]);
+            aquahash::Dispatcher::Stripes(block, input, 1);
         }
 
         input_bytes += bytes;
 
         // input buffer is empty
         const __m128i *ptr128 = reinterpret_cast<const __m128i *>(key);
-        while (bytes >= sizeof(block)) {
-            block[0] = _mm_aesenc_si128(block[0], _mm_loadu_si128(ptr128++));
-            block[1] = _mm_aesenc_si128(block[1], _mm_loadu_si128(ptr128++));
-            block[2] = _mm_aesenc_si128(block[2], _mm_loadu_si128(ptr128++));
-            block[3] = _mm_aesenc_si128(block[3], _mm_loadu_si128(ptr128++));
-            bytes -= sizeof(block);
-        }
+        aquahash::Dispatcher::Stripes(block, ptr128, bytes / sizeof(block));
+        ptr128 += 4 * (bytes / sizeof(block));
+        bytes %= sizeof(block);
 
         // load remaining bytes into input buffer
         if (bytes) memcpy(input, ptr128, bytes);
     }
 
-    // Generate hash from hashing object state. After finalization, the hashing
-    // object is in an undefined state and must be initialized before any
-    // subsequent calls on the object.
-    __m128i Finalize() {
+    // Same as Update(src, bytes) after copying src to dst, but the input is read once.
+    void CopyAndUpdate(uint8_t *dst, const uint8_t *src, size_t bytes, const bool non_temporal = false) {
         assert(input_bytes != FINALIZED);
-        if (input_bytes < sizeof(block)) {
-            __m128i hash = SmallKeyAlgorithm(reinterpret_cast<uint8_t *>(input), input_bytes, initialize);
-            input_bytes = FINALIZED;
-            return hash;
-        } else {
-            // process remaining AES blocks
-            if (input_bytes & 32) {
-                block[0] = _mm_aesenc_si128(block[0], input[0]);
-                block[1] = _mm_aesenc_si128(block[1], input[1]);
-            }
-
-            if (input_bytes & 16) {
-                block[2] = _mm_aesenc_si128(block[2], input[2]);
-            }
-
-            // AES sub-block processor
-            const uint8_t *ptr8 = reinterpret_cast<const uint8_t *>(&input[3]);
-            if (input_bytes & 8) {
-                __m128i b =
-                    _mm_set_epi64x(*reinterpret_cast<const uint64_t *>(ptr8), Constants::Constants::CONSTANT_64_1);
-                block[3] = _mm_aesenc_si128(block[3], b);
-                ptr8 += 8;
-            }
-
-            if (input_bytes & 4) {
-                __m128i b = _mm_set_epi32(Constants::CONSTANT_32_1, Constants::CONSTANT_32_2,
-                                          *reinterpret_cast<const uint32_t *>(ptr8), Constants::CONSTANT_32_3);
-                block[0] = _mm_aesenc_si128(block[0], b);
-                ptr8 += 4;
-            }
-
-            if (input_bytes & 2) {
-                __m128i b = _mm_set_epi16(Constants::CONSTANT_16_1, Constants::CONSTANT_16_2, Constants::CONSTANT_16_3,
-                                          Constants::CONSTANT_16_4, Constants::CONSTANT_16_5, Constants::CONSTANT_16_6,
-                                          *reinterpret_cast<const uint16_t *>(ptr8), Constants::CONSTANT_16_7);
-                block[1] = _mm_aesenc_si128(block[1], b);
-                ptr8 += 2;
-            }
+        assert(bytes <= MAXLEN && MAXLEN - input_bytes >= bytes);
 
-            if (input_bytes & 1) {
-                __m128i b =
-                    _mm_set_epi8(Constants::CONSTANT_8_01, Constants::CONSTANT_8_02, Constants::CONSTANT_8_03,
-                                 Constants::CONSTANT_8_04, Constants::CONSTANT_8_05, Constants::CONSTANT_8_06,
-                                 Constants::CONSTANT_8_07, Constants::CONSTANT_8_08, Constants::CONSTANT_8_09,
-                                 Constants::CONSTANT_8_10, Constants::CONSTANT_8_11, Constants::CONSTANT_8_12,
-                                 Constants::CONSTANT_8_13, Constants::CONSTANT_8_14, *ptr8, Constants::CONSTANT_8_15);
-                block[2] = _mm_aesenc_si128(block[2], b);
-            }
+        // fill a partially filled input buffer first
+        if (input_bytes % sizeof(input)) {
+            size_t copy_size = sizeof(input) - (input_bytes % sizeof(input));
+            if (copy_size > bytes) copy_size = bytes;
+            memcpy(dst, src, copy_size);
+            Update(src, copy_size);
+            dst += copy_size;
+            src += copy_size;
+            bytes -= copy_size;
+        }
 
-            // indirectly mix hashing lanes
-            const __m128i mix = _mm_xor_si128(_mm_xor_si128(block[0], block[1]), _mm_xor_si128(block[2], block[3]));
-            block[0] = _mm_aesenc_si128(block[0], mix);
-            block[1] = _mm_aesenc_si128(block[1], mix);
-            block[2] = _mm_aesenc_si128(block[2], mix);
-            block[3] = _mm_aesenc_si128(block[3], mix);
+        if (bytes == 0) return;
 
-            // reduction from 512-bit block size to 128-bit hash
-            __m128i hash = _mm_aesenc_si128(_mm_aesenc_si128(block[0], block[1]), _mm_aesenc_si128(block[2], block[3]));
+        // input buffer is empty
+        input_bytes += bytes;
+        const size_t copied = bytes / sizeof(block) * sizeof(block);
+        aquahash::Dispatcher::CopyStripes(block, dst, src, bytes / sizeof(block), non_temporal);
+        memcpy(dst + copied, src + copied, bytes - copied);
+        memcpy(input, src + copied, bytes - copied);
+    }
 
-            // this algorithm construction requires no less than 1 round to finalize
-            input_bytes = FINALIZED;
-            return _mm_aesenc_si128(hash,
-                                    _mm_set_epi64x(Constants::CONSTANT_64_9, Constants::Constants::CONSTANT_64_10));
-        }
+    // Generate hash from hashing object state. After finalization, the hashing
+    // object is in an undefined state and must be initialized before any
+    // subsequent calls on the object.
+    __m128i Finalize() {
+        assert(input_bytes != FINALIZED);
+        const __m128i hash = aquahash::Dispatcher::Finalize(block, input, input_bytes, initialize);
+        input_bytes = FINALIZED;
+        return hash;
     }
 };
@@ -40,13 +40,22 @@ namespace aquahash {
         /* Finalize the process and return the hash string. */
         void finalize(const std::string &filename) {
             if (count > 1) hashcode = aqua.Finalize();
+            if (!Params::quiet(flags)) print(hashcode, filename);
+        }
+
+        /* Display a hash code using the same format as finalize. */
+        void print(const __m128i code, const std::string &filename) {
+            // Sampled fingerprints are not content digests so they must never be mistaken for one.
+            const char *label = Params::sampled(flags) ? "sampled:" : "";
             if (Params::color(flags)) {
-                printf("\033[1;32m%s  \033[1;34m%s\033[0m\n", writer(hashcode).c_str(), filename.data());
+                printf("\033[1;32m%s%s  \033[1;34m%s\033[0m\n", label, writer(code).c_str(), filename.data());
             } else {
-                printf("%s  %s\n", writer(hashcode).c_str(), filename.data());
+                printf("%s%s  %s\n", label, writer(code).c_str(), filename.data());
             }
         }
 
+        __m128i digest() const { return hashcode; }
+
       private:
         size_t count;
         __m128i seed;
@@ -0,0 +1,297 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "interface.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <immintrin.h>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace aquahash {
+    // A sharded hash map. The shard is selected by the upper 64 bits of the 128-bit AquaHash digest and the bucket
+    // inside a shard by the lower 64 bits so a key is hashed only once.
+    //
+    // Writers take a per-shard mutex. Readers do not lock when the mapped type is trivially copyable: they validate
+    // their result against a per-shard sequence number and retry if a writer was active. Keys are never modified or
+    // destroyed in place, erased slots become tombstones and a rehash publishes a new table. Tables replaced by a
+    // rehash stay alive until reclaim() is called or the map is destroyed because readers may still be scanning them.
+    template <typename Key, typename Value, typename Hash = aquahash::hash<Key>, typename Equal = std::equal_to<Key>>
+    class concurrent_map {
+      public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<const Key, Value>;
+
+        static constexpr size_t DEFAULT_SHARDS = 64;
+        static constexpr size_t INITIAL_CAPACITY = 16;
+
+        explicit concurrent_map(size_t number_of_shards = DEFAULT_SHARDS, const Hash &h = Hash(),
+                                const Equal &eq = Equal())
+            : hasher(h), equal(eq) {
+            size_t shards = 1;
+            while (shards < number_of_shards) shards <<= 1;
+            shard_data.reset(new Shard[shards]);
+            shard_count = shards;
+        }
+
+        concurrent_map(const concurrent_map &) = delete;
+        concurrent_map &operator=(const concurrent_map &) = delete;
+
+        ~concurrent_map() {
+            for (size_t idx = 0; idx < shard_count; ++idx) {
+                delete shard_data[idx].table.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Insert a key if it does not exist. Return true if the key has been inserted.
+        bool insert(const Key &key, const Value &value) {
+            const __m128i h = hasher.digest(key);
+            Shard &s = shard_data[shard(h, shard_count)];
+            std::lock_guard<std::mutex> guard(s.mutex);
+            return insert_locked(s, key, value, low_bits(h), false);
+        }
+
+        // Insert a key or overwrite its value. Return true if the key has been inserted.
+        bool insert_or_assign(const Key &key, const Value &value) {
+            const __m128i h = hasher.digest(key);
+            Shard &s = shard_data[shard(h, shard_count)];
+            std::lock_guard<std::mutex> guard(s.mutex);
+            return insert_locked(s, key, value, low_bits(h), true);
+        }
+
+        // Insert a range of key/value pairs. Keys are hashed up front and grouped by shard so each shard lock is
+        // taken once. Return the number of inserted keys.
+        template <typename Iterator> size_t insert_batch(Iterator first, Iterator last) {
+            struct Item {
+                Iterator it;
+                uint64_t low;
+            };
+
+            std::vector<std::vector<Item>> groups(shard_count);
+            for (Iterator it = first; it != last; ++it) {
+                const __m128i h = hasher.digest(it->first);
+                groups[shard(h, shard_count)].push_back(Item{it, low_bits(h)});
+            }
+
+            size_t count = 0;
+            for (size_t idx = 0; idx < shard_count; ++idx) {
+                if (groups[idx].empty()) continue;
+                Shard &s = shard_data[idx];
+                std::lock_guard<std::mutex> guard(s.mutex);
+                reserve_locked(s, s.size + groups[idx].size());
+                for (auto const &item : groups[idx]) {
+                    count += insert_locked(s, item.it->first, item.it->second, item.low, false);
+                }
+            }
+            return count;
+        }
+
+        // Find a key and copy its value. Return true if the key exists.
+        bool find(const Key &key, Value &value) const {
+            const __m128i h = hasher.digest(key);
+            const Shard &s = shard_data[shard(h, shard_count)];
+            return find_impl(s, key, value, low_bits(h), std::is_trivially_copyable<Value>());
+        }
+
+        bool contains(const Key &key) const {
+            const __m128i h = hasher.digest(key);
+            const Shard &s = shard_data[shard(h, shard_count)];
+            const uint64_t fp = fingerprint(low_bits(h));
+            const Table *table = s.table.load(std::memory_order_acquire);
+            return (table != nullptr) && (locate(table, key, fp) != nullptr);
+        }
+
+        // Remove a key. Return true if the key existed.
+        bool erase(const Key &key) {
+            const __m128i h = hasher.digest(key);
+            Shard &s = shard_data[shard(h, shard_count)];
+            std::lock_guard<std::mutex> guard(s.mutex);
+            Table *table = s.table.load(std::memory_order_relaxed);
+            if (table == nullptr) return false;
+            Slot *slot = locate(table, key, fingerprint(low_bits(h)));
+            if (slot == nullptr) return false;
+            slot->state.store(DELETED, std::memory_order_release);
+            --s.size;
+            ++s.tombstones;
+            return true;
+        }
+
+        size_t size() const {
+            size_t total = 0;
+            for (size_t idx = 0; idx < shard_count; ++idx) {
+                Shard &s = shard_data[idx];
+                std::lock_guard<std::mutex> guard(s.mutex);
+                total += s.size;
+            }
+            return total;
+        }
+
+        size_t number_of_shards() const { return shard_count; }
+
+        // Release tables replaced by earlier rehashes. This must only be called when no other thread is reading.
+        void reclaim() {
+            for (size_t idx = 0; idx < shard_count; ++idx) {
+                Shard &s = shard_data[idx];
+                std::lock_guard<std::mutex> guard(s.mutex);
+                s.retired.clear();
+            }
+        }
+
+      private:
+        static constexpr uint64_t EMPTY = 0;
+        static constexpr uint64_t DELETED = 1;
+
+        struct Slot {
+            std::atomic<uint64_t> state{EMPTY}; // EMPTY, DELETED or the fingerprint of the key.
+            typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+
+            value_type &item() { return *reinterpret_cast<value_type *>(&storage); }
+            const value_type &item() const { return *reinterpret_cast<const value_type *>(&storage); }
+        };
+
+        struct Table {
+            explicit Table(const size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+            ~Table() {
+                for (size_t idx = 0; idx <= mask; ++idx) {
+                    if (slots[idx].state.load(std::memory_order_relaxed) != EMPTY) slots[idx].item().~value_type();
+                }
+            }
+            const size_t mask;
+            std::unique_ptr<Slot[]> slots;
+        };
+
+        // Padding keeps the fields read by every lookup out of cache lines written by neighbouring shards.
+        struct Shard {
+            char front_padding[64];
+            std::atomic<uint64_t> version{0};
+            std::atomic<Table *> table{nullptr};
+            mutable std::mutex mutex;
+            size_t size = 0;
+            size_t tombstones = 0;
+            std::vector<std::unique_ptr<Table>> retired;
+            char back_padding[64];
+        };
+
+        Hash hasher;
+        Equal equal;
+        std::unique_ptr<Shard[]> shard_data;
+        size_t shard_count;
+
+        // Fingerprints share the slot state so they must never collide with EMPTY or DELETED.
+        static uint64_t fingerprint(const uint64_t low) { return low > DELETED ? low : low + 2; }
+
+        const Slot *locate(const Table *table, const Key &key, const uint64_t fp) const {
+            for (size_t pos = fp & table->mask;; pos = (pos + 1) & table->mask) {
+                const Slot &slot = table->slots[pos];
+                const uint64_t state = slot.state.load(std::memory_order_acquire);
+                if (state == EMPTY) return nullptr;
+                if (state == fp && equal(slot.item().first, key)) return &slot;
+            }
+        }
+
+        Slot *locate(Table *table, const Key &key, const uint64_t fp) {
+            return const_cast<Slot *>(static_cast<const concurrent_map *>(this)->locate(table, key, fp));
+        }
+
+        bool find_impl(const Shard &s, const Key &key, Value &value, const uint64_t low, std::true_type) const {
+            const uint64_t fp = fingerprint(low);
+            while (true) {
+                const uint64_t version = s.version.load(std::memory_order_acquire);
+                if (version & 1) {
+                    _mm_pause();
+                    continue;
+                }
+                const Table *table = s.table.load(std::memory_order_acquire);
+                const Slot *slot = (table != nullptr) ? locate(table, key, fp) : nullptr;
+                if (slot != nullptr) value = slot->item().second;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.version.load(std::memory_order_relaxed) == version) return slot != nullptr;
+            }
+        }
+
+        bool find_impl(const Shard &s, const Key &key, Value &value, const uint64_t low, std::false_type) const {
+            std::lock_guard<std::mutex> guard(s.mutex);
+            const Table *table = s.table.load(std::memory_order_relaxed);
+            const Slot *slot = (table != nullptr) ? locate(table, key, fingerprint(low)) : nullptr;
+            if (slot != nullptr) value = slot->item().second;
+            return slot != nullptr;
+        }
+
+        // Make room for a given number of keys while keeping the load factor, tombstones included, below 3/4.
+        void reserve_locked(Shard &s, const size_t count) {
+            Table *table = s.table.load(std::memory_order_relaxed);
+            const size_t capacity = (table != nullptr) ? table->mask + 1 : 0;
+            if ((count + s.tombstones) * 4 < capacity * 3) return;
+
+            size_t new_capacity = INITIAL_CAPACITY;
+            while (new_capacity * 3 <= count * 4) new_capacity <<= 1;
+
+            std::unique_ptr<Table> fresh(new Table(new_capacity));
+            if (table != nullptr) {
+                for (size_t idx = 0; idx <= table->mask; ++idx) {
+                    const Slot &slot = table->slots[idx];
+                    const uint64_t state = slot.state.load(std::memory_order_relaxed);
+                    if (state <= DELETED) continue;
+                    size_t pos = state & fresh->mask;
+                    while (fresh->slots[pos].state.load(std::memory_order_relaxed) != EMPTY) {
+                        pos = (pos + 1) & fresh->mask;
+                    }
+                    new (&fresh->slots[pos].storage) value_type(slot.item());
+                    fresh->slots[pos].state.store(state, std::memory_order_relaxed);
+                }
+            }
+
+            s.version.fetch_add(1, std::memory_order_acq_rel);
+            s.table.store(fresh.release(), std::memory_order_release);
+            s.version.fetch_add(1, std::memory_order_release);
+            if (table != nullptr) s.retired.emplace_back(table);
+            s.tombstones = 0;
+        }
+
+        bool insert_locked(Shard &s, const Key &key, const Value &value, const uint64_t low, const bool assign) {
+            const uint64_t fp = fingerprint(low);
+            Table *table = s.table.load(std::memory_order_relaxed);
+            if (table != nullptr) {
+                Slot *slot = locate(table, key, fp);
+                if (slot != nullptr) {
+                    if (assign) {
+                        s.version.fetch_add(1, std::memory_order_acq_rel);
+                        slot->item().second = value;
+                        s.version.fetch_add(1, std::memory_order_release);
+                    }
+                    return false;
+                }
+            }
+
+            reserve_locked(s, s.size + 1);
+            table = s.table.load(std::memory_order_relaxed);
+
+            // Tombstones are never reused because a reader may still be comparing the key they hold.
+            size_t pos = fp & table->mask;
+            while (table->slots[pos].state.load(std::memory_order_relaxed) != EMPTY) pos = (pos + 1) & table->mask;
+            new (&table->slots[pos].storage) value_type(key, value);
+            table->slots[pos].state.store(fp, std::memory_order_release);
+            ++s.size;
+            return true;
+        }
+    };
+} // namespace aquahash
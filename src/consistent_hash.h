@@ -0,0 +1,157 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+#include <string>
+#include <vector>
+
+namespace aquahash {
+    // Jump consistent hash (Lamping and Veach) using the lower 64 bits of a digest. Only works for buckets that are
+    // numbered 0..N-1 and added or removed at the end.
+    inline int32_t jump_hash(const __m128i digest, const int32_t number_of_buckets) {
+        uint64_t key = low_bits(digest);
+        int64_t b = -1, j = 0;
+        while (j < number_of_buckets) {
+            b = j;
+            key = key * 2862933555777941757ULL + 1;
+            j = static_cast<int64_t>((b + 1) * (double(1LL << 31) / double((key >> 33) + 1)));
+        }
+        return static_cast<int32_t>(b);
+    }
+
+    // Weighted rendezvous hashing. The score of a (key, node) pair is two AES rounds over the key and node digests,
+    // which are independent across nodes so the AES units process several nodes at the same time.
+    class Rendezvous {
+      public:
+        size_t add(const std::string &name, const double weight = 1.0) {
+            nodes.push_back(Node{digest_of(name), weight});
+            return nodes.size() - 1;
+        }
+
+        void remove(const size_t node) { nodes.erase(nodes.begin() + node); }
+
+        size_t size() const { return nodes.size(); }
+
+        // Return the node with the highest score, or size() if there are no nodes.
+        size_t operator()(const __m128i key) const {
+            constexpr size_t BATCH = 4;
+            size_t best = nodes.size();
+            double best_score = -1;
+            size_t idx = 0;
+            for (; idx + BATCH <= nodes.size(); idx += BATCH) {
+                __m128i h[BATCH];
+                for (size_t lane = 0; lane < BATCH; ++lane) h[lane] = mix(key, nodes[idx + lane].digest);
+                for (size_t lane = 0; lane < BATCH; ++lane) {
+                    const double s = score(h[lane], nodes[idx + lane].weight);
+                    if (s > best_score) {
+                        best_score = s;
+                        best = idx + lane;
+                    }
+                }
+            }
+            for (; idx < nodes.size(); ++idx) {
+                const double s = score(mix(key, nodes[idx].digest), nodes[idx].weight);
+                if (s > best_score) {
+                    best_score = s;
+                    best = idx;
+                }
+            }
+            return best;
+        }
+
+        size_t operator()(const std::string &key) const { return (*this)(digest_of(key)); }
+
+      private:
+        struct Node {
+            __m128i digest;
+            double weight;
+        };
+
+        std::vector<Node> nodes;
+
+        static __m128i mix(const __m128i key, const __m128i node) {
+            return aesenc(aesenc(_mm_xor_si128(key, node), node), key);
+        }
+
+        // -weight / ln(u) with u uniformly distributed in (0, 1) gives every node a share proportional to its weight.
+        static double score(const __m128i h, const double weight) {
+            const double u = (static_cast<double>(low_bits(h) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+            return -weight / std::log(u);
+        }
+    };
+
+    // Maglev consistent hashing. Every node fills a prime sized lookup table following its own permutation so a
+    // routing decision is one table read. The table size is rounded up to a prime, otherwise a node whose skip shares a
+    // factor with it would only reach part of the table.
+    class Maglev {
+      public:
+        static constexpr size_t DEFAULT_TABLE_SIZE = 65537;
+
+        explicit Maglev(const std::vector<std::string> &names, const size_t size = DEFAULT_TABLE_SIZE)
+            : table(next_prime(size), -1) {
+            const size_t table_size = table.size();
+            const size_t n = names.size();
+            if (n == 0) return;
+            std::vector<uint64_t> offsets(n), skips(n), next(n, 0);
+            for (size_t idx = 0; idx < n; ++idx) {
+                const __m128i h = digest_of(names[idx]);
+                offsets[idx] = low_bits(h) % table_size;
+                skips[idx] = high_bits(h) % (table_size - 1) + 1;
+            }
+
+            size_t filled = 0;
+            while (true) {
+                for (size_t idx = 0; idx < n; ++idx) {
+                    uint64_t pos = (offsets[idx] + next[idx] * skips[idx]) % table_size;
+                    while (table[pos] >= 0) {
+                        ++next[idx];
+                        pos = (offsets[idx] + next[idx] * skips[idx]) % table_size;
+                    }
+                    table[pos] = static_cast<int32_t>(idx);
+                    ++next[idx];
+                    if (++filled == table_size) return;
+                }
+            }
+        }
+
+        // Return the index of the node in the list given to the constructor, or -1 if there are no nodes.
+        int32_t operator()(const __m128i key) const { return table[low_bits(key) % table.size()]; }
+
+        int32_t operator()(const std::string &key) const { return (*this)(digest_of(key)); }
+
+        size_t size() const { return table.size(); }
+
+        // The smallest prime which is not less than n and at least 2.
+        static size_t next_prime(size_t n) {
+            auto is_prime = [](const size_t value) {
+                for (size_t d = 2; d * d <= value; ++d) {
+                    if (value % d == 0) return false;
+                }
+                return true;
+            };
+            if (n < 2) n = 2;
+            while (!is_prime(n)) ++n;
+            return n;
+        }
+
+      private:
+        std::vector<int32_t> table;
+    };
+} // namespace aquahash
@@ -0,0 +1,354 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <immintrin.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace aquahash {
+    // An immutable key value file in the spirit of cdb. The file is a header, a data section of (key length, value
+    // length, key, value) records, a directory of 2^bucket_bits buckets which is indexed by the upper bits of the
+    // AquaHash digest of a key and, for every bucket, an open addressing table of (fingerprint, offset) slots at most
+    // half full. Data comes before the index so the builder can stream records to disk.
+    //
+    // Opening a file maps it and checks the header and the bucket directory. A lookup costs one AquaHash call, one
+    // bucket read, usually one slot cache line and one record read to compare the key, so false positives of the
+    // 64-bit fingerprints are never returned.
+    class ConstantDB {
+      public:
+        static constexpr uint64_t MAGIC = 0x3142444341555141; // "AQUACDB1"
+        static constexpr uint64_t VERSION = 1;
+        static constexpr size_t BATCH = 16;
+
+        struct Header {
+            uint64_t magic;
+            uint64_t version;
+            uint64_t number_of_keys;
+            uint64_t bucket_bits;
+            uint64_t number_of_slots;
+            uint64_t data_offset; // Byte offsets from the start of the file.
+            uint64_t data_size;
+            uint64_t buckets_offset;
+            uint64_t slots_offset;
+        };
+
+        struct Bucket {
+            uint64_t first; // The first slot of this bucket.
+            uint64_t size;  // A power of two, or zero for an empty bucket.
+        };
+
+        // A zero fingerprint marks an empty slot.
+        struct Slot {
+            uint64_t fingerprint;
+            uint64_t offset; // The record offset in the data section.
+        };
+
+        struct RecordHeader {
+            uint32_t key_size;
+            uint32_t value_size;
+        };
+
+        // A value which points into the mapped file. Data is null if a key is not found.
+        struct Value {
+            const uint8_t *data;
+            size_t size;
+            bool found() const { return data != nullptr; }
+        };
+
+        static uint64_t fingerprint(const __m128i h) {
+            const uint64_t low = low_bits(h);
+            return low ? low : 1;
+        }
+
+        static size_t bucket_of(const __m128i h, const uint64_t bucket_bits) {
+            return bucket_bits ? static_cast<size_t>(high_bits(h) >> (64 - bucket_bits)) : 0;
+        }
+
+        bool open(const std::string &path) {
+            close();
+            if (!file.open(path, MADV_RANDOM) || file.size() < sizeof(Header)) return false;
+            const Header *hdr = reinterpret_cast<const Header *>(file.data());
+            if (hdr->magic != MAGIC || hdr->version != VERSION || hdr->bucket_bits >= 64) return false;
+            const uint64_t number_of_buckets = uint64_t(1) << hdr->bucket_bits;
+            if (!within(hdr->data_offset, hdr->data_size, file.size()) ||
+                number_of_buckets > file.size() / sizeof(Bucket) ||
+                !within(hdr->buckets_offset, number_of_buckets * sizeof(Bucket), file.size()) ||
+                hdr->number_of_slots > file.size() / sizeof(Slot) ||
+                !within(hdr->slots_offset, hdr->number_of_slots * sizeof(Slot), file.size())) {
+                return false;
+            }
+
+            // Lookups trust the directory, so every bucket must be a power of two sized range of the slot table.
+            const Bucket *directory = reinterpret_cast<const Bucket *>(file.data() + hdr->buckets_offset);
+            for (uint64_t idx = 0; idx < number_of_buckets; ++idx) {
+                const Bucket &bucket = directory[idx];
+                const bool power_of_two = (bucket.size & (bucket.size - 1)) == 0;
+                if (!power_of_two || !within(bucket.first, bucket.size, hdr->number_of_slots)) {
+                    return false;
+                }
+            }
+
+            header = hdr;
+            data = file.data() + hdr->data_offset;
+            buckets = directory;
+            slots = reinterpret_cast<const Slot *>(file.data() + hdr->slots_offset);
+            return true;
+        }
+
+        void close() {
+            file.close();
+            header = nullptr;
+        }
+
+        size_t size() const { return header != nullptr ? header->number_of_keys : 0; }
+
+        // Return the first value which was added for a key.
+        Value find(const uint8_t *key, const size_t len) const {
+            if (header == nullptr) return Value{nullptr, 0};
+            Probe probe = start(AquaHash::Hash(key, len));
+            return resolve(probe, key, len);
+        }
+
+        Value find(const std::string &key) const {
+            return find(reinterpret_cast<const uint8_t *>(key.data()), key.size());
+        }
+
+        // Look up a batch of string-like keys. Keys are hashed and their home slots are prefetched first, then the
+        // records of candidate slots are prefetched, so the memory latency of a batch overlaps.
+        template <typename Container> void find(const Container &keys, Value *values) const {
+            const size_t n = keys.size();
+            if (header == nullptr) {
+                std::fill(values, values + n, Value{nullptr, 0});
+                return;
+            }
+
+            for (size_t begin = 0; begin < n; begin += BATCH) {
+                const size_t len = std::min(BATCH, n - begin);
+                Probe probes[BATCH];
+                for (size_t idx = 0; idx < len; ++idx) {
+                    auto const &key = keys[begin + idx];
+                    probes[idx] = start(AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.data()), key.size()));
+                    if (probes[idx].bucket->size) prefetch(slots + probes[idx].bucket->first + probes[idx].pos);
+                }
+
+                for (size_t idx = 0; idx < len; ++idx) {
+                    const Slot *slot = next_candidate(probes[idx]);
+                    if (slot != nullptr) prefetch(data + slot->offset);
+                }
+
+                for (size_t idx = 0; idx < len; ++idx) {
+                    auto const &key = keys[begin + idx];
+                    const uint8_t *ptr = reinterpret_cast<const uint8_t *>(key.data());
+                    values[begin + idx] = resolve(probes[idx], ptr, key.size());
+                }
+            }
+        }
+
+      private:
+        MappedFile file;
+        const Header *header = nullptr;
+        const uint8_t *data = nullptr;
+        const Bucket *buckets = nullptr;
+        const Slot *slots = nullptr;
+
+        // The position of a lookup in the slot table of its bucket.
+        struct Probe {
+            const Bucket *bucket;
+            uint64_t fingerprint;
+            uint64_t pos;
+            uint64_t probes; // The number of slots which were checked.
+        };
+
+        static void prefetch(const void *ptr) { _mm_prefetch(static_cast<const char *>(ptr), _MM_HINT_T0); }
+
+        // Check that [offset, offset + size) lies within [0, limit) without overflowing.
+        static bool within(const uint64_t offset, const uint64_t size, const uint64_t limit) {
+            return offset <= limit && size <= limit - offset;
+        }
+
+        Probe start(const __m128i h) const {
+            const Bucket *bucket = buckets + bucket_of(h, header->bucket_bits);
+            const uint64_t fp = fingerprint(h);
+            return Probe{bucket, fp, bucket->size ? fp & (bucket->size - 1) : 0, 0};
+        }
+
+        // Return the next slot with the fingerprint of a lookup, or null once an empty slot is reached. The probe
+        // stays at the returned slot.
+        const Slot *next_candidate(Probe &probe) const {
+            const Bucket &bucket = *probe.bucket;
+            for (; probe.probes < bucket.size; ++probe.probes, probe.pos = (probe.pos + 1) & (bucket.size - 1)) {
+                const Slot &slot = slots[bucket.first + probe.pos];
+                if (slot.fingerprint == 0) break;
+                if (slot.fingerprint == probe.fingerprint) return &slot;
+            }
+            probe.probes = bucket.size;
+            return nullptr;
+        }
+
+        Value resolve(Probe &probe, const uint8_t *key, const size_t len) const {
+            for (const Slot *slot = next_candidate(probe); slot != nullptr; slot = next_candidate(probe)) {
+                RecordHeader record;
+                if (within(slot->offset, sizeof(record), header->data_size)) {
+                    memcpy(&record, data + slot->offset, sizeof(record));
+                    const uint8_t *ptr = data + slot->offset + sizeof(record);
+                    const uint64_t end = slot->offset + sizeof(record) + record.key_size + record.value_size;
+                    if (end <= header->data_size && record.key_size == len && memcmp(ptr, key, len) == 0) {
+                        return Value{ptr + len, record.value_size};
+                    }
+                }
+                ++probe.probes;
+                probe.pos = (probe.pos + 1) & (probe.bucket->size - 1);
+            }
+            return Value{nullptr, 0};
+        }
+    };
+
+    // Write a ConstantDB file. Records are streamed to a temporary file as they are added and only their digests and
+    // offsets are kept in memory. finish builds the slot tables of all buckets in parallel, appends them and renames
+    // the file into place so readers never see a partial file.
+    class ConstantDBBuilder {
+      public:
+        static constexpr size_t BUCKET_SIZE = 1 << 12; // The average number of keys per bucket.
+        static constexpr size_t ALIGNMENT = 64;
+
+        explicit ConstantDBBuilder(const size_t threads = default_threads()) : threads(std::max<size_t>(1, threads)) {}
+
+        bool open(const std::string &output) {
+            path = output;
+            temp_path = output + "." + std::to_string(::getpid()) + ".tmp";
+            entries.clear();
+            data_size = 0;
+            const ConstantDB::Header header{};
+            return writer.open(temp_path) && writer.write_value(header);
+        }
+
+        // Keys may repeat, lookups return the first value of a key.
+        bool add(const uint8_t *key, const size_t key_size, const uint8_t *value, const size_t value_size) {
+            if (key_size > UINT32_MAX || value_size > UINT32_MAX) return false;
+            const __m128i h = AquaHash::Hash(key, key_size);
+            entries.push_back(Entry{low_bits(h), high_bits(h), data_size});
+            const ConstantDB::RecordHeader record{static_cast<uint32_t>(key_size), static_cast<uint32_t>(value_size)};
+            data_size += sizeof(record) + key_size + value_size;
+            return writer.write_value(record) && writer.write(key, key_size) && writer.write(value, value_size);
+        }
+
+        bool add(const std::string &key, const std::string &value) {
+            return add(reinterpret_cast<const uint8_t *>(key.data()), key.size(),
+                       reinterpret_cast<const uint8_t *>(value.data()), value.size());
+        }
+
+        bool finish() {
+            const size_t n = entries.size();
+            uint64_t bits = 0;
+            while (bits < 32 && (n >> bits) > BUCKET_SIZE) ++bits;
+            const size_t number_of_buckets = size_t(1) << bits;
+
+            // Group entries by bucket with a stable counting sort so duplicate keys keep their order.
+            std::vector<size_t> offsets(number_of_buckets + 1, 0);
+            for (auto const &entry : entries) ++offsets[bucket_of(entry, bits) + 1];
+            for (size_t idx = 0; idx < number_of_buckets; ++idx) offsets[idx + 1] += offsets[idx];
+            std::vector<Entry> sorted(n);
+            {
+                std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+                for (auto const &entry : entries) sorted[pos[bucket_of(entry, bits)]++] = entry;
+            }
+            std::vector<Entry>().swap(entries);
+
+            std::vector<ConstantDB::Bucket> buckets(number_of_buckets);
+            uint64_t number_of_slots = 0;
+            for (size_t idx = 0; idx < number_of_buckets; ++idx) {
+                const size_t count = offsets[idx + 1] - offsets[idx];
+                uint64_t size = count ? 2 : 0;
+                while (size < 2 * count) size <<= 1;
+                buckets[idx] = ConstantDB::Bucket{number_of_slots, size};
+                number_of_slots += size;
+            }
+
+            std::vector<ConstantDB::Slot> slots(number_of_slots, ConstantDB::Slot{0, 0});
+            parallel_for(number_of_buckets, threads, [&](const size_t idx, const size_t) {
+                const ConstantDB::Bucket &bucket = buckets[idx];
+                ConstantDB::Slot *table = slots.data() + bucket.first;
+                for (size_t pos = offsets[idx]; pos < offsets[idx + 1]; ++pos) {
+                    const __m128i h = _mm_set_epi64x(sorted[pos].high, sorted[pos].low);
+                    const uint64_t fp = ConstantDB::fingerprint(h);
+                    uint64_t slot = fp & (bucket.size - 1);
+                    while (table[slot].fingerprint) slot = (slot + 1) & (bucket.size - 1);
+                    table[slot] = ConstantDB::Slot{fp, sorted[pos].offset};
+                }
+            });
+
+            // Align the index so that a slot never spans two cache lines.
+            ConstantDB::Header header;
+            header.magic = ConstantDB::MAGIC;
+            header.version = ConstantDB::VERSION;
+            header.number_of_keys = n;
+            header.bucket_bits = bits;
+            header.number_of_slots = number_of_slots;
+            header.data_offset = sizeof(header);
+            header.data_size = data_size;
+            header.buckets_offset = align(header.data_offset + data_size);
+            header.slots_offset = align(header.buckets_offset + number_of_buckets * sizeof(ConstantDB::Bucket));
+
+            const char padding[ALIGNMENT] = {0};
+            bool ok = writer.write(padding, header.buckets_offset - header.data_offset - data_size) &&
+                      writer.write(buckets.data(), buckets.size() * sizeof(ConstantDB::Bucket)) &&
+                      writer.write(padding, header.slots_offset - header.buckets_offset -
+                                                number_of_buckets * sizeof(ConstantDB::Bucket)) &&
+                      writer.write(slots.data(), slots.size() * sizeof(ConstantDB::Slot));
+            ok = writer.close() && ok && write_header(header) && ::rename(temp_path.data(), path.data()) == 0;
+            if (!ok) ::unlink(temp_path.data());
+            return ok;
+        }
+
+      private:
+        struct Entry {
+            uint64_t low;
+            uint64_t high;
+            uint64_t offset;
+        };
+
+        size_t threads;
+        std::string path;
+        std::string temp_path;
+        FileWriter writer;
+        std::vector<Entry> entries;
+        uint64_t data_size = 0;
+
+        static size_t bucket_of(const Entry &entry, const uint64_t bits) {
+            return bits ? static_cast<size_t>(entry.high >> (64 - bits)) : 0;
+        }
+
+        static uint64_t align(const uint64_t offset) { return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+        bool write_header(const ConstantDB::Header &header) const {
+            const int fd = ::open(temp_path.data(), O_WRONLY | O_CLOEXEC);
+            if (fd < 0) return false;
+            const bool ok = ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+            return (::close(fd) == 0) && ok;
+        }
+    };
+} // namespace aquahash
@@ -0,0 +1,210 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aes.h"
+#include "aquahash.h"
+#include "interface.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// AquaHash as constant expressions using the software AES round. It gives the same hash codes as AquaHash but is much
+// slower, so it is meant for string literals which are hashed at compile time.
+class ConstexprAquaHash : AquaHashBase {
+  public:
+    template <typename Char>
+    static constexpr aquahash::Block128 SmallKeyAlgorithm(const Char *key, const size_t bytes,
+                                                          const aquahash::Block128 initialize = {0, 0}) {
+        aquahash::Block128 hash = initialize;
+        size_t pos = 0;
+        if (bytes / 16) {
+            aquahash::Block128 temp = block(Constants::CONSTANT_64_1, Constants::CONSTANT_64_2);
+            for (; pos + 16 <= bytes; pos += 16) {
+                const aquahash::Block128 b = load128(key + pos);
+                hash = Round(hash, b);
+                temp = Round(temp, b);
+            }
+            hash = Round(hash, temp);
+        }
+
+        // AES sub-block processor
+        if (bytes & 8) {
+            hash = xor128(hash, block(load(key + pos, 8), Constants::CONSTANT_64_1));
+            pos += 8;
+        }
+
+        if (bytes & 4) {
+            hash = xor128(hash, sub_block4(load(key + pos, 4)));
+            pos += 4;
+        }
+
+        if (bytes & 2) {
+            hash = xor128(hash, sub_block2(load(key + pos, 2)));
+            pos += 2;
+        }
+
+        if (bytes & 1) {
+            hash = xor128(hash, sub_block1(load(key + pos, 1)));
+        }
+
+        hash = Round(hash, block(Constants::CONSTANT_64_9, Constants::CONSTANT_64_10));
+        hash = Round(hash, block(Constants::CONSTANT_64_11, Constants::CONSTANT_64_12));
+        return Round(hash, block(Constants::CONSTANT_64_13, Constants::CONSTANT_64_14));
+    }
+
+    template <typename Char>
+    static constexpr aquahash::Block128 LargeKeyAlgorithm(const Char *key, const size_t bytes,
+                                                          const aquahash::Block128 initialize = {0, 0}) {
+        aquahash::Block128 lanes[4] = {xor128(initialize, block(Constants::CONSTANT_64_1, Constants::CONSTANT_64_2)),
+                                       xor128(initialize, block(Constants::CONSTANT_64_3, Constants::CONSTANT_64_4)),
+                                       xor128(initialize, block(Constants::CONSTANT_64_5, Constants::CONSTANT_64_6)),
+                                       xor128(initialize, block(Constants::CONSTANT_64_7, Constants::CONSTANT_64_8))};
+
+        size_t pos = 0;
+        for (; pos + 64 <= bytes; pos += 64) {
+            for (size_t lane = 0; lane < 4; ++lane) lanes[lane] = Round(lanes[lane], load128(key + pos + 16 * lane));
+        }
+
+        // process remaining AES blocks
+        if (bytes & 32) {
+            lanes[0] = Round(lanes[0], load128(key + pos));
+            lanes[1] = Round(lanes[1], load128(key + pos + 16));
+            pos += 32;
+        }
+
+        if (bytes & 16) {
+            lanes[2] = Round(lanes[2], load128(key + pos));
+            pos += 16;
+        }
+
+        // AES sub-block processor
+        if (bytes & 8) {
+            lanes[3] = Round(lanes[3], block(load(key + pos, 8), Constants::CONSTANT_64_1));
+            pos += 8;
+        }
+
+        if (bytes & 4) {
+            lanes[0] = Round(lanes[0], sub_block4(load(key + pos, 4)));
+            pos += 4;
+        }
+
+        if (bytes & 2) {
+            lanes[1] = Round(lanes[1], sub_block2(load(key + pos, 2)));
+            pos += 2;
+        }
+
+        if (bytes & 1) {
+            lanes[2] = Round(lanes[2], sub_block1(load(key + pos, 1)));
+        }
+
+        // indirectly mix hashing lanes
+        const aquahash::Block128 mix = xor128(xor128(lanes[0], lanes[1]), xor128(lanes[2], lanes[3]));
+        for (size_t lane = 0; lane < 4; ++lane) lanes[lane] = Round(lanes[lane], mix);
+
+        // reduction from 512-bit block size to 128-bit hash
+        const aquahash::Block128 hash = Round(Round(lanes[0], lanes[1]), Round(lanes[2], lanes[3]));
+        return Round(hash, block(Constants::CONSTANT_64_9, Constants::CONSTANT_64_10));
+    }
+
+    template <typename Char>
+    static constexpr aquahash::Block128 Hash(const Char *key, const size_t bytes,
+                                             const aquahash::Block128 initialize = {0, 0}) {
+        return bytes < THRESHOLD ? SmallKeyAlgorithm(key, bytes, initialize)
+                                 : LargeKeyAlgorithm(key, bytes, initialize);
+    }
+
+  private:
+    static constexpr aquahash::Block128 Round(const aquahash::Block128 state, const aquahash::Block128 key) {
+        return aquahash::SoftwareAES::Round(state, key);
+    }
+
+    // Same argument order as _mm_set_epi64x.
+    static constexpr aquahash::Block128 block(const int64_t high, const int64_t low) {
+        return aquahash::Block128{static_cast<uint64_t>(low), static_cast<uint64_t>(high)};
+    }
+
+    static constexpr aquahash::Block128 xor128(const aquahash::Block128 x, const aquahash::Block128 y) {
+        return aquahash::Block128{x.low ^ y.low, x.high ^ y.high};
+    }
+
+    // Little endian load of up to 8 bytes.
+    template <typename Char> static constexpr uint64_t load(const Char *ptr, const size_t bytes) {
+        uint64_t value = 0;
+        for (size_t idx = 0; idx < bytes; ++idx) value |= uint64_t(static_cast<uint8_t>(ptr[idx])) << (8 * idx);
+        return value;
+    }
+
+    template <typename Char> static constexpr aquahash::Block128 load128(const Char *ptr) {
+        return aquahash::Block128{load(ptr, 8), load(ptr + 8, 8)};
+    }
+
+    // The blocks built by _mm_set_epi32, _mm_set_epi16 and _mm_set_epi8 in AquaHashKernel.
+    static constexpr aquahash::Block128 sub_block4(const uint64_t value) {
+        return aquahash::Block128{(value << 32) | static_cast<uint32_t>(Constants::CONSTANT_32_3),
+                                  (uint64_t(static_cast<uint32_t>(Constants::CONSTANT_32_1)) << 32) |
+                                      static_cast<uint32_t>(Constants::CONSTANT_32_2)};
+    }
+
+    static constexpr aquahash::Block128 sub_block2(const uint64_t value) {
+        const uint16_t words[8] = {static_cast<uint16_t>(Constants::CONSTANT_16_7), static_cast<uint16_t>(value),
+                                   static_cast<uint16_t>(Constants::CONSTANT_16_6),
+                                   static_cast<uint16_t>(Constants::CONSTANT_16_5),
+                                   static_cast<uint16_t>(Constants::CONSTANT_16_4),
+                                   static_cast<uint16_t>(Constants::CONSTANT_16_3),
+                                   static_cast<uint16_t>(Constants::CONSTANT_16_2),
+                                   static_cast<uint16_t>(Constants::CONSTANT_16_1)};
+        aquahash::Block128 b{0, 0};
+        for (int idx = 0; idx < 4; ++idx) {
+            b.low |= uint64_t(words[idx]) << (16 * idx);
+            b.high |= uint64_t(words[idx + 4]) << (16 * idx);
+        }
+        return b;
+    }
+
+    static constexpr aquahash::Block128 sub_block1(const uint64_t value) {
+        const int8_t bytes[16] = {Constants::CONSTANT_8_15, static_cast<int8_t>(value), Constants::CONSTANT_8_14,
+                                  Constants::CONSTANT_8_13, Constants::CONSTANT_8_12,   Constants::CONSTANT_8_11,
+                                  Constants::CONSTANT_8_10, Constants::CONSTANT_8_09,   Constants::CONSTANT_8_08,
+                                  Constants::CONSTANT_8_07, Constants::CONSTANT_8_06,   Constants::CONSTANT_8_05,
+                                  Constants::CONSTANT_8_04, Constants::CONSTANT_8_03,   Constants::CONSTANT_8_02,
+                                  Constants::CONSTANT_8_01};
+        aquahash::Block128 b{0, 0};
+        for (int idx = 0; idx < 8; ++idx) {
+            b.low |= uint64_t(static_cast<uint8_t>(bytes[idx])) << (8 * idx);
+            b.high |= uint64_t(static_cast<uint8_t>(bytes[idx + 8])) << (8 * idx);
+        }
+        return b;
+    }
+};
+
+namespace aquahash {
+    // The lower 64 bits of the hash code of a key using the default seed, which is also what aquahash::hash returns.
+    inline uint64_t hash64(const char *key, const size_t bytes) {
+        return low_bits(AquaHash::Hash(reinterpret_cast<const uint8_t *>(key), bytes));
+    }
+
+    inline uint64_t hash64(const std::string &key) { return hash64(key.data(), key.size()); }
+
+    // The same value computed at compile time.
+    constexpr uint64_t static_hash64(const char *key, const size_t bytes) {
+        return ConstexprAquaHash::Hash(key, bytes).low;
+    }
+
+    inline namespace literals {
+        // "foo"_aqh == aquahash::hash64("foo"), for example to switch on strings.
+        constexpr uint64_t operator""_aqh(const char *key, const size_t bytes) { return static_hash64(key, bytes); }
+    } // namespace literals
+} // namespace aquahash
@@ -0,0 +1,243 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <immintrin.h>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace aquahash {
+    // A blocked count-min sketch with D rows. The upper 64 bits of an AquaHash digest select one 64-byte block of
+    // sixteen 32-bit counters and the lower 64 bits select one counter per row inside that block, so an update or a
+    // query touches a single cache line. D is at most 4: with 8 rows a row has only 2 counters in a block, and with 16
+    // rows every key of a block hits the same counters, so more rows would not add accuracy.
+    template <size_t D = 4> class CountMinSketch {
+        static_assert(D == 1 || D == 2 || D == 4, "D must be 1, 2 or 4");
+
+      public:
+        static constexpr size_t COUNTERS_PER_BLOCK = 16;
+        static constexpr size_t COUNTERS_PER_ROW = COUNTERS_PER_BLOCK / D;
+        static constexpr size_t PREFETCH_DISTANCE = 8;
+
+        // The width is the number of 64-byte blocks and it is rounded up to a power of two.
+        explicit CountMinSketch(const size_t width = 1 << 16, const bool conservative_update = false)
+            : number_of_blocks(round_up(width)), conservative(conservative_update), blocks(allocate(number_of_blocks)) {
+            clear();
+        }
+
+        CountMinSketch(const CountMinSketch &other)
+            : number_of_blocks(other.number_of_blocks), conservative(other.conservative),
+              blocks(allocate(number_of_blocks)) {
+            std::copy(other.blocks.get(), other.blocks.get() + number_of_blocks, blocks.get());
+        }
+
+        size_t width() const { return number_of_blocks; }
+
+        void clear() { std::fill(blocks.get(), blocks.get() + number_of_blocks, Block{}); }
+
+        // Add count to a key and return its updated estimate.
+        uint32_t update(const __m128i digest, const uint32_t count = 1) {
+            Block &block = blocks[high_bits(digest) & (number_of_blocks - 1)];
+            size_t pos[D];
+            positions(low_bits(digest), pos);
+            if (!conservative) {
+                uint32_t estimate = UINT32_MAX;
+                for (size_t row = 0; row < D; ++row) {
+                    block.counters[pos[row]] += count;
+                    estimate = std::min(estimate, block.counters[pos[row]]);
+                }
+                return estimate;
+            }
+
+            // Conservative update only raises counters that are below the new estimate.
+            uint32_t estimate = UINT32_MAX;
+            for (size_t row = 0; row < D; ++row) estimate = std::min(estimate, block.counters[pos[row]]);
+            estimate += count;
+            for (size_t row = 0; row < D; ++row) {
+                block.counters[pos[row]] = std::max(block.counters[pos[row]], estimate);
+            }
+            return estimate;
+        }
+
+        uint32_t update(const uint8_t *key, const size_t len, const uint32_t count = 1) {
+            return update(AquaHash::Hash(key, len), count);
+        }
+
+        // Update many keys. Blocks are prefetched ahead of their update to hide cache misses.
+        void update_batch(const __m128i *digests, const size_t n, const uint32_t count = 1) {
+            for (size_t idx = 0; idx < n; ++idx) {
+                if (idx + PREFETCH_DISTANCE < n) {
+                    const uint64_t high = high_bits(digests[idx + PREFETCH_DISTANCE]);
+                    _mm_prefetch(reinterpret_cast<const char *>(&blocks[high & (number_of_blocks - 1)]), _MM_HINT_T0);
+                }
+                update(digests[idx], count);
+            }
+        }
+
+        uint32_t estimate(const __m128i digest) const {
+            const Block &block = blocks[high_bits(digest) & (number_of_blocks - 1)];
+            size_t pos[D];
+            positions(low_bits(digest), pos);
+            uint32_t result = UINT32_MAX;
+            for (size_t row = 0; row < D; ++row) result = std::min(result, block.counters[pos[row]]);
+            return result;
+        }
+
+        uint32_t estimate(const uint8_t *key, const size_t len) const { return estimate(AquaHash::Hash(key, len)); }
+
+        // Add the counters of a sketch with the same shape, for example a thread local sketch.
+        bool merge(const CountMinSketch &other) {
+            if (other.number_of_blocks != number_of_blocks) return false;
+            const __m128i *src = reinterpret_cast<const __m128i *>(other.blocks.get());
+            __m128i *dst = reinterpret_cast<__m128i *>(blocks.get());
+            const size_t n = number_of_blocks * sizeof(Block) / sizeof(__m128i);
+            for (size_t idx = 0; idx < n; ++idx) {
+                _mm_store_si128(dst + idx, _mm_add_epi32(_mm_load_si128(dst + idx), _mm_load_si128(src + idx)));
+            }
+            return true;
+        }
+
+      private:
+        struct alignas(64) Block {
+            uint32_t counters[COUNTERS_PER_BLOCK];
+        };
+
+        struct Deleter {
+            void operator()(Block *ptr) const { free(ptr); }
+        };
+
+        size_t number_of_blocks;
+        bool conservative;
+        std::unique_ptr<Block[], Deleter> blocks;
+
+        static Block *allocate(const size_t n) {
+            void *ptr = nullptr;
+            if (posix_memalign(&ptr, sizeof(Block), n * sizeof(Block)) != 0) return nullptr;
+            return static_cast<Block *>(ptr);
+        }
+
+        static size_t round_up(const size_t n) {
+            size_t result = 1;
+            while (result < n) result <<= 1;
+            return result;
+        }
+
+        // Every row owns COUNTERS_PER_ROW counters of a block and uses its own bits of the digest.
+        static void positions(const uint64_t low, size_t *pos) {
+            constexpr size_t BITS = COUNTERS_PER_ROW > 1 ? __builtin_ctz(COUNTERS_PER_ROW) : 0;
+            for (size_t row = 0; row < D; ++row) {
+                pos[row] = row * COUNTERS_PER_ROW + ((low >> (row * BITS)) & (COUNTERS_PER_ROW - 1));
+            }
+        }
+    };
+
+    // Track the top K keys of a stream using a count-min sketch for frequency estimates. The key digest is computed
+    // once per update and shared by the sketch and the candidate table, which is keyed by the lower 64 bits. Keys
+    // with the same 64-bit fingerprint share a candidate, which belongs to the key with the larger estimate.
+    template <typename Key, size_t D = 4, typename Hash = aquahash::hash<Key>> class HeavyHitters {
+      public:
+        explicit HeavyHitters(const size_t k, const size_t width = 1 << 16, const bool conservative_update = true)
+            : capacity(k), sketch(width, conservative_update) {}
+
+        void update(const Key &key, const uint32_t count = 1) {
+            const __m128i digest = hasher.digest(key);
+            const uint32_t estimate = sketch.update(digest, count);
+            const uint64_t fingerprint = low_bits(digest);
+            auto it = candidates.find(fingerprint);
+            if (it != candidates.end()) {
+                if (it->second.first == key || it->second.second < estimate) it->second = Item(key, estimate);
+                return;
+            }
+            if (candidates.size() < capacity) {
+                candidates.emplace(fingerprint, Item(key, estimate));
+                order.emplace(estimate, fingerprint);
+                return;
+            }
+
+            // Tracked keys update their estimates in place, so the order index only holds lower bounds. Stale entries
+            // at the front are refreshed until the smallest one is current, which keeps updates of tracked keys O(1).
+            while (!order.empty() && estimate > order.begin()->first) {
+                const auto smallest = *order.begin();
+                order.erase(order.begin());
+                auto tracked = candidates.find(smallest.second);
+                if (tracked->second.second == smallest.first) {
+                    candidates.erase(tracked);
+                    candidates.emplace(fingerprint, Item(key, estimate));
+                    order.emplace(estimate, fingerprint);
+                    return;
+                }
+                order.emplace(tracked->second.second, smallest.second);
+            }
+        }
+
+        template <typename Iterator> void update_batch(Iterator first, Iterator last) {
+            for (; first != last; ++first) update(*first);
+        }
+
+        // Merge another tracker with the same shape. Candidates are re-estimated using the merged sketch.
+        bool merge(const HeavyHitters &other) {
+            if (!sketch.merge(other.sketch)) return false;
+            for (auto const &item : other.candidates) candidates.insert(item);
+            std::vector<std::pair<uint64_t, Item>> items;
+            for (auto const &item : candidates) {
+                const uint32_t estimate = sketch.estimate(hasher.digest(item.second.first));
+                items.emplace_back(item.first, Item(item.second.first, estimate));
+            }
+            std::sort(items.begin(), items.end(),
+                      [](auto const &a, auto const &b) { return a.second.second > b.second.second; });
+            if (items.size() > capacity) items.resize(capacity);
+            candidates.clear();
+            order.clear();
+            for (auto const &item : items) {
+                candidates.insert(item);
+                order.emplace(item.second.second, item.first);
+            }
+            return true;
+        }
+
+        // Return the tracked keys ordered by their estimated count.
+        std::vector<std::pair<Key, uint32_t>> top() const {
+            std::vector<std::pair<Key, uint32_t>> items;
+            for (auto const &item : candidates) items.push_back(item.second);
+            std::sort(items.begin(), items.end(), [](auto const &a, auto const &b) { return a.second > b.second; });
+            return items;
+        }
+
+        const CountMinSketch<D> &counts() const { return sketch; }
+
+      private:
+        using Item = std::pair<Key, uint32_t>;
+
+        struct Identity {
+            size_t operator()(const uint64_t value) const noexcept { return value; }
+        };
+
+        using Candidates = std::unordered_map<uint64_t, Item, Identity>;
+
+        size_t capacity;
+        Hash hasher;
+        CountMinSketch<D> sketch;
+        Candidates candidates;
+        std::set<std::pair<uint32_t, uint64_t>> order; // (estimate, fingerprint) of every candidate.
+    };
+} // namespace aquahash
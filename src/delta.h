@@ -0,0 +1,359 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <emmintrin.h>
+#include <string>
+#include <vector>
+
+// rsync style delta encoding. The receiver sends a signature of its copy of a file, which has a weak rolling checksum
+// and a truncated AquaHash digest for every block. The sender rolls the weak checksum over its version of the file and
+// encodes every window which matches a block as a copy of that block, everything else is sent as literal bytes.
+namespace aquahash {
+    // The rsync weak checksum: a is the sum of the bytes and b is the sum of the bytes weighted by their distance to
+    // the end of the block, both mod 2^16. Blocks are processed 16 bytes at a time using SSE2.
+    inline uint32_t weak_checksum(const uint8_t *data, const size_t len) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i weights_low = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+        const __m128i weights_high = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+        __m128i sums = zero, prefix = zero, weighted = zero;
+        const size_t chunks = len / 16;
+        for (size_t idx = 0; idx < chunks; ++idx) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * idx));
+            prefix = _mm_add_epi64(prefix, sums);
+            sums = _mm_add_epi64(sums, _mm_sad_epu8(x, zero));
+            weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), weights_low));
+            weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), weights_high));
+        }
+
+        // The weight of byte j of chunk c is 16 * (chunks - 1 - c) + tail + (16 - j).
+        alignas(16) uint64_t s[2], p[2];
+        alignas(16) uint32_t w[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(s), sums);
+        _mm_store_si128(reinterpret_cast<__m128i *>(p), prefix);
+        _mm_store_si128(reinterpret_cast<__m128i *>(w), weighted);
+        const size_t tail = len - 16 * chunks;
+        uint32_t a = static_cast<uint32_t>(s[0] + s[1]);
+        uint32_t b = static_cast<uint32_t>(16 * (p[0] + p[1]) + tail * a) + w[0] + w[1] + w[2] + w[3];
+        for (size_t pos = 16 * chunks; pos < len; ++pos) {
+            a += data[pos];
+            b += static_cast<uint32_t>(len - pos) * data[pos];
+        }
+        return (a & 0xffff) | (b << 16);
+    }
+
+    // The weak checksum of a window which moves one byte at a time.
+    class RollingChecksum {
+      public:
+        RollingChecksum(const uint8_t *data, const size_t len) : window(static_cast<uint32_t>(len)) {
+            const uint32_t value = weak_checksum(data, len);
+            a = value & 0xffff;
+            b = value >> 16;
+        }
+
+        uint32_t value() const { return (a & 0xffff) | (b << 16); }
+
+        // Remove the first byte of the window and append the next byte.
+        void roll(const uint8_t out, const uint8_t in) {
+            a += static_cast<uint32_t>(in) - out;
+            b += a - window * out;
+        }
+
+      private:
+        uint32_t window;
+        uint32_t a;
+        uint32_t b;
+    };
+
+    // Weak checksums and truncated AquaHash digests of the full blocks of a file.
+    class Signature {
+      public:
+        static constexpr uint64_t MAGIC = 0x3147495341555141; // "AQUASIG1"
+        static constexpr uint32_t DEFAULT_BLOCK_SIZE = 4096;
+        static constexpr uint32_t DEFAULT_STRONG_BYTES = 8;
+
+        struct Header {
+            uint64_t magic;
+            uint32_t block_size;
+            uint32_t strong_bytes;
+            uint64_t file_size;
+            uint64_t number_of_blocks;
+        };
+
+        // The last partial block of a file has no signature, it is always sent as literal bytes.
+        bool compute(const uint8_t *data, const size_t len, const uint32_t block_size = DEFAULT_BLOCK_SIZE,
+                     const uint32_t strong_bytes = DEFAULT_STRONG_BYTES) {
+            if (block_size == 0 || strong_bytes == 0 || strong_bytes > sizeof(__m128i)) return false;
+            header = Header{MAGIC, block_size, strong_bytes, len, len / block_size};
+            weak_sums.resize(header.number_of_blocks);
+            strong_sums.resize(header.number_of_blocks * strong_bytes);
+            for (size_t idx = 0; idx < header.number_of_blocks; ++idx) {
+                const uint8_t *block = data + idx * block_size;
+                weak_sums[idx] = weak_checksum(block, block_size);
+                const __m128i digest = AquaHash::Hash(block, block_size);
+                memcpy(&strong_sums[idx * strong_bytes], &digest, strong_bytes);
+            }
+            return true;
+        }
+
+        bool save(const std::string &path) const {
+            FileWriter writer;
+            if (!writer.open(path)) return false;
+            writer.write_value(header);
+            writer.write(weak_sums.data(), weak_sums.size() * sizeof(uint32_t));
+            writer.write(strong_sums.data(), strong_sums.size());
+            return writer.close();
+        }
+
+        bool load(const std::string &path) {
+            MappedFile file;
+            if (!file.open(path) || file.size() < sizeof(Header)) return false;
+            Header hdr;
+            memcpy(&hdr, file.data(), sizeof(Header));
+            if (hdr.magic != MAGIC || hdr.block_size == 0 || hdr.strong_bytes == 0 ||
+                hdr.strong_bytes > sizeof(__m128i) ||
+                hdr.number_of_blocks > (file.size() - sizeof(Header)) / (sizeof(uint32_t) + hdr.strong_bytes) ||
+                file.size() != sizeof(Header) + hdr.number_of_blocks * (sizeof(uint32_t) + hdr.strong_bytes)) {
+                return false;
+            }
+            header = hdr;
+            const uint8_t *ptr = file.data() + sizeof(Header);
+            weak_sums.resize(hdr.number_of_blocks);
+            memcpy(weak_sums.data(), ptr, weak_sums.size() * sizeof(uint32_t));
+            strong_sums.assign(ptr + weak_sums.size() * sizeof(uint32_t), file.data() + file.size());
+            return true;
+        }
+
+        size_t size() const { return header.number_of_blocks; }
+        uint32_t block_size() const { return header.block_size; }
+        uint32_t strong_bytes() const { return header.strong_bytes; }
+        uint64_t file_size() const { return header.file_size; }
+        uint32_t weak(const size_t block) const { return weak_sums[block]; }
+        const uint8_t *strong(const size_t block) const { return &strong_sums[block * header.strong_bytes]; }
+
+      private:
+        Header header{MAGIC, DEFAULT_BLOCK_SIZE, DEFAULT_STRONG_BYTES, 0, 0};
+        std::vector<uint32_t> weak_sums;
+        std::vector<uint8_t> strong_sums;
+    };
+
+    // Find blocks by their weak checksum. A bit filter with 64 bits per block rejects most windows before the open
+    // addressing table is read, and the AquaHash digest of a window is only computed if its weak checksum matches a
+    // block. Blocks with the same content are stored once.
+    class BlockIndex {
+      public:
+        explicit BlockIndex(const Signature &signature) : sig(signature) {
+            const size_t n = sig.size();
+            size_t capacity = 16;
+            while (capacity < 2 * n) capacity <<= 1;
+            table.assign(capacity, Entry{0, EMPTY});
+            mask = capacity - 1;
+            filter_bits = 16;
+            while (filter_bits < 28 && (size_t(1) << filter_bits) < 64 * n) ++filter_bits;
+            filter.assign((size_t(1) << filter_bits) / 64, 0);
+
+            for (size_t block = 0; block < n; ++block) {
+                const uint32_t weak = sig.weak(block);
+                size_t pos = slot(weak);
+                while (table[pos].block != EMPTY && !(table[pos].weak == weak && same_block(table[pos].block, block))) {
+                    pos = (pos + 1) & mask;
+                }
+                if (table[pos].block != EMPTY) continue;
+                table[pos] = Entry{weak, static_cast<uint32_t>(block)};
+                const uint64_t bit = filter_bit(weak);
+                filter[bit / 64] |= uint64_t(1) << (bit % 64);
+            }
+        }
+
+        bool may_contain(const uint32_t weak) const {
+            const uint64_t bit = filter_bit(weak);
+            return (filter[bit / 64] >> (bit % 64)) & 1;
+        }
+
+        // Return a block with the same content as the window of block_size bytes, or -1. The hint, usually the block
+        // after the previous match, is tried first so runs of blocks are found in order.
+        int64_t find(const uint32_t weak, const uint8_t *window, const size_t hint) const {
+            __m128i digest;
+            bool has_digest = false;
+            auto matches = [&](const size_t block) {
+                if (!has_digest) {
+                    digest = AquaHash::Hash(window, sig.block_size());
+                    has_digest = true;
+                }
+                return memcmp(sig.strong(block), &digest, sig.strong_bytes()) == 0;
+            };
+
+            if (hint < sig.size() && sig.weak(hint) == weak && matches(hint)) return hint;
+            for (size_t pos = slot(weak); table[pos].block != EMPTY; pos = (pos + 1) & mask) {
+                if (table[pos].weak == weak && matches(table[pos].block)) return table[pos].block;
+            }
+            return -1;
+        }
+
+      private:
+        static constexpr uint32_t EMPTY = UINT32_MAX;
+
+        struct Entry {
+            uint32_t weak;
+            uint32_t block;
+        };
+
+        const Signature &sig;
+        std::vector<Entry> table;
+        size_t mask;
+        std::vector<uint64_t> filter;
+        int filter_bits;
+
+        // The table uses the upper bits of the mixed checksum and the filter uses the lower bits.
+        static uint64_t mix(const uint32_t weak) { return (weak + 1) * 0x9e3779b97f4a7c15ULL; }
+        size_t slot(const uint32_t weak) const { return (mix(weak) >> 32) & mask; }
+        uint64_t filter_bit(const uint32_t weak) const {
+            return static_cast<uint32_t>(mix(weak)) >> (32 - filter_bits);
+        }
+
+        bool same_block(const size_t x, const size_t y) const {
+            return memcmp(sig.strong(x), sig.strong(y), sig.strong_bytes()) == 0;
+        }
+    };
+
+    // A delta is a header followed by COPY (block, count), LITERAL (length, bytes) and a final END with the AquaHash
+    // digest of the whole file, which the receiver uses to check the result. Integers are little endian.
+    struct Delta {
+        static constexpr uint64_t MAGIC = 0x31544c4441555141; // "AQUADLT1"
+        enum Tag : uint8_t { END = 0, COPY = 1, LITERAL = 2 };
+
+        struct Header {
+            uint64_t magic;
+            uint64_t block_size;
+            uint64_t file_size;
+        };
+    };
+
+    // Write the delta of data against a signature using a writer which has write(const void *, size_t).
+    template <typename Writer>
+    bool compute_delta(const Signature &sig, const uint8_t *data, const size_t len, Writer &writer) {
+        const size_t block_size = sig.block_size();
+        const Delta::Header header{Delta::MAGIC, block_size, len};
+        bool ok = writer.write(&header, sizeof(header));
+
+        uint64_t run_start = 0, run_length = 0;
+        auto flush_run = [&]() {
+            if (run_length == 0) return;
+            const uint8_t tag = Delta::COPY;
+            const uint64_t op[2] = {run_start, run_length};
+            ok = ok && writer.write(&tag, 1) && writer.write(op, sizeof(op));
+            run_length = 0;
+        };
+        auto literal = [&](const size_t begin, const size_t end) {
+            if (begin == end) return;
+            flush_run();
+            const uint8_t tag = Delta::LITERAL;
+            const uint64_t length = end - begin;
+            ok = ok && writer.write(&tag, 1) && writer.write(&length, sizeof(length)) &&
+                 writer.write(data + begin, length);
+        };
+
+        const BlockIndex index(sig);
+        size_t literal_start = 0, pos = 0, hint = 0;
+        while (ok && sig.size() && pos + block_size <= len) {
+            RollingChecksum checksum(data + pos, block_size);
+            while (true) {
+                const uint32_t weak = checksum.value();
+                if (index.may_contain(weak)) {
+                    const int64_t block = index.find(weak, data + pos, hint);
+                    if (block >= 0) {
+                        literal(literal_start, pos);
+                        if (run_length && static_cast<uint64_t>(block) != run_start + run_length) flush_run();
+                        if (run_length == 0) run_start = block;
+                        ++run_length;
+                        hint = block + 1;
+                        pos += block_size;
+                        literal_start = pos;
+                        break;
+                    }
+                }
+                if (pos + block_size >= len) {
+                    pos = len;
+                    break;
+                }
+                checksum.roll(data[pos], data[pos + block_size]);
+                ++pos;
+            }
+        }
+        literal(literal_start, len);
+        flush_run();
+
+        const __m128i digest = AquaHash::Hash(data, len);
+        const uint8_t tag = Delta::END;
+        return ok && writer.write(&tag, 1) && writer.write(&digest, sizeof(digest));
+    }
+
+    // Rebuild a file from the basis file the signature was computed from and a delta. Copied blocks are written
+    // straight from the basis, literal bytes straight from the delta. Return false if the delta is invalid or the
+    // result does not have the expected digest.
+    template <typename Writer>
+    bool apply_delta(const uint8_t *basis, const size_t basis_size, const uint8_t *delta, const size_t delta_size,
+                     Writer &writer) {
+        Delta::Header header;
+        if (delta_size < sizeof(header)) return false;
+        memcpy(&header, delta, sizeof(header));
+        if (header.magic != Delta::MAGIC || header.block_size == 0) return false;
+        const uint64_t number_of_blocks = basis_size / header.block_size;
+
+        // The pieces of the result point into the basis and the delta, so they are hashed without another copy.
+        std::vector<struct iovec> pieces;
+        uint64_t written = 0;
+        auto output = [&](const uint8_t *ptr, const uint64_t len) {
+            if (len == 0) return true;
+            pieces.push_back(iovec{const_cast<uint8_t *>(ptr), len});
+            written += len;
+            return writer.write(ptr, len);
+        };
+
+        size_t pos = sizeof(header);
+        while (pos < delta_size) {
+            const uint8_t tag = delta[pos++];
+            if (tag == Delta::COPY) {
+                uint64_t op[2];
+                if (delta_size - pos < sizeof(op)) return false;
+                memcpy(op, delta + pos, sizeof(op));
+                pos += sizeof(op);
+                if (op[0] > number_of_blocks || op[1] > number_of_blocks - op[0]) return false;
+                if (!output(basis + op[0] * header.block_size, op[1] * header.block_size)) return false;
+            } else if (tag == Delta::LITERAL) {
+                uint64_t length;
+                if (delta_size - pos < sizeof(length)) return false;
+                memcpy(&length, delta + pos, sizeof(length));
+                pos += sizeof(length);
+                if (length > delta_size - pos || !output(delta + pos, length)) return false;
+                pos += length;
+            } else if (tag == Delta::END) {
+                __m128i expected;
+                if (delta_size - pos != sizeof(expected)) return false;
+                memcpy(&expected, delta + pos, sizeof(expected));
+                const __m128i digest = AquaHash::HashV(pieces.data(), pieces.size());
+                return written == header.file_size && memcmp(&digest, &expected, sizeof(digest)) == 0;
+            } else {
+                return false;
+            }
+        }
+        return false;
+    }
+} // namespace aquahash
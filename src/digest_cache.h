@@ -0,0 +1,273 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace aquahash {
+    // A persistent digest cache stored as an open addressing hash table in a memory mapped file. A file is identified
+    // by (st_dev, st_ino) and its digest is only reused if size, mtime and ctime are unchanged as well.
+    //
+    // Readers never block: every slot carries a checksum so a slot that is being rewritten by another process is
+    // simply treated as a miss. Writers serialize on flock and the table never grows, instead a full probe window
+    // evicts its home slot. Losing an entry only costs one extra read of that file.
+    class DigestCache {
+      public:
+        static constexpr uint64_t MAGIC = 0x3148434155514141; // "AAQUACH1"
+        static constexpr uint64_t VERSION = 1;
+        static constexpr size_t DEFAULT_CAPACITY = 1 << 18;
+        static constexpr size_t MAX_PROBES = 8;
+
+        // Files modified within this many seconds of the lookup are not cached because a later write within the same
+        // timestamp tick would not be visible in the metadata.
+        static constexpr time_t RACY_WINDOW = 2;
+
+        struct Key {
+            uint64_t dev;
+            uint64_t ino;
+            uint64_t size;
+            int64_t mtime_sec;
+            int64_t mtime_nsec;
+            int64_t ctime_sec;
+            int64_t ctime_nsec;
+        };
+
+        struct Slot {
+            Key key;
+            uint64_t digest[2];
+            uint64_t checksum; // Zero means the slot is empty.
+        };
+
+        struct Header {
+            uint64_t magic;
+            uint64_t version;
+            uint64_t capacity;
+            uint64_t slot_size;
+            uint64_t reserved[4];
+        };
+
+        DigestCache() = default;
+        DigestCache(const DigestCache &) = delete;
+        DigestCache &operator=(const DigestCache &) = delete;
+        ~DigestCache() { close(); }
+
+        static Key make_key(const struct stat &st) {
+            Key key;
+            memset(&key, 0, sizeof(key));
+            key.dev = static_cast<uint64_t>(st.st_dev);
+            key.ino = static_cast<uint64_t>(st.st_ino);
+            key.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+            key.mtime_sec = st.st_mtimespec.tv_sec;
+            key.mtime_nsec = st.st_mtimespec.tv_nsec;
+            key.ctime_sec = st.st_ctimespec.tv_sec;
+            key.ctime_nsec = st.st_ctimespec.tv_nsec;
+#else
+            key.mtime_sec = st.st_mtim.tv_sec;
+            key.mtime_nsec = st.st_mtim.tv_nsec;
+            key.ctime_sec = st.st_ctim.tv_sec;
+            key.ctime_nsec = st.st_ctim.tv_nsec;
+#endif
+            return key;
+        }
+
+        // Return true if a file was not modified recently enough for its metadata to be ambiguous.
+        static bool is_stable(const Key &key, const time_t now = time(nullptr)) {
+            return (key.mtime_sec + RACY_WINDOW < now) && (key.ctime_sec + RACY_WINDOW < now);
+        }
+
+        // Return $XDG_CACHE_HOME/aquahash.cache or $HOME/.cache/aquahash.cache.
+        static std::string default_path() {
+            const char *xdg = std::getenv("XDG_CACHE_HOME");
+            if (xdg != nullptr && xdg[0] != 0) return std::string(xdg) + "/aquahash.cache";
+            const char *home = std::getenv("HOME");
+            if (home == nullptr || home[0] == 0) return std::string();
+            const std::string folder = std::string(home) + "/.cache";
+            ::mkdir(folder.data(), 0755);
+            return folder + "/aquahash.cache";
+        }
+
+        // Open an existing cache file or create a new one. Return false if the cache cannot be used.
+        bool open(const std::string &path, const size_t capacity = DEFAULT_CAPACITY) {
+            close();
+            for (int attempt = 0; attempt < 2; ++attempt) {
+                if (map_file(path)) return true;
+                if (!create_file(path, capacity)) return false;
+            }
+            return false;
+        }
+
+        void close() {
+            if (header != nullptr) ::munmap(header, mapped_size);
+            if (fd >= 0) ::close(fd);
+            header = nullptr;
+            slots = nullptr;
+            fd = -1;
+            mapped_size = 0;
+            mask = 0;
+        }
+
+        bool is_open() const { return header != nullptr; }
+
+        size_t capacity() const { return mask + 1; }
+
+        bool lookup(const Key &key, __m128i &digest) const {
+            if (!is_open()) return false;
+            const size_t home = position(key);
+            for (size_t idx = 0; idx < MAX_PROBES; ++idx) {
+                Slot slot;
+                memcpy(&slot, &slots[(home + idx) & mask], sizeof(Slot));
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (slot.checksum == 0) return false;
+                if (slot.checksum != checksum(slot)) continue; // Torn read, the slot is being updated.
+                if (slot.key.dev == key.dev && slot.key.ino == key.ino) {
+                    if (memcmp(&slot.key, &key, sizeof(Key)) != 0) return false;
+                    digest = _mm_set_epi64x(slot.digest[1], slot.digest[0]);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool insert(const Key &key, const __m128i digest) {
+            if (!is_open() || !writable) return false;
+            if (::flock(fd, LOCK_EX) != 0) return false;
+
+            const size_t home = position(key);
+            Slot *target = &slots[home];
+            for (size_t idx = 0; idx < MAX_PROBES; ++idx) {
+                Slot *slot = &slots[(home + idx) & mask];
+                if (slot->checksum == 0 || (slot->key.dev == key.dev && slot->key.ino == key.ino)) {
+                    target = slot;
+                    break;
+                }
+            }
+
+            Slot value;
+            value.key = key;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(value.digest), digest);
+            value.checksum = checksum(value);
+
+            // Invalidate the slot first so concurrent readers never match a half written entry.
+            __atomic_store_n(&target->checksum, 0, __ATOMIC_RELEASE);
+            target->key = value.key;
+            target->digest[0] = value.digest[0];
+            target->digest[1] = value.digest[1];
+            __atomic_store_n(&target->checksum, value.checksum, __ATOMIC_RELEASE);
+
+            ::flock(fd, LOCK_UN);
+            return true;
+        }
+
+      private:
+        int fd = -1;
+        bool writable = false;
+        size_t mapped_size = 0;
+        size_t mask = 0;
+        Header *header = nullptr;
+        Slot *slots = nullptr;
+
+        size_t position(const Key &key) const {
+            const uint64_t id[2] = {key.dev, key.ino};
+            return convert<uint64_t>(AquaHash::Hash(reinterpret_cast<const uint8_t *>(id), sizeof(id))) & mask;
+        }
+
+        static uint64_t checksum(const Slot &slot) {
+            const __m128i h = AquaHash::Hash(reinterpret_cast<const uint8_t *>(&slot), offsetof(Slot, checksum));
+            return convert<uint64_t>(h) | 1;
+        }
+
+        static size_t file_size(const size_t capacity) { return sizeof(Header) + capacity * sizeof(Slot); }
+
+        bool map_file(const std::string &path) {
+            writable = true;
+            fd = ::open(path.data(), O_RDWR | O_CLOEXEC);
+            if (fd < 0) {
+                writable = false;
+                fd = ::open(path.data(), O_RDONLY | O_CLOEXEC);
+            }
+            if (fd < 0) return false;
+
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+                close();
+                return false;
+            }
+
+            const int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+            void *ptr = ::mmap(nullptr, st.st_size, prot, MAP_SHARED, fd, 0);
+            if (ptr == MAP_FAILED) {
+                close();
+                return false;
+            }
+
+            header = static_cast<Header *>(ptr);
+            mapped_size = st.st_size;
+            const size_t capacity = header->capacity;
+            const bool valid = (header->magic == MAGIC) && (header->version == VERSION) &&
+                               (header->slot_size == sizeof(Slot)) && capacity && !(capacity & (capacity - 1)) &&
+                               (file_size(capacity) == mapped_size);
+            if (!valid) {
+                close();
+                return false;
+            }
+            slots = reinterpret_cast<Slot *>(header + 1);
+            mask = capacity - 1;
+            return true;
+        }
+
+        // Build a fresh table next to the target and rename it into place so processes that still map the old file
+        // keep a consistent view of it.
+        static bool create_file(const std::string &path, size_t capacity) {
+            size_t rounded = 1;
+            while (rounded < capacity) rounded <<= 1;
+            capacity = rounded;
+
+            const std::string tmp_path = path + "." + std::to_string(::getpid()) + ".tmp";
+            int tmp_fd = ::open(tmp_path.data(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (tmp_fd < 0) return false;
+
+            Header hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.magic = MAGIC;
+            hdr.version = VERSION;
+            hdr.capacity = capacity;
+            hdr.slot_size = sizeof(Slot);
+            const bool ok = (::ftruncate(tmp_fd, file_size(capacity)) == 0) &&
+                            (::pwrite(tmp_fd, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr)));
+            ::close(tmp_fd);
+            if (!ok || ::rename(tmp_path.data(), path.data()) != 0) {
+                ::unlink(tmp_path.data());
+                return false;
+            }
+            return true;
+        }
+    };
+} // namespace aquahash
@@ -0,0 +1,158 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace aquahash {
+    // The client side of aquahashd. A client sends one batch per connection: a header and count paths, each as a
+    // 32-bit length followed by the path bytes. The daemon answers with a header and one Reply per path in the same
+    // order. Both sides only talk to processes of the same user.
+    class DigestClient {
+      public:
+        static constexpr uint64_t MAGIC = 0x3144485341555141; // "AQUASHD1"
+        static constexpr uint64_t MAX_PATHS = 1 << 20;
+        static constexpr int TIMEOUT_SECONDS = 5;
+
+        struct Header {
+            uint64_t magic;
+            uint64_t count;
+        };
+
+        struct Reply {
+            uint64_t found;
+            uint64_t digest[2];
+        };
+
+        // Return $XDG_RUNTIME_DIR/aquahashd.sock or /tmp/aquahashd-<uid>.sock.
+        static std::string default_socket() {
+            const char *folder = std::getenv("XDG_RUNTIME_DIR");
+            if (folder != nullptr && folder[0] != 0) return std::string(folder) + "/aquahashd.sock";
+            return "/tmp/aquahashd-" + std::to_string(::getuid()) + ".sock";
+        }
+
+        // Look up the digests of absolute paths. Return false if the daemon is not running or does not answer, in
+        // which case the caller has to hash the files itself.
+        static bool query(const std::string &socket_path, const std::vector<std::string> &paths,
+                          std::vector<Reply> &replies) {
+            if (paths.size() > MAX_PATHS) return false;
+            const int fd = connect(socket_path);
+            if (fd < 0) return false;
+
+            std::vector<char> request(sizeof(Header));
+            const Header header{MAGIC, paths.size()};
+            memcpy(request.data(), &header, sizeof(header));
+            for (auto const &path : paths) {
+                const uint32_t len = static_cast<uint32_t>(path.size());
+                request.insert(request.end(), reinterpret_cast<const char *>(&len),
+                               reinterpret_cast<const char *>(&len) + sizeof(len));
+                request.insert(request.end(), path.begin(), path.end());
+            }
+
+            Header response;
+            replies.resize(paths.size());
+            const bool ok = write_all(fd, request.data(), request.size()) &&
+                            read_all(fd, &response, sizeof(response)) && response.magic == MAGIC &&
+                            response.count == paths.size() &&
+                            read_all(fd, replies.data(), replies.size() * sizeof(Reply));
+            ::close(fd);
+            return ok;
+        }
+
+        // Connect to a daemon owned by the current user. Return the socket or -1.
+        static int connect(const std::string &socket_path) {
+            struct sockaddr_un address;
+            if (!make_address(socket_path, address)) return -1;
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) return -1;
+            set_timeout(fd);
+            if (::connect(fd, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)) != 0 ||
+                !same_user(fd)) {
+                ::close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        static bool make_address(const std::string &socket_path, struct sockaddr_un &address) {
+            memset(&address, 0, sizeof(address));
+            if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) return false;
+            address.sun_family = AF_UNIX;
+            memcpy(address.sun_path, socket_path.data(), socket_path.size());
+            return true;
+        }
+
+        // Reads and writes fail instead of blocking forever if the other side hangs.
+        static void set_timeout(const int fd) {
+            struct timeval timeout;
+            timeout.tv_sec = TIMEOUT_SECONDS;
+            timeout.tv_usec = 0;
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        }
+
+        static bool same_user(const int fd) {
+#if defined(__linux__)
+            struct ucred credentials;
+            socklen_t len = sizeof(credentials);
+            return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &len) == 0 &&
+                   credentials.uid == ::getuid();
+#else
+            uid_t uid;
+            gid_t gid;
+            return ::getpeereid(fd, &uid, &gid) == 0 && uid == ::getuid();
+#endif
+        }
+
+        static bool read_all(const int fd, void *buffer, size_t len) {
+            char *ptr = static_cast<char *>(buffer);
+            while (len) {
+                const ssize_t nbytes = ::read(fd, ptr, len);
+                if (nbytes < 0 && errno == EINTR) continue;
+                if (nbytes <= 0) return false;
+                ptr += nbytes;
+                len -= nbytes;
+            }
+            return true;
+        }
+
+        static bool write_all(const int fd, const void *buffer, size_t len) {
+#if defined(MSG_NOSIGNAL)
+            constexpr int flags = MSG_NOSIGNAL; // A closed connection must not kill the process with SIGPIPE.
+#else
+            constexpr int flags = 0;
+#endif
+            const char *ptr = static_cast<const char *>(buffer);
+            while (len) {
+                const ssize_t nbytes = ::send(fd, ptr, len, flags);
+                if (nbytes < 0 && errno == EINTR) continue;
+                if (nbytes <= 0) return false;
+                ptr += nbytes;
+                len -= nbytes;
+            }
+            return true;
+        }
+    };
+} // namespace aquahash
@@ -0,0 +1,374 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash_policy.h"
+#include "concurrent_map.h"
+#include "digest_cache.h"
+#include "digest_client.h"
+#include "parallel.h"
+#include "params.h"
+#include "reader.h"
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace aquahash {
+    // The digest table of aquahashd (Linux only). Folders are watched with inotify and changed files are rehashed by
+    // background threads, so queries are answered from memory.
+    //
+    // inotify events arrive asynchronously, so every answer is also checked against the current stat metadata of the
+    // file, as in DigestCache. Every event bumps the generation of its path, and a worker drops its result if the
+    // generation changed while it was hashing, so a digest computed before a write that does not change the metadata
+    // is never kept.
+    class DigestServer {
+      public:
+        static constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE |
+                                               IN_MODIFY | IN_ATTRIB | IN_ONLYDIR;
+
+        explicit DigestServer(const size_t threads = default_threads()) {
+            notify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (::pipe2(wake_fds, O_NONBLOCK | O_CLOEXEC) != 0) wake_fds[0] = wake_fds[1] = -1;
+            for (size_t idx = 0; idx < std::max<size_t>(threads, 1); ++idx) {
+                workers.emplace_back([this] { hash_files(); });
+            }
+        }
+
+        DigestServer(const DigestServer &) = delete;
+        DigestServer &operator=(const DigestServer &) = delete;
+
+        ~DigestServer() {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                done = true;
+            }
+            has_jobs.notify_all();
+            for (auto &worker : workers) worker.join();
+            for (const int fd : {notify_fd, server_fd, wake_fds[0], wake_fds[1]}) {
+                if (fd >= 0) ::close(fd);
+            }
+            if (server_fd >= 0) ::unlink(socket_path.data());
+        }
+
+        // Listen on a Unix domain socket which only the current user can use. Return false if it cannot be created
+        // or another daemon is already listening on it.
+        bool listen(const std::string &path) {
+            struct sockaddr_un address;
+            if (notify_fd < 0 || server_fd >= 0 || !DigestClient::make_address(path, address)) return false;
+            const int running = DigestClient::connect(path);
+            if (running >= 0) {
+                ::close(running);
+                return false;
+            }
+
+            // Remove a socket left behind by a daemon which did not exit cleanly.
+            ::unlink(path.data());
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0) return false;
+            const mode_t mask = ::umask(0177);
+            const bool ok = ::bind(fd, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)) == 0 &&
+                            ::listen(fd, SOMAXCONN) == 0;
+            ::umask(mask);
+            if (!ok) {
+                ::close(fd);
+                return false;
+            }
+            server_fd = fd;
+            socket_path = path;
+            return true;
+        }
+
+        // Watch a folder and all of its subfolders and hash the files in them. Return false if some folders cannot
+        // be watched, for example because fs.inotify.max_user_watches is too low.
+        bool watch(const std::string &folder) {
+            char buffer[PATH_MAX];
+            if (notify_fd < 0 || ::realpath(folder.data(), buffer) == nullptr) return false;
+            roots.emplace_back(buffer);
+            return add_tree(roots.back());
+        }
+
+        // Process file system events and queries until stop is called.
+        void run() {
+            while (!stopped) {
+                struct pollfd fds[3] = {{wake_fds[0], POLLIN, 0}, {notify_fd, POLLIN, 0}, {server_fd, POLLIN, 0}};
+                if (::poll(fds, 3, -1) < 0 && errno != EINTR) break;
+                if (fds[1].revents & POLLIN) read_events();
+                if (fds[2].revents & POLLIN) {
+                    const int client = ::accept4(server_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (client >= 0) {
+                        answer(client);
+                        ::close(client);
+                    }
+                }
+
+                // Tables replaced by a rehash can only be released while workers are not reading them, and the
+                // generations of removed files can only be dropped while no worker is hashing them.
+                if (idle()) {
+                    for (auto const &path : removed) generations.erase(path);
+                    removed.clear();
+                    digests.reclaim();
+                    generations.reclaim();
+                }
+            }
+        }
+
+        // Make run return. This is async-signal-safe.
+        void stop() {
+            stopped = true;
+            const char c = 0;
+            if (::write(wake_fds[1], &c, 1) < 0) return;
+        }
+
+        // Block until every queued file has been hashed.
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            is_idle.wait(lock, [this] { return jobs.empty() && active == 0; });
+        }
+
+        // Return true and the digest of a file if it is known and the file has not changed since it was hashed. It
+        // must be called from the thread which calls run, or while run is not running.
+        bool lookup(const std::string &path, __m128i &digest) {
+            Entry entry;
+            struct stat st;
+            if (!digests.find(path, entry) || ::stat(path.data(), &st) != 0) return false;
+            const auto key = DigestCache::make_key(st);
+            if (memcmp(&key, &entry.key, sizeof(key)) != 0) {
+                // Changes which do not generate inotify events, for example writes through a shared mapping.
+                invalidate(path);
+                enqueue(path);
+                return false;
+            }
+            digest = _mm_loadu_si128(reinterpret_cast<const __m128i *>(entry.digest));
+            return true;
+        }
+
+        size_t size() const { return digests.size(); }
+
+        // The number of paths whose generation is kept, which are the existing files and removed files which may
+        // still be hashed.
+        size_t number_of_generations() const { return generations.size(); }
+
+      private:
+        struct Entry {
+            DigestCache::Key key;
+            uint64_t digest[2];
+        };
+
+        concurrent_map<std::string, Entry> digests;
+        concurrent_map<std::string, uint64_t> generations;
+        std::atomic<uint64_t> generation{0};
+
+        // Watched folders, the roots given to watch and the files deleted or moved away since the workers were last
+        // idle, only used by the thread calling run.
+        std::unordered_map<int, std::string> folders;
+        std::vector<std::string> roots;
+        std::vector<std::string> removed;
+
+        int notify_fd = -1;
+        int server_fd = -1;
+        int wake_fds[2] = {-1, -1};
+        std::string socket_path;
+        std::atomic<bool> stopped{false};
+
+        // Files waiting to be hashed. A file is queued at most once.
+        std::mutex mutex;
+        std::condition_variable has_jobs;
+        std::condition_variable is_idle;
+        std::deque<std::string> jobs;
+        std::unordered_set<std::string> queued;
+        size_t active = 0;
+        bool done = false;
+        std::vector<std::thread> workers;
+
+        static std::string join(const std::string &folder, const char *name) {
+            return folder.back() == '/' ? folder + name : folder + "/" + name;
+        }
+
+        // Watch the folders of a tree and queue all regular files.
+        bool add_tree(const std::string &root) {
+            bool ok = true;
+            std::vector<std::string> stack{root};
+            while (!stack.empty()) {
+                const std::string folder = std::move(stack.back());
+                stack.pop_back();
+                const int wd = ::inotify_add_watch(notify_fd, folder.data(), WATCH_MASK);
+                if (wd < 0) {
+                    ok = false;
+                    continue;
+                }
+                folders[wd] = folder;
+
+                DIR *dir = ::opendir(folder.data());
+                if (dir == nullptr) continue;
+                while (const struct dirent *item = ::readdir(dir)) {
+                    if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0) continue;
+                    const std::string path = join(folder, item->d_name);
+                    unsigned char type = item->d_type;
+                    if (type == DT_UNKNOWN) {
+                        struct stat st;
+                        if (::lstat(path.data(), &st) != 0) continue;
+                        type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN);
+                    }
+                    if (type == DT_DIR) {
+                        stack.push_back(path);
+                    } else if (type == DT_REG) {
+                        invalidate(path);
+                        enqueue(path);
+                    }
+                }
+                ::closedir(dir);
+            }
+            return ok;
+        }
+
+        void read_events() {
+            alignas(struct inotify_event) char buffer[64 * 1024];
+            while (true) {
+                const ssize_t len = ::read(notify_fd, buffer, sizeof(buffer));
+                if (len <= 0) return;
+                for (const char *ptr = buffer; ptr < buffer + len;) {
+                    const auto *event = reinterpret_cast<const struct inotify_event *>(ptr);
+                    ptr += sizeof(struct inotify_event) + event->len;
+
+                    // Events have been lost so every file has to be checked again.
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        for (auto const &root : roots) add_tree(root);
+                        continue;
+                    }
+
+                    auto it = folders.find(event->wd);
+                    if (it == folders.end()) continue;
+                    if (event->mask & IN_IGNORED) {
+                        folders.erase(it);
+                        continue;
+                    }
+                    if (event->len == 0) continue;
+
+                    const std::string path = join(it->second, event->name);
+                    if (event->mask & IN_ISDIR) {
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO)) add_tree(path);
+                        continue;
+                    }
+                    invalidate(path);
+                    if (event->mask & (IN_DELETE | IN_MOVED_FROM)) removed.push_back(path);
+                    if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB)) enqueue(path);
+                }
+            }
+        }
+
+        void invalidate(const std::string &path) {
+            generations.insert_or_assign(path, ++generation);
+            digests.erase(path);
+        }
+
+        void enqueue(const std::string &path) {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (!queued.insert(path).second) return;
+                jobs.push_back(path);
+            }
+            has_jobs.notify_one();
+        }
+
+        bool idle() {
+            std::lock_guard<std::mutex> guard(mutex);
+            return jobs.empty() && active == 0;
+        }
+
+        void hash_files() {
+            while (true) {
+                std::string path;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    has_jobs.wait(lock, [this] { return done || !jobs.empty(); });
+                    if (done) return;
+                    path = std::move(jobs.front());
+                    jobs.pop_front();
+                    queued.erase(path);
+                    ++active;
+                }
+
+                hash_file(path);
+
+                std::lock_guard<std::mutex> guard(mutex);
+                if (--active == 0 && jobs.empty()) is_idle.notify_all();
+            }
+        }
+
+        // Only keep a digest if neither the metadata nor the generation of the file changed while it was read.
+        void hash_file(const std::string &path) {
+            uint64_t before_generation = 0, after_generation = 0;
+            generations.find(path, before_generation);
+            struct stat before, after;
+            if (::stat(path.data(), &before) != 0 || !S_ISREG(before.st_mode)) return;
+
+            FileReader<AquaHashPolicy> hasher(Params::QUIET);
+            if (!hasher(path.data()) || ::stat(path.data(), &after) != 0) return;
+            const auto key = DigestCache::make_key(before);
+            const auto current = DigestCache::make_key(after);
+            if (memcmp(&key, &current, sizeof(key)) != 0) return;
+
+            Entry entry;
+            entry.key = key;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(entry.digest), hasher.digest());
+            digests.insert_or_assign(path, entry);
+            generations.find(path, after_generation);
+            if (after_generation != before_generation) digests.erase(path);
+        }
+
+        // Answer one batch of queries. Invalid requests are dropped.
+        void answer(const int client) {
+            DigestClient::set_timeout(client);
+            DigestClient::Header header;
+            if (!DigestClient::same_user(client) || !DigestClient::read_all(client, &header, sizeof(header)) ||
+                header.magic != DigestClient::MAGIC || header.count > DigestClient::MAX_PATHS) {
+                return;
+            }
+
+            std::vector<DigestClient::Reply> replies(header.count);
+            std::string path;
+            for (auto &reply : replies) {
+                uint32_t len;
+                if (!DigestClient::read_all(client, &len, sizeof(len)) || len >= PATH_MAX) return;
+                path.resize(len);
+                if (!DigestClient::read_all(client, &path[0], len)) return;
+                __m128i digest;
+                reply.found = lookup(path, digest);
+                if (!reply.found) digest = _mm_setzero_si128();
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(reply.digest), digest);
+            }
+            if (DigestClient::write_all(client, &header, sizeof(header))) {
+                DigestClient::write_all(client, replies.data(), replies.size() * sizeof(DigestClient::Reply));
+            }
+        }
+    };
+} // namespace aquahash
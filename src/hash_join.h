@@ -0,0 +1,243 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <immintrin.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace aquahash {
+    // The lower 64 bits of the AquaHash digest of a key and the key position in its column.
+    struct HashedRow {
+        uint64_t hash;
+        uint64_t row;
+    };
+
+    // Return the number of radix bits which keeps the hash table of an average partition in the L2 cache.
+    inline size_t radix_bits(const size_t number_of_rows) {
+        constexpr size_t PARTITION_ROWS = 1 << 13;
+        constexpr size_t MAX_BITS = 12;
+        size_t bits = 0;
+        while (bits < MAX_BITS && (number_of_rows >> bits) > PARTITION_ROWS) ++bits;
+        return bits;
+    }
+
+    // A column of string-like keys hashed once and scattered into 2^bits partitions by the upper bits of their
+    // digests. Every thread hashes and histograms its own slice of the column first, then scatters its rows through
+    // one cache line sized write-combining buffer per partition which is flushed with non-temporal stores.
+    class RadixPartitions {
+      public:
+        template <typename Container>
+        RadixPartitions(const Container &keys, const size_t radix_bits, const size_t threads = default_threads())
+            : bits(radix_bits), offsets((size_t(1) << radix_bits) + 1, 0), rows(keys.size()) {
+            const size_t n = keys.size();
+            const size_t partitions = size_t(1) << bits;
+            const size_t chunks = std::max<size_t>(1, std::min(threads, n / 4096 + 1));
+            std::vector<uint64_t> hashes(n);
+            std::vector<uint16_t> ids(n);
+            std::vector<std::vector<size_t>> histograms(chunks, std::vector<size_t>(partitions, 0));
+
+            // Hash keys in batches so the AES latency of one key overlaps with the others.
+            parallel_for(chunks, chunks, [&](const size_t chunk, const size_t) {
+                constexpr size_t BATCH = 8;
+                const size_t begin = chunk * n / chunks, end = (chunk + 1) * n / chunks;
+                auto &histogram = histograms[chunk];
+                for (size_t pos = begin; pos < end; pos += BATCH) {
+                    const size_t len = std::min(BATCH, end - pos);
+                    __m128i digests[BATCH];
+                    for (size_t idx = 0; idx < len; ++idx) {
+                        auto const &key = keys[pos + idx];
+                        digests[idx] = AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.data()), key.size());
+                    }
+                    for (size_t idx = 0; idx < len; ++idx) {
+                        const uint16_t id = bits ? static_cast<uint16_t>(high_bits(digests[idx]) >> (64 - bits)) : 0;
+                        hashes[pos + idx] = low_bits(digests[idx]);
+                        ids[pos + idx] = id;
+                        ++histogram[id];
+                    }
+                }
+            });
+
+            // Every (chunk, partition) pair gets its own output range.
+            std::vector<std::vector<size_t>> starts(chunks, std::vector<size_t>(partitions, 0));
+            size_t total = 0;
+            for (size_t part = 0; part < partitions; ++part) {
+                offsets[part] = total;
+                for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                    starts[chunk][part] = total;
+                    total += histograms[chunk][part];
+                }
+            }
+            offsets[partitions] = total;
+
+            parallel_for(chunks, chunks, [&](const size_t chunk, const size_t) {
+                scatter(hashes.data(), ids.data(), chunk * n / chunks, (chunk + 1) * n / chunks, starts[chunk]);
+            });
+        }
+
+        size_t number_of_partitions() const { return offsets.size() - 1; }
+        size_t size() const { return rows.size(); }
+        const HashedRow *begin(const size_t part) const { return rows.data() + offsets[part]; }
+        const HashedRow *end(const size_t part) const { return rows.data() + offsets[part + 1]; }
+
+      private:
+        static constexpr size_t ROWS_PER_LINE = 64 / sizeof(HashedRow);
+
+        struct alignas(64) Line {
+            HashedRow rows[ROWS_PER_LINE];
+        };
+
+        size_t bits;
+        std::vector<size_t> offsets;
+        std::vector<HashedRow> rows;
+
+        void scatter(const uint64_t *hashes, const uint16_t *ids, const size_t begin, const size_t end,
+                     std::vector<size_t> next) {
+            const size_t partitions = next.size();
+            void *ptr = nullptr;
+            if (posix_memalign(&ptr, sizeof(Line), partitions * sizeof(Line)) != 0) {
+                // Without write-combining buffers every row is written to its partition directly.
+                for (size_t pos = begin; pos < end; ++pos) rows[next[ids[pos]]++] = HashedRow{hashes[pos], pos};
+                return;
+            }
+            std::unique_ptr<Line, decltype(&free)> lines(static_cast<Line *>(ptr), &free);
+            std::vector<uint8_t> used(partitions, 0);
+
+            for (size_t pos = begin; pos < end; ++pos) {
+                const uint16_t id = ids[pos];
+                Line &line = lines.get()[id];
+                line.rows[used[id]++] = HashedRow{hashes[pos], pos};
+                if (used[id] < ROWS_PER_LINE) continue;
+
+                // Bypass the cache since the output is not read again until the partition is processed.
+                const __m128i *src = reinterpret_cast<const __m128i *>(line.rows);
+                __m128i *dst = reinterpret_cast<__m128i *>(rows.data() + next[id]);
+                for (size_t idx = 0; idx < ROWS_PER_LINE; ++idx) _mm_stream_si128(dst + idx, _mm_load_si128(src + idx));
+                next[id] += ROWS_PER_LINE;
+                used[id] = 0;
+            }
+            _mm_sfence();
+
+            for (size_t id = 0; id < partitions; ++id) {
+                std::copy(lines.get()[id].rows, lines.get()[id].rows + used[id], rows.begin() + next[id]);
+            }
+        }
+    };
+
+    // An open addressing table of HashedRow that is reused for every partition processed by a thread.
+    class PartitionTable {
+      public:
+        static constexpr uint64_t EMPTY = UINT64_MAX;
+
+        void reset(const size_t count) {
+            size_t capacity = 16;
+            while (capacity < 2 * count) capacity <<= 1;
+            slots.assign(capacity, HashedRow{0, EMPTY});
+            counts.assign(capacity, 0);
+            mask = capacity - 1;
+        }
+
+        // Return the slot of a key or an empty slot where it can be inserted.
+        template <typename Equal> size_t find(const HashedRow &item, Equal equal) const {
+            size_t pos = item.hash & mask;
+            while (slots[pos].row != EMPTY && !(slots[pos].hash == item.hash && equal(slots[pos].row, item.row))) {
+                pos = (pos + 1) & mask;
+            }
+            return pos;
+        }
+
+        std::vector<HashedRow> slots;
+        std::vector<uint64_t> counts;
+        size_t mask = 0;
+    };
+
+    // Return (build row, probe row) for every pair of equal keys. Both sides are radix partitioned with the same
+    // number of bits so matching keys always end up in partitions with the same index.
+    template <typename Container>
+    std::vector<std::pair<uint64_t, uint64_t>> hash_join(const Container &build, const Container &probe,
+                                                         size_t threads = default_threads()) {
+        threads = std::max<size_t>(1, threads);
+        const size_t bits = radix_bits(build.size());
+        const RadixPartitions left(build, bits, threads), right(probe, bits, threads);
+        const size_t partitions = left.number_of_partitions();
+        std::vector<std::vector<std::pair<uint64_t, uint64_t>>> results(partitions);
+        std::vector<PartitionTable> tables(threads);
+
+        parallel_for(partitions, threads, [&](const size_t part, const size_t tid) {
+            PartitionTable &table = tables[tid];
+            table.reset(left.end(part) - left.begin(part));
+
+            // Duplicate build keys are kept, probing continues until an empty slot.
+            for (const HashedRow *it = left.begin(part); it != left.end(part); ++it) {
+                size_t pos = it->hash & table.mask;
+                while (table.slots[pos].row != PartitionTable::EMPTY) pos = (pos + 1) & table.mask;
+                table.slots[pos] = *it;
+            }
+
+            auto &output = results[part];
+            for (const HashedRow *it = right.begin(part); it != right.end(part); ++it) {
+                for (size_t pos = it->hash & table.mask; table.slots[pos].row != PartitionTable::EMPTY;
+                     pos = (pos + 1) & table.mask) {
+                    const HashedRow &slot = table.slots[pos];
+                    if (slot.hash == it->hash && build[slot.row] == probe[it->row]) {
+                        output.emplace_back(slot.row, it->row);
+                    }
+                }
+            }
+        });
+
+        std::vector<std::pair<uint64_t, uint64_t>> matches;
+        for (auto const &output : results) matches.insert(matches.end(), output.begin(), output.end());
+        return matches;
+    }
+
+    // Return (first row, number of rows) for every distinct key.
+    template <typename Container>
+    std::vector<std::pair<uint64_t, uint64_t>> group_by_count(const Container &keys,
+                                                              size_t threads = default_threads()) {
+        threads = std::max<size_t>(1, threads);
+        const RadixPartitions parts(keys, radix_bits(keys.size()), threads);
+        const size_t partitions = parts.number_of_partitions();
+        std::vector<std::vector<std::pair<uint64_t, uint64_t>>> results(partitions);
+        std::vector<PartitionTable> tables(threads);
+
+        parallel_for(partitions, threads, [&](const size_t part, const size_t tid) {
+            PartitionTable &table = tables[tid];
+            table.reset(parts.end(part) - parts.begin(part));
+            auto equal = [&keys](const uint64_t x, const uint64_t y) { return keys[x] == keys[y]; };
+            for (const HashedRow *it = parts.begin(part); it != parts.end(part); ++it) {
+                const size_t pos = table.find(*it, equal);
+                if (table.slots[pos].row == PartitionTable::EMPTY) table.slots[pos] = *it;
+                ++table.counts[pos];
+            }
+
+            auto &output = results[part];
+            for (size_t pos = 0; pos <= table.mask; ++pos) {
+                if (table.counts[pos]) output.emplace_back(table.slots[pos].row, table.counts[pos]);
+            }
+        });
+
+        std::vector<std::pair<uint64_t, uint64_t>> groups;
+        for (auto const &output : results) groups.insert(groups.end(), output.begin(), output.end());
+        return groups;
+    }
+} // namespace aquahash
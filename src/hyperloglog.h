@@ -0,0 +1,158 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+#include <vector>
+
+namespace aquahash {
+    // A HyperLogLog cardinality sketch fed by AquaHash digests. The upper 64 bits of a digest select the register
+    // and the lower 64 bits give the rank so a single hash call per element is enough.
+    //
+    // A sketch starts with a sparse list of (register, rank) pairs and switches to one byte per register once the
+    // list would use more memory than the dense registers.
+    class HyperLogLog {
+      public:
+        static constexpr int MIN_PRECISION = 4;
+        static constexpr int MAX_PRECISION = 18;
+
+        explicit HyperLogLog(const int precision = 14)
+            : p(std::min(std::max(precision, MIN_PRECISION), MAX_PRECISION)), m(size_t(1) << p) {}
+
+        int precision() const { return p; }
+        bool is_sparse() const { return registers.empty(); }
+
+        void add(const __m128i digest) {
+            const uint32_t index = static_cast<uint32_t>(high_bits(digest) >> (64 - p));
+            const uint64_t low = low_bits(digest);
+            const uint8_t rank = low ? static_cast<uint8_t>(__builtin_clzll(low) + 1) : 65;
+            if (!registers.empty()) {
+                registers[index] = std::max(registers[index], rank);
+                return;
+            }
+            sparse.push_back((index << 8) | rank);
+            if (sparse.size() >= m / 4) compact();
+        }
+
+        void add(const uint8_t *key, const size_t len) { add(AquaHash::Hash(key, len)); }
+
+        // Add a container of string-like keys.
+        template <typename Container> void add_batch(const Container &keys) {
+            for (auto const &key : keys) add(AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.data()), key.size()));
+        }
+
+        // Add precomputed digests, for example digests that are also used by a hash table.
+        void add_batch(const __m128i *digests, const size_t n) {
+            for (size_t idx = 0; idx < n; ++idx) add(digests[idx]);
+        }
+
+        // Merge another sketch with the same precision. Return false if precisions do not match.
+        bool merge(const HyperLogLog &other) {
+            if (other.p != p) return false;
+            if (other.is_sparse()) {
+                for (auto entry : other.sparse) add_entry(entry);
+                if (is_sparse()) compact();
+                return true;
+            }
+
+            to_dense();
+            const uint8_t *src = other.registers.data();
+            uint8_t *dst = registers.data();
+            size_t idx = 0;
+#ifdef __AVX2__
+            for (; idx + 32 <= m; idx += 32) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + idx));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + idx));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + idx), _mm256_max_epu8(a, b));
+            }
+#endif
+            for (; idx + 16 <= m; idx += 16) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + idx));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + idx));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + idx), _mm_max_epu8(a, b));
+            }
+            return true;
+        }
+
+        // Estimate the number of distinct elements.
+        double estimate() const {
+            std::vector<uint8_t> dense;
+            const std::vector<uint8_t> *values = &registers;
+            if (is_sparse()) {
+                dense.assign(m, 0);
+                for (auto entry : sparse) dense[entry >> 8] = std::max(dense[entry >> 8], uint8_t(entry & 0xff));
+                values = &dense;
+            }
+
+            double sum = 0;
+            size_t zeros = 0;
+            for (auto value : *values) {
+                sum += std::ldexp(1.0, -value);
+                zeros += (value == 0);
+            }
+
+            const double alpha = (m == 16) ? 0.673 : (m == 32) ? 0.697 : (m == 64) ? 0.709 : 0.7213 / (1 + 1.079 / m);
+            const double e = alpha * m * m / sum;
+
+            // Use linear counting for small cardinalities.
+            if (e <= 2.5 * m && zeros > 0) return m * std::log(static_cast<double>(m) / zeros);
+            return e;
+        }
+
+        void clear() {
+            sparse.clear();
+            registers.clear();
+        }
+
+      private:
+        int p;
+        size_t m;
+        std::vector<uint32_t> sparse;   // (register << 8) | rank
+        std::vector<uint8_t> registers; // Empty while the sketch is sparse.
+
+        void add_entry(const uint32_t entry) {
+            if (registers.empty()) {
+                sparse.push_back(entry);
+            } else {
+                registers[entry >> 8] = std::max(registers[entry >> 8], uint8_t(entry & 0xff));
+            }
+        }
+
+        // Keep the largest rank per register and switch to dense registers if the list is still too long.
+        void compact() {
+            std::sort(sparse.begin(), sparse.end());
+            size_t count = 0;
+            for (size_t idx = 0; idx < sparse.size(); ++idx) {
+                if (idx + 1 < sparse.size() && (sparse[idx] >> 8) == (sparse[idx + 1] >> 8)) continue;
+                sparse[count++] = sparse[idx];
+            }
+            sparse.resize(count);
+            if (sparse.size() >= m / 8) to_dense();
+        }
+
+        void to_dense() {
+            if (!registers.empty()) return;
+            registers.assign(m, 0);
+            for (auto entry : sparse) registers[entry >> 8] = std::max(registers[entry >> 8], uint8_t(entry & 0xff));
+            sparse.clear();
+            sparse.shrink_to_fit();
+        }
+    };
+} // namespace aquahash
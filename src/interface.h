@@ -26,13 +26,34 @@ namespace aquahash {
         return v[0];            // Take the first part of the hash code.
     }
 
+    // The lower and upper halves of a 128-bit hash code.
+    inline uint64_t low_bits(const __m128i h) noexcept { return static_cast<uint64_t>(_mm_cvtsi128_si64(h)); }
+    inline uint64_t high_bits(const __m128i h) noexcept {
+        return static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(h, h)));
+    }
+
+    // Map a hash code to one of N shards using its upper 64 bits, which leaves the lower 64 bits independent for
+    // bucket selection inside a shard. For a power of two N this is the top log2(N) bits of the hash code.
+    inline size_t shard(const __m128i h, const size_t number_of_shards) noexcept {
+        __extension__ using uint128_t = unsigned __int128;
+        return static_cast<size_t>((static_cast<uint128_t>(high_bits(h)) * number_of_shards) >> 64);
+    }
+
+    // The 128-bit hash code of a string using the default seed.
+    inline __m128i digest_of(const std::string &key) {
+        return AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.data()), key.size());
+    }
+
     template <typename T> struct hash;
 
     template <> struct hash<std::string> {
         using result_type = std::size_t;
         const __m128i kSeed = _mm_setzero_si128();
-        result_type operator()(const std::string &key) const noexcept {
-            return convert<std::size_t>(AquaHash::Hash((uint8_t *)(key.data()), key.size(), kSeed));
+        result_type operator()(const std::string &key) const noexcept { return convert<std::size_t>(digest(key)); }
+
+        // The full 128-bit hash code.
+        __m128i digest(const std::string &key) const noexcept {
+            return AquaHash::Hash((uint8_t *)(key.data()), key.size(), kSeed);
         }
     };
 
@@ -40,9 +61,11 @@ namespace aquahash {
         using result_type = std::size_t;
         const __m128i kSeed = _mm_setzero_si128();
 
-        result_type operator()(const std::vector<int> &key) const noexcept {
-            return convert<std::size_t>(
-                AquaHash::Hash((uint8_t *)(key.data()), key.size() * sizeof(int), kSeed));
+        result_type operator()(const std::vector<int> &key) const noexcept { return convert<std::size_t>(digest(key)); }
+
+        // The full 128-bit hash code.
+        __m128i digest(const std::vector<int> &key) const noexcept {
+            return AquaHash::Hash((uint8_t *)(key.data()), key.size() * sizeof(int), kSeed);
         }
     };
 } // namespace aquahash
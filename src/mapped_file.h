@@ -0,0 +1,154 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace aquahash {
+    // A read-only memory mapped file. Empty files are valid and have a null data pointer.
+    class MappedFile {
+      public:
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        ~MappedFile() { close(); }
+
+        // The advice is MADV_SEQUENTIAL for files which are read from the start to the end or MADV_RANDOM for lookups.
+        bool open(const std::string &path, const int advice = MADV_SEQUENTIAL) {
+            close();
+            int fd = ::open(path.data(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) return false;
+            struct stat st;
+            if (::fstat(fd, &st) != 0) {
+                ::close(fd);
+                return false;
+            }
+            len = st.st_size;
+            if (len > 0) {
+                void *ptr = ::mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+                if (ptr == MAP_FAILED) {
+                    ::close(fd);
+                    len = 0;
+                    return false;
+                }
+                ::madvise(ptr, len, advice);
+                mapped = static_cast<const uint8_t *>(ptr);
+            }
+            ::close(fd);
+            return true;
+        }
+
+        void close() {
+            if (mapped != nullptr) ::munmap(const_cast<uint8_t *>(mapped), len);
+            mapped = nullptr;
+            len = 0;
+        }
+
+        const uint8_t *data() const { return mapped; }
+        size_t size() const { return len; }
+
+      private:
+        const uint8_t *mapped = nullptr;
+        size_t len = 0;
+    };
+
+    // Buffered writes to a file. Writes which are larger than the buffer go straight from the caller's memory, for
+    // example a memory mapped file, to the kernel. The buffer size can be lowered when many files are open at once.
+    class FileWriter {
+      public:
+        static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+        FileWriter() = default;
+        FileWriter(const FileWriter &) = delete;
+        FileWriter &operator=(const FileWriter &) = delete;
+        ~FileWriter() { close(); }
+
+        bool open(const std::string &path, const size_t buffer_size = BUFFER_SIZE) {
+            close();
+            fd = ::open(path.data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            owned = true;
+            capacity = buffer_size;
+            buffer.reserve(capacity);
+            status = fd >= 0;
+            return status;
+        }
+
+        // Write to a descriptor which stays open after close, for example STDOUT_FILENO.
+        bool attach(const int descriptor) {
+            close();
+            fd = descriptor;
+            owned = false;
+            capacity = BUFFER_SIZE;
+            buffer.reserve(capacity);
+            status = fd >= 0;
+            return status;
+        }
+
+        bool write(const void *data, const size_t len) {
+            if (buffer.size() + len > capacity && !flush()) return false;
+            if (len >= capacity) return write_all(static_cast<const uint8_t *>(data), len);
+            const uint8_t *ptr = static_cast<const uint8_t *>(data);
+            buffer.insert(buffer.end(), ptr, ptr + len);
+            return true;
+        }
+
+        template <typename T> bool write_value(const T &value) { return write(&value, sizeof(T)); }
+
+        bool flush() {
+            const bool ok = write_all(buffer.data(), buffer.size());
+            buffer.clear();
+            return ok;
+        }
+
+        // Return false if any write failed.
+        bool close() {
+            if (fd < 0) return status;
+            flush();
+            if (owned && ::close(fd) != 0) status = false;
+            fd = -1;
+            return status;
+        }
+
+      private:
+        int fd = -1;
+        bool owned = true;
+        bool status = false;
+        size_t capacity = BUFFER_SIZE;
+        std::vector<uint8_t> buffer;
+
+        bool write_all(const uint8_t *ptr, size_t len) {
+            while (status && len) {
+                const ssize_t nbytes = ::write(fd, ptr, len);
+                if (nbytes < 0 && errno == EINTR) continue;
+                if (nbytes <= 0) {
+                    status = false;
+                    break;
+                }
+                ptr += nbytes;
+                len -= nbytes;
+            }
+            return status;
+        }
+    };
+} // namespace aquahash
@@ -0,0 +1,158 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace aquahash {
+    // A MinHash sketch with K 32-bit permutations. Each shingle is hashed once with AquaHash and the digest is expanded
+    // into K/4 lanes by two AES rounds per lane with lane specific round keys. Lanes are independent so the AES units
+    // can pipeline them, and minimums are kept per lane with unsigned 32-bit SIMD min operations.
+    template <size_t K> class MinHash {
+        static_assert(K > 0 && K % 4 == 0, "The number of permutations must be a multiple of 4");
+
+      public:
+        static constexpr size_t LANES = K / 4;
+        using Signature = std::array<uint32_t, K>;
+
+        explicit MinHash(const uint64_t seed = 0) {
+            for (size_t idx = 0; idx < LANES; ++idx) {
+                const uint64_t lane[2] = {seed, idx};
+                keys[idx] = AquaHash::Hash(reinterpret_cast<const uint8_t *>(lane), sizeof(lane));
+            }
+            clear();
+        }
+
+        void clear() {
+            for (size_t idx = 0; idx < LANES; ++idx) mins[idx] = _mm_set1_epi32(-1);
+        }
+
+        void add(const __m128i digest) {
+            for (size_t idx = 0; idx < LANES; ++idx) mins[idx] = min_epu32(mins[idx], expand(digest, idx));
+        }
+
+        void add(const uint8_t *key, const size_t len) { add(AquaHash::Hash(key, len)); }
+
+        // Add many digests at once. A block of lanes stays in registers while all digests are streamed through it.
+        void add_batch(const __m128i *digests, const size_t n) {
+            constexpr size_t BLOCK = 8;
+            size_t lane = 0;
+            for (; lane + BLOCK <= LANES; lane += BLOCK) {
+                __m128i m[BLOCK];
+                for (size_t idx = 0; idx < BLOCK; ++idx) m[idx] = mins[lane + idx];
+                for (size_t pos = 0; pos < n; ++pos) {
+                    for (size_t idx = 0; idx < BLOCK; ++idx) {
+                        m[idx] = min_epu32(m[idx], expand(digests[pos], lane + idx));
+                    }
+                }
+                for (size_t idx = 0; idx < BLOCK; ++idx) mins[lane + idx] = m[idx];
+            }
+            for (; lane < LANES; ++lane) {
+                for (size_t pos = 0; pos < n; ++pos) mins[lane] = min_epu32(mins[lane], expand(digests[pos], lane));
+            }
+        }
+
+        // Add all byte shingles of a given width. Texts shorter than the width are added as a single shingle.
+        void add_shingles(const uint8_t *text, const size_t len, const size_t width) {
+            if (len <= width) {
+                add(text, len);
+                return;
+            }
+            constexpr size_t BATCH = 64;
+            __m128i digests[BATCH];
+            size_t count = 0;
+            for (size_t pos = 0; pos + width <= len; ++pos) {
+                digests[count++] = AquaHash::Hash(text + pos, width);
+                if (count == BATCH) {
+                    add_batch(digests, count);
+                    count = 0;
+                }
+            }
+            add_batch(digests, count);
+        }
+
+        Signature signature() const {
+            Signature results;
+            for (size_t idx = 0; idx < LANES; ++idx) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(&results[4 * idx]), mins[idx]);
+            }
+            return results;
+        }
+
+        // Estimate the Jaccard similarity of two sets from their signatures.
+        static double jaccard(const Signature &first, const Signature &second) {
+            size_t count = 0;
+            for (size_t idx = 0; idx < K; idx += 4) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&first[idx]));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&second[idx]));
+                count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))));
+            }
+            return static_cast<double>(count) / K;
+        }
+
+      private:
+        __m128i keys[LANES];
+        __m128i mins[LANES];
+
+        // _mm_min_epu32 needs SSE4.1. Baseline x86-64 builds flip the sign bits and use the signed SSE2 compare.
+        static __m128i min_epu32(const __m128i a, const __m128i b) {
+#if defined(__SSE4_1__)
+            return _mm_min_epu32(a, b);
+#else
+            const __m128i sign = _mm_set1_epi32(INT32_MIN);
+            const __m128i greater = _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+            return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+#endif
+        }
+
+        __m128i expand(const __m128i digest, const size_t lane) const {
+            return aesenc(aesenc(_mm_xor_si128(digest, keys[lane]), keys[lane]), digest);
+        }
+    };
+
+    // b-bit MinHash keeps the lowest B bits of every minimum, which reduces a signature by 32/B times.
+    template <size_t B, size_t K> struct BBitMinHash {
+        static_assert(B == 1 || B == 2 || B == 4 || B == 8 || B == 16, "B must divide 64");
+        static constexpr size_t WORDS = (K * B + 63) / 64;
+        using Signature = std::array<uint64_t, WORDS>;
+
+        static Signature compress(const typename MinHash<K>::Signature &sig) {
+            Signature results{};
+            constexpr uint64_t mask = (uint64_t(1) << B) - 1;
+            for (size_t idx = 0; idx < K; ++idx) {
+                results[idx * B / 64] |= (sig[idx] & mask) << (idx * B % 64);
+            }
+            return results;
+        }
+
+        // Estimate the Jaccard similarity while correcting for random matches of B bit values.
+        static double jaccard(const Signature &first, const Signature &second) {
+            constexpr uint64_t mask = (uint64_t(1) << B) - 1;
+            size_t count = 0;
+            for (size_t idx = 0; idx < K; ++idx) {
+                const size_t shift = idx * B % 64;
+                count += ((first[idx * B / 64] >> shift) & mask) == ((second[idx * B / 64] >> shift) & mask);
+            }
+            const double matches = static_cast<double>(count) / K;
+            const double random = std::ldexp(1.0, -static_cast<int>(B));
+            const double estimate = (matches - random) / (1 - random);
+            return estimate > 0 ? estimate : 0;
+        }
+    };
+} // namespace aquahash
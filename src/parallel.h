@@ -0,0 +1,84 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace aquahash {
+    inline size_t default_threads() {
+        const size_t n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    // Run f(task, thread_id) for every task in [0, n) using a given number of threads. Tasks are handed out one at a
+    // time so uneven tasks are balanced across threads. The calling thread is one of the workers.
+    template <typename Function> void parallel_for(const size_t n, size_t threads, Function f) {
+        threads = std::max<size_t>(1, std::min(threads, n));
+        std::atomic<size_t> next(0);
+        auto worker = [&next, &f, n](const size_t tid) {
+            for (size_t task = next++; task < n; task = next++) f(task, tid);
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t tid = 1; tid < threads; ++tid) workers.emplace_back(worker, tid);
+        worker(0);
+        for (auto &thread : workers) thread.join();
+    }
+
+    // A blocking FIFO queue between pipeline stages. push waits while the queue is full and pop returns false once
+    // the queue is closed and empty.
+    template <typename T> class BoundedQueue {
+      public:
+        explicit BoundedQueue(const size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+        void push(T item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this] { return items.size() < capacity; });
+            items.push_back(std::move(item));
+            not_empty.notify_one();
+        }
+
+        bool pop(T &item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [this] { return !items.empty() || closed; });
+            if (items.empty()) return false;
+            item = std::move(items.front());
+            items.pop_front();
+            not_full.notify_one();
+            return true;
+        }
+
+        void close() {
+            std::lock_guard<std::mutex> guard(mutex);
+            closed = true;
+            not_empty.notify_all();
+        }
+
+      private:
+        size_t capacity;
+        std::deque<T> items;
+        bool closed = false;
+        std::mutex mutex;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+    };
+} // namespace aquahash
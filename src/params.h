@@ -24,18 +24,33 @@ namespace aquahash {
             AQUAHASH = 1 << 2,
             XXHASH = 1 << 3,
             USE_BIG_ENDIAN = 1 << 4,
+            USE_CACHE = 1 << 5,
+            SAMPLED = 1 << 6,
+            QUIET = 1 << 7,
+            STATS = 1 << 8,
+            USE_DAEMON = 1 << 9,
         };
         static bool verbose(const int flags) { return (flags & VERBOSE) > 0; }
         static bool color(const int flags) { return (flags & COLOR) > 0; }
         static bool use_aquahash(const int flags) { return (flags & AQUAHASH) > 0; }
         static bool use_xxhash(const int flags) { return (flags & XXHASH) > 0; }
         static bool big_endian(const int flags) { return (flags & USE_BIG_ENDIAN) > 0; }
+        static bool use_cache(const int flags) { return (flags & USE_CACHE) > 0; }
+        static bool sampled(const int flags) { return (flags & SAMPLED) > 0; }
+        static bool quiet(const int flags) { return (flags & QUIET) > 0; }
+        static bool stats(const int flags) { return (flags & STATS) > 0; }
+        static bool use_daemon(const int flags) { return (flags & USE_DAEMON) > 0; }
         static void print(const int flags) {
             printf("verbose: %s\n", verbose(flags) ? "yes" : "no");
             printf("color: %s\n", color(flags) ? "yes" : "no");
             printf("little-endian: %s\n", big_endian(flags) ? "yes" : "no");
             printf("use_aquahash: %s\n", use_aquahash(flags) ? "yes" : "no");
             printf("use_xxhash: %s\n", use_xxhash(flags) ? "yes" : "no");
+            printf("use_cache: %s\n", use_cache(flags) ? "yes" : "no");
+            printf("sampled: %s\n", sampled(flags) ? "yes" : "no");
+            printf("quiet: %s\n", quiet(flags) ? "yes" : "no");
+            printf("stats: %s\n", stats(flags) ? "yes" : "no");
+            printf("use_daemon: %s\n", use_daemon(flags) ? "yes" : "no");
         }
     };
 } // namespace aquahash
@@ -0,0 +1,236 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "records.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace aquahash {
+    struct PartitionOptions {
+        size_t partitions = 1;
+        size_t key_field = 0;              // The 1-based field which is hashed, 0 hashes the whole record.
+        char delimiter = '\n';
+        char field_delimiter = '\t';
+        size_t threads = default_threads(); // The number of hashing threads.
+        size_t chunk_size = 1 << 22;        // Input is read and hashed in chunks which end at a record boundary.
+    };
+
+    // Return the 1-based field of a record, or an empty field if the record has fewer fields.
+    inline std::pair<const char *, size_t> record_field(const char *record, const size_t len, const size_t field,
+                                                        const char field_delimiter) {
+        if (field == 0) return std::make_pair(record, len);
+        const char *begin = record, *end = record + len;
+        for (size_t idx = 1; idx < field; ++idx) {
+            const void *next = memchr(begin, field_delimiter, end - begin);
+            if (next == nullptr) return std::make_pair(end, size_t(0));
+            begin = static_cast<const char *>(next) + 1;
+        }
+        const void *next = memchr(begin, field_delimiter, end - begin);
+        return std::make_pair(begin, (next != nullptr ? static_cast<const char *>(next) : end) - begin);
+    }
+
+    // Split the records of a stream into N files by the AquaHash digest of a key field. A record goes to
+    // shard(AquaHash::Hash(key), N), which is the mapping clients get from aquahash::shard and digest_of. A reader
+    // thread fills chunks which end at a record boundary, hashing threads split chunks into per partition buffers and
+    // the calling thread writes the buffers of every chunk in input order, so every output keeps the input order.
+    class Partitioner {
+      public:
+        static constexpr size_t BATCH = 16;
+
+        explicit Partitioner(const PartitionOptions &opts) : options(opts) {
+            options.partitions = std::max<size_t>(1, options.partitions);
+            options.threads = std::max<size_t>(1, options.threads);
+            options.chunk_size = std::max<size_t>(1, options.chunk_size);
+            counts.assign(options.partitions, 0);
+        }
+
+        // Read records from fd and write partition i to prefix + i. Return false if the input cannot be read or an
+        // output cannot be written.
+        bool operator()(const int fd, const std::string &prefix) {
+            std::vector<std::unique_ptr<FileWriter>> writers;
+            for (size_t part = 0; part < options.partitions; ++part) {
+                writers.emplace_back(new FileWriter());
+                if (!writers.back()->open(prefix + std::to_string(part))) return false;
+            }
+
+            // Chunks are recycled so memory is bounded by the number of chunks in flight.
+            const size_t number_of_chunks = 2 * options.threads + 2;
+            std::vector<std::unique_ptr<Chunk>> pool;
+            BoundedQueue<Chunk *> free_chunks(number_of_chunks), filled(number_of_chunks), hashed(number_of_chunks);
+            for (size_t idx = 0; idx < number_of_chunks; ++idx) {
+                pool.emplace_back(new Chunk());
+                pool.back()->outputs.resize(options.partitions);
+                pool.back()->counts.resize(options.partitions);
+                free_chunks.push(pool.back().get());
+            }
+
+            std::atomic<bool> read_ok(true);
+            std::thread reader([&] {
+                read_ok = read(fd, free_chunks, filled);
+                filled.close();
+            });
+
+            std::atomic<size_t> running(options.threads);
+            std::vector<std::thread> hashers;
+            for (size_t tid = 0; tid < options.threads; ++tid) {
+                hashers.emplace_back([&] {
+                    Chunk *chunk;
+                    while (filled.pop(chunk)) {
+                        split(*chunk);
+                        hashed.push(chunk);
+                    }
+                    if (--running == 0) hashed.close();
+                });
+            }
+
+            // Write chunks in input order. Chunks which are hashed early wait until the chunks before them are written.
+            bool write_ok = true;
+            std::map<uint64_t, Chunk *> pending;
+            uint64_t next = 0;
+            Chunk *chunk;
+            while (hashed.pop(chunk)) {
+                pending[chunk->sequence] = chunk;
+                for (auto it = pending.begin(); it != pending.end() && it->first == next; it = pending.erase(it)) {
+                    Chunk *current = it->second;
+                    for (size_t part = 0; part < options.partitions; ++part) {
+                        const std::string &output = current->outputs[part];
+                        if (!output.empty()) write_ok = writers[part]->write(output.data(), output.size()) && write_ok;
+                        counts[part] += current->counts[part];
+                    }
+                    records += current->records;
+                    free_chunks.push(current);
+                    ++next;
+                }
+            }
+
+            reader.join();
+            for (auto &hasher : hashers) hasher.join();
+            for (auto &writer : writers) write_ok = writer->close() && write_ok;
+            return read_ok && write_ok;
+        }
+
+        size_t number_of_records() const { return records; }
+        const std::vector<size_t> &records_per_partition() const { return counts; }
+
+      private:
+        struct Chunk {
+            uint64_t sequence = 0;
+            std::vector<char> buffer;
+            size_t length = 0;
+            std::vector<std::string> outputs;
+            std::vector<size_t> counts;
+            size_t records = 0;
+        };
+
+        PartitionOptions options;
+        std::vector<size_t> counts;
+        size_t records = 0;
+
+        // Fill chunks from fd. The unfinished last record of a chunk is moved to the next one, chunks grow if a record
+        // is longer than a chunk.
+        bool read(const int fd, BoundedQueue<Chunk *> &free_chunks, BoundedQueue<Chunk *> &filled) {
+            std::string carry;
+            uint64_t sequence = 0;
+            bool eof = false, ok = true;
+            while (!eof) {
+                Chunk *chunk = nullptr;
+                if (!free_chunks.pop(chunk)) return false;
+                if (chunk->buffer.size() < carry.size() + options.chunk_size) {
+                    chunk->buffer.resize(carry.size() + options.chunk_size);
+                }
+                std::copy(carry.begin(), carry.end(), chunk->buffer.begin());
+                size_t length = carry.size();
+                while (length < chunk->buffer.size()) {
+                    const ssize_t nbytes = ::read(fd, chunk->buffer.data() + length, chunk->buffer.size() - length);
+                    if (nbytes < 0 && errno == EINTR) continue;
+                    if (nbytes <= 0) {
+                        ok = nbytes == 0;
+                        eof = true;
+                        break;
+                    }
+                    length += nbytes;
+                }
+
+                carry.clear();
+                if (!eof) {
+                    const char *begin = chunk->buffer.data();
+                    size_t end = length;
+                    while (end && begin[end - 1] != options.delimiter) --end;
+                    carry.assign(begin + end, length - end);
+                    length = end;
+                }
+                chunk->length = length;
+                chunk->sequence = sequence++;
+                filled.push(chunk);
+            }
+            return ok;
+        }
+
+        // Append every record of a chunk, followed by the delimiter, to the output of its partition.
+        void split(Chunk &chunk) const {
+            for (auto &output : chunk.outputs) output.clear();
+            std::fill(chunk.counts.begin(), chunk.counts.end(), 0);
+            chunk.records = 0;
+
+            struct Item {
+                const char *record;
+                size_t len;
+                std::pair<const char *, size_t> key;
+            };
+            Item batch[BATCH];
+            size_t batch_size = 0;
+            auto hash_batch = [&] {
+                __m128i digests[BATCH];
+                for (size_t idx = 0; idx < batch_size; ++idx) {
+                    const auto &key = batch[idx].key;
+                    digests[idx] = AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.first), key.second);
+                }
+                for (size_t idx = 0; idx < batch_size; ++idx) {
+                    const size_t part = shard(digests[idx], options.partitions);
+                    chunk.outputs[part].append(batch[idx].record, batch[idx].len).push_back(options.delimiter);
+                    ++chunk.counts[part];
+                }
+                chunk.records += batch_size;
+                batch_size = 0;
+            };
+
+            // A chunk ends with a delimiter unless it is the end of the input, so the splitter carries nothing over.
+            RecordSplitter splitter(options.delimiter);
+            auto add = [&](const char *record, const size_t len, const uint64_t) {
+                batch[batch_size++] =
+                    Item{record, len, record_field(record, len, options.key_field, options.field_delimiter)};
+                if (batch_size == BATCH) hash_batch();
+            };
+            if (chunk.length) splitter(chunk.buffer.data(), chunk.length, add);
+            splitter.finish(add);
+            hash_batch();
+        }
+    };
+} // namespace aquahash
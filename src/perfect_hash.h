@@ -0,0 +1,375 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace aquahash {
+    // A minimal perfect hash function for a static key set using the PTHash construction. Keys are split into
+    // partitions by the upper 64 bits of their AquaHash digest, each partition assigns keys to buckets and stores one
+    // pilot per bucket so that (lower 64 bits XOR hash(pilot)) maps every key of the bucket to a free slot.
+    //
+    // A lookup costs one AquaHash call, one read of the partition table which is small enough to stay in cache, one
+    // pilot read and, for about 2% of the keys, one read of the remap table. The serialized form is position
+    // independent so a file can be memory mapped and used without any parsing.
+    class PerfectHash {
+      public:
+        static constexpr uint64_t MAGIC = 0x3148504d41555141; // "AQUAMPH1"
+        static constexpr uint64_t VERSION = 1;
+
+        struct Header {
+            uint64_t magic;
+            uint64_t version;
+            uint64_t seed[2];
+            uint64_t number_of_keys;
+            uint64_t number_of_partitions;
+            uint64_t number_of_pilots;
+            uint64_t number_of_remaps;
+        };
+
+        struct Partition {
+            uint64_t offset; // The first output value of this partition.
+            uint64_t pilot_offset;
+            uint64_t remap_offset;
+            uint32_t size; // The number of keys.
+            uint32_t table_size;
+            uint32_t buckets;
+            uint32_t reserved;
+        };
+
+        PerfectHash() = default;
+        PerfectHash(const PerfectHash &) = delete;
+        PerfectHash &operator=(const PerfectHash &) = delete;
+        ~PerfectHash() { close(); }
+
+        // Take ownership of a serialized function.
+        bool load(std::vector<uint64_t> &&data) {
+            close();
+            buffer = std::move(data);
+            return attach(buffer.data(), buffer.size() * sizeof(uint64_t));
+        }
+
+        // Memory map a serialized function.
+        bool open(const std::string &path) {
+            close();
+            int fd = ::open(path.data(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) return false;
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+            void *ptr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (ptr == MAP_FAILED) return false;
+            mapped = ptr;
+            mapped_size = st.st_size;
+            if (!attach(ptr, mapped_size)) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        bool save(const std::string &path) const {
+            if (header == nullptr) return false;
+            FILE *fp = fopen(path.data(), "wb");
+            if (fp == nullptr) return false;
+            const bool ok = fwrite(header, 1, bytes, fp) == bytes;
+            return (fclose(fp) == 0) && ok;
+        }
+
+        void close() {
+            if (mapped != nullptr) ::munmap(mapped, mapped_size);
+            mapped = nullptr;
+            mapped_size = 0;
+            buffer.clear();
+            header = nullptr;
+        }
+
+        size_t size() const { return header != nullptr ? header->number_of_keys : 0; }
+
+        // Return a unique value in [0, size()) for every key of the original key set.
+        size_t operator()(const uint8_t *key, const size_t len) const {
+            const __m128i seed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(header->seed));
+            const __m128i h = AquaHash::Hash(key, len, seed);
+            const uint64_t high = high_bits(h);
+            const Partition &part = partitions[shard(h, header->number_of_partitions)];
+            const uint64_t bucket = fastrange(high * header->number_of_partitions, part.buckets);
+            const uint64_t pos = position(low_bits(h), pilots[part.pilot_offset + bucket], part.table_size);
+            return part.offset + (pos < part.size ? pos : remaps[part.remap_offset + pos - part.size]);
+        }
+
+        size_t operator()(const std::string &key) const {
+            return (*this)(reinterpret_cast<const uint8_t *>(key.data()), key.size());
+        }
+
+        // Shared by the builder and lookups.
+        static uint64_t fastrange(const uint64_t x, const uint64_t n) {
+            __extension__ using uint128_t = unsigned __int128;
+            return static_cast<uint64_t>((static_cast<uint128_t>(x) * n) >> 64);
+        }
+
+        static uint64_t position(const uint64_t low, const uint64_t pilot, const uint64_t table_size) {
+            uint64_t x = (pilot + 1) * 0x9e3779b97f4a7c15ULL;
+            x ^= x >> 32;
+            return fastrange(low ^ x, table_size);
+        }
+
+      private:
+        std::vector<uint64_t> buffer;
+        void *mapped = nullptr;
+        size_t mapped_size = 0;
+        size_t bytes = 0;
+        const Header *header = nullptr;
+        const Partition *partitions = nullptr;
+        const uint32_t *pilots = nullptr;
+        const uint32_t *remaps = nullptr;
+
+        bool attach(const void *data, const size_t len) {
+            header = nullptr;
+            if (len < sizeof(Header)) return false;
+            const Header *hdr = static_cast<const Header *>(data);
+            if (hdr->magic != MAGIC || hdr->version != VERSION || hdr->number_of_partitions == 0) return false;
+            const size_t expected = sizeof(Header) + hdr->number_of_partitions * sizeof(Partition) +
+                                    (hdr->number_of_pilots + hdr->number_of_remaps) * sizeof(uint32_t);
+            if (len < expected) return false;
+            header = hdr;
+            bytes = expected;
+            partitions = reinterpret_cast<const Partition *>(header + 1);
+            pilots = reinterpret_cast<const uint32_t *>(partitions + header->number_of_partitions);
+            remaps = pilots + header->number_of_pilots;
+            return true;
+        }
+    };
+
+    // Build a PerfectHash for a container of distinct string-like keys. Keys are hashed and partitions are built
+    // using a given number of threads.
+    class PerfectHashBuilder {
+      public:
+        static constexpr size_t PARTITION_SIZE = 1 << 16; // Average number of keys per partition.
+        static constexpr uint32_t MAX_PILOT = 1 << 24;
+        static constexpr int MAX_ATTEMPTS = 4;
+
+        explicit PerfectHashBuilder(const size_t threads = std::thread::hardware_concurrency(),
+                                    const double load_factor = 0.98, const double bucket_factor = 6.0)
+            : number_of_threads(threads > 0 ? threads : 1), alpha(load_factor), c(bucket_factor) {}
+
+        // Return false if keys are not distinct.
+        template <typename Container> bool build(const Container &keys, PerfectHash &result) const {
+            const size_t n = keys.size();
+            std::vector<Digest> digests(n);
+            for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+                const __m128i seed = _mm_set_epi64x(0, attempt);
+                parallel_for(n, [&keys, &digests, seed](const size_t idx) {
+                    const __m128i h =
+                        AquaHash::Hash(reinterpret_cast<const uint8_t *>(keys[idx].data()), keys[idx].size(), seed);
+                    digests[idx] = Digest{low_bits(h), high_bits(h)};
+                });
+                std::vector<uint64_t> data;
+                if (build_from_digests(digests, seed, data)) return result.load(std::move(data));
+            }
+            return false;
+        }
+
+      private:
+        size_t number_of_threads;
+        double alpha;
+        double c;
+
+        struct Digest {
+            uint64_t low;
+            uint64_t high;
+        };
+
+        struct Item {
+            uint64_t bucket;
+            uint64_t low;
+        };
+
+        struct Result {
+            std::vector<uint32_t> pilots;
+            std::vector<uint32_t> remaps;
+            uint32_t table_size = 0;
+            bool ok = true;
+        };
+
+        template <typename Function> void parallel_for(const size_t n, Function f) const {
+            const size_t threads = std::min(number_of_threads, n / 1024 + 1);
+            if (threads <= 1) {
+                for (size_t idx = 0; idx < n; ++idx) f(idx);
+                return;
+            }
+            std::vector<std::thread> workers;
+            for (size_t tid = 0; tid < threads; ++tid) {
+                workers.emplace_back([tid, threads, n, &f]() {
+                    for (size_t idx = tid * n / threads; idx < (tid + 1) * n / threads; ++idx) f(idx);
+                });
+            }
+            for (auto &worker : workers) worker.join();
+        }
+
+        bool build_from_digests(const std::vector<Digest> &digests, const __m128i seed,
+                                std::vector<uint64_t> &data) const {
+            const size_t n = digests.size();
+            const size_t number_of_partitions = (n + PARTITION_SIZE - 1) / PARTITION_SIZE + 1;
+
+            // Group keys by partition with a counting sort.
+            std::vector<size_t> offsets(number_of_partitions + 1, 0);
+            for (auto const &h : digests) ++offsets[PerfectHash::fastrange(h.high, number_of_partitions) + 1];
+            for (size_t idx = 0; idx < number_of_partitions; ++idx) offsets[idx + 1] += offsets[idx];
+            std::vector<Item> items(n);
+            {
+                std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+                for (auto const &h : digests) {
+                    items[pos[PerfectHash::fastrange(h.high, number_of_partitions)]++] =
+                        Item{h.high * number_of_partitions, h.low};
+                }
+            }
+
+            // Build partitions in parallel.
+            std::vector<Result> results(number_of_partitions);
+            std::atomic<size_t> next(0);
+            std::vector<std::thread> workers;
+            const size_t threads = std::min(number_of_threads, number_of_partitions);
+            for (size_t tid = 0; tid < threads; ++tid) {
+                workers.emplace_back([&]() {
+                    for (size_t idx = next++; idx < number_of_partitions; idx = next++) {
+                        build_partition(&items[offsets[idx]], offsets[idx + 1] - offsets[idx], results[idx]);
+                    }
+                });
+            }
+            for (auto &worker : workers) worker.join();
+
+            size_t number_of_pilots = 0, number_of_remaps = 0;
+            for (auto const &res : results) {
+                if (!res.ok) return false;
+                number_of_pilots += res.pilots.size();
+                number_of_remaps += res.remaps.size();
+            }
+
+            // Serialize the function.
+            const size_t bytes = sizeof(PerfectHash::Header) + number_of_partitions * sizeof(PerfectHash::Partition) +
+                                 (number_of_pilots + number_of_remaps) * sizeof(uint32_t);
+            data.assign((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+            auto header = reinterpret_cast<PerfectHash::Header *>(data.data());
+            header->magic = PerfectHash::MAGIC;
+            header->version = PerfectHash::VERSION;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(header->seed), seed);
+            header->number_of_keys = n;
+            header->number_of_partitions = number_of_partitions;
+            header->number_of_pilots = number_of_pilots;
+            header->number_of_remaps = number_of_remaps;
+
+            auto partitions = reinterpret_cast<PerfectHash::Partition *>(header + 1);
+            uint32_t *pilots = reinterpret_cast<uint32_t *>(partitions + number_of_partitions);
+            uint32_t *remaps = pilots + number_of_pilots;
+            size_t pilot_offset = 0, remap_offset = 0;
+            for (size_t idx = 0; idx < number_of_partitions; ++idx) {
+                const Result &res = results[idx];
+                PerfectHash::Partition &part = partitions[idx];
+                part.offset = offsets[idx];
+                part.pilot_offset = pilot_offset;
+                part.remap_offset = remap_offset;
+                part.size = static_cast<uint32_t>(offsets[idx + 1] - offsets[idx]);
+                part.table_size = res.table_size;
+                part.buckets = static_cast<uint32_t>(res.pilots.size());
+                std::copy(res.pilots.begin(), res.pilots.end(), pilots + pilot_offset);
+                std::copy(res.remaps.begin(), res.remaps.end(), remaps + remap_offset);
+                pilot_offset += res.pilots.size();
+                remap_offset += res.remaps.size();
+            }
+            return true;
+        }
+
+        void build_partition(Item *items, const size_t n, Result &result) const {
+            const double logn = std::log2(static_cast<double>(n > 2 ? n : 2));
+            const size_t buckets = static_cast<size_t>(std::ceil(c * n / logn)) + 1;
+            const size_t table_size = std::max<size_t>(static_cast<size_t>(std::ceil(n / alpha)), n + 1);
+            result.table_size = static_cast<uint32_t>(table_size);
+            result.pilots.assign(buckets, 0);
+
+            // Sort keys by bucket, then process buckets from the largest to the smallest one.
+            for (size_t idx = 0; idx < n; ++idx) items[idx].bucket = PerfectHash::fastrange(items[idx].bucket, buckets);
+            std::sort(items, items + n, [](const Item &a, const Item &b) {
+                return (a.bucket < b.bucket) || (a.bucket == b.bucket && a.low < b.low);
+            });
+
+            // Keys with identical digests can never be separated.
+            for (size_t idx = 1; idx < n; ++idx) {
+                if (items[idx].bucket == items[idx - 1].bucket && items[idx].low == items[idx - 1].low) {
+                    result.ok = false;
+                    return;
+                }
+            }
+
+            std::vector<std::pair<uint32_t, uint32_t>> order; // (begin, end) of every non-empty bucket
+            for (size_t begin = 0, end = 0; begin < n; begin = end) {
+                while (end < n && items[end].bucket == items[begin].bucket) ++end;
+                order.emplace_back(static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+            }
+            std::stable_sort(order.begin(), order.end(), [](const std::pair<uint32_t, uint32_t> &a,
+                                                            const std::pair<uint32_t, uint32_t> &b) {
+                return (a.second - a.first) > (b.second - b.first);
+            });
+
+            std::vector<bool> taken(table_size, false);
+            std::vector<uint64_t> positions;
+            for (auto const &range : order) {
+                uint32_t pilot = 0;
+                for (; pilot < MAX_PILOT; ++pilot) {
+                    positions.clear();
+                    bool ok = true;
+                    for (uint32_t idx = range.first; ok && idx < range.second; ++idx) {
+                        const uint64_t pos = PerfectHash::position(items[idx].low, pilot, table_size);
+                        ok = !taken[pos] && std::find(positions.begin(), positions.end(), pos) == positions.end();
+                        positions.push_back(pos);
+                    }
+                    if (ok) break;
+                }
+                if (pilot == MAX_PILOT) {
+                    result.ok = false;
+                    return;
+                }
+                for (auto pos : positions) taken[pos] = true;
+                result.pilots[items[range.first].bucket] = pilot;
+            }
+
+            // Positions beyond n are remapped to the free slots below n.
+            result.remaps.assign(table_size - n, 0);
+            size_t free_slot = 0;
+            for (size_t pos = n; pos < table_size; ++pos) {
+                if (!taken[pos]) continue;
+                while (taken[free_slot]) ++free_slot;
+                result.remaps[pos - n] = static_cast<uint32_t>(free_slot++);
+            }
+        }
+    };
+} // namespace aquahash
@@ -13,8 +13,13 @@
 // limitations under the License.
 
 #pragma once
+#include "stats.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -27,14 +32,18 @@ namespace aquahash {
 
         char read_buffer[Policy::BUFFER_SIZE];
 
-        void operator()(const char *datafile) {
+        // Accumulate bytes, read calls and the time spent reading and hashing into stats, or nothing if it is null.
+        void collect(Stats *value) { stats = value; }
+
+        // Return true if the whole file has been processed.
+        bool operator()(const char *datafile) {
             // Read data by trunks
             int fd = ::open(datafile, O_RDONLY | O_NOCTTY);
 
             // Check that we can open a given file.
             if (fd < 0) {
                 fprintf(stderr, "Cannot open file: '%s'. Error: %s\n", datafile, strerror(errno));
-                return;
+                return false;
             }
 
             // Get file size.
@@ -45,21 +54,154 @@ namespace aquahash {
             const size_t block_count =
                 (buf.st_size / Policy::BUFFER_SIZE) + (buf.st_size % Policy::BUFFER_SIZE != 0);
 
+            bool status = true;
             for (size_t blk = 0; blk < block_count; ++blk) {
+                const uint64_t begin = stats ? now_ns() : 0;
                 long nbytes = ::read(fd, read_buffer, Policy::BUFFER_SIZE);
+                if (stats) {
+                    stats->read_ns += now_ns() - begin;
+                    ++stats->reads;
+                }
                 if (nbytes < 0) {
                     fprintf(stderr, "Cannot read from file '%s'. Error: %s\n", datafile, strerror(errno));
+                    status = false;
                     break;
                 };
 
                 // Apply a given policy to read_buffer.
-                Policy::process(read_buffer, nbytes);
+                process(read_buffer, nbytes);
             }
 
             Policy::finalize(datafile); // Clear policy's states.
 
             // Close our file.
             ::close(fd);
+            return status;
+        }
+
+        // Process the byte range [offset, offset + length) of a file. A zero length means until the end of the file.
+        // Data is read using pread so several readers can hash different ranges of the same file in parallel.
+        bool operator()(const char *datafile, const size_t offset, size_t length) {
+            int fd = ::open(datafile, O_RDONLY | O_NOCTTY);
+            if (fd < 0) {
+                fprintf(stderr, "Cannot open file: '%s'. Error: %s\n", datafile, strerror(errno));
+                return false;
+            }
+
+            struct stat buf;
+            fstat(fd, &buf);
+            const size_t file_size = buf.st_size;
+            const size_t begin = offset < file_size ? offset : file_size;
+            if ((length == 0) || (length > file_size - begin)) length = file_size - begin;
+
+            bool status = true;
+            size_t pos = begin;
+            const size_t end = begin + length;
+            while (pos < end) {
+                const size_t len = (end - pos) < Policy::BUFFER_SIZE ? (end - pos) : Policy::BUFFER_SIZE;
+                if (!read_at(fd, read_buffer, len, pos, datafile)) {
+                    status = false;
+                    break;
+                }
+                process(read_buffer, len);
+                pos += len;
+            }
+
+            Policy::finalize(std::string(datafile) + "[" + std::to_string(begin) + ":" + std::to_string(end) + "]");
+            ::close(fd);
+            return status;
+        }
+
+        // Compute a fingerprint from the file size and a given number of evenly spaced windows, which include the
+        // first and the last window of the file. Small files are processed as a whole.
+        bool sample(const char *datafile, const size_t number_of_windows) {
+            int fd = ::open(datafile, O_RDONLY | O_NOCTTY);
+            if (fd < 0) {
+                fprintf(stderr, "Cannot open file: '%s'. Error: %s\n", datafile, strerror(errno));
+                return false;
+            }
+
+            struct stat buf;
+            fstat(fd, &buf);
+            const uint64_t file_size = buf.st_size;
+            const uint64_t windows = number_of_windows > 0 ? number_of_windows : 1;
+
+            // Sampling parameters are part of the fingerprint.
+            const uint64_t header[3] = {file_size, windows, SAMPLE_WINDOW};
+            size_t used = sizeof(header);
+            memcpy(read_buffer, header, sizeof(header));
+
+            bool status = true;
+            const bool whole_file = file_size <= windows * SAMPLE_WINDOW;
+            const uint64_t count = whole_file ? 1 : windows;
+            for (uint64_t idx = 0; status && (idx < count); ++idx) {
+                uint64_t pos = 0;
+                uint64_t remain = file_size;
+                if (!whole_file) {
+                    pos = (count > 1) ? idx * (file_size - SAMPLE_WINDOW) / (count - 1) : 0;
+                    remain = SAMPLE_WINDOW;
+                }
+
+                // Windows are packed into full buffers so only the last buffer passed to the policy is partial.
+                while (remain > 0) {
+                    const size_t available = Policy::BUFFER_SIZE - used;
+                    const size_t len = remain < available ? remain : available;
+                    if (!read_at(fd, read_buffer + used, len, pos, datafile)) {
+                        status = false;
+                        break;
+                    }
+                    used += len;
+                    pos += len;
+                    remain -= len;
+                    if (used == Policy::BUFFER_SIZE) {
+                        process(read_buffer, used);
+                        used = 0;
+                    }
+                }
+            }
+
+            if (used > 0) process(read_buffer, used);
+            Policy::finalize(datafile);
+            ::close(fd);
+            return status;
+        }
+
+        static constexpr size_t SAMPLE_WINDOW = 4096;
+
+      private:
+        Stats *stats = nullptr;
+
+        void process(const char *buffer, const size_t len) {
+            if (!stats) {
+                Policy::process(buffer, len);
+                return;
+            }
+            const uint64_t begin = now_ns();
+            Policy::process(buffer, len);
+            stats->hash_ns += now_ns() - begin;
+            stats->bytes += len;
+        }
+
+        // Read exactly len bytes at a given offset.
+        bool read_at(int fd, char *buffer, size_t len, size_t offset, const char *datafile) {
+            while (len > 0) {
+                const uint64_t begin = stats ? now_ns() : 0;
+                const ssize_t nbytes = ::pread(fd, buffer, len, offset);
+                if (stats) {
+                    stats->read_ns += now_ns() - begin;
+                    ++stats->reads;
+                }
+                if (nbytes < 0 && errno == EINTR) continue;
+                if (nbytes <= 0) {
+                    fprintf(stderr, "Cannot read from file '%s'. Error: %s\n", datafile,
+                            nbytes < 0 ? strerror(errno) : "unexpected end of file");
+                    return false;
+                }
+                buffer += nbytes;
+                offset += nbytes;
+                len -= nbytes;
+            }
+            return true;
         }
     };
 } // namespace aquahash
@@ -0,0 +1,136 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "records.h"
+#include "utils.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace aquahash {
+    struct RecordOptions {
+        char delimiter = '\n';
+        size_t record_size = 0; // Split a file into records of this size instead of at delimiters.
+        bool binary = false;    // Write 16-byte digests instead of lines with the offset and the digest.
+        std::string prefix;     // Written at the start of every line, for example the file name.
+        FILE *output = stdout;
+    };
+
+    // A FileReader policy which hashes every record of a file. Records are hashed in batches so the AES latency of one
+    // record overlaps with the others, and lines are formatted into a large output buffer.
+    class RecordPolicy {
+      public:
+        static constexpr size_t BUFFER_SIZE = 1 << 16;
+        static constexpr size_t BATCH = 16;
+        static constexpr size_t OUTPUT_SIZE = 1 << 20;
+
+        explicit RecordPolicy(const RecordOptions &opts)
+            : options(opts), splitter(opts.delimiter, opts.record_size),
+              line_size(opts.prefix.size() + MAX_OFFSET_DIGITS + 2 + 2 * sizeof(__m128i)),
+              output(new char[OUTPUT_SIZE + line_size]) {}
+
+        void process(const char *buffer, const size_t len) {
+            splitter(buffer, len, [this](const char *record, const size_t n, const uint64_t offset) {
+                add(record, n, offset);
+            });
+
+            // Records may point into the read buffer which is overwritten by the next read.
+            hash_batch();
+        }
+
+        void finalize(const std::string &) {
+            splitter.finish([this](const char *record, const size_t n, const uint64_t offset) {
+                add(record, n, offset);
+            });
+            hash_batch();
+            flush();
+        }
+
+        size_t number_of_records() const { return records; }
+
+        // Return false if the output could not be written.
+        bool good() const { return status; }
+
+      private:
+        static constexpr size_t MAX_OFFSET_DIGITS = 20;
+
+        struct Record {
+            const char *data;
+            size_t len;
+            uint64_t offset;
+        };
+
+        RecordOptions options;
+        RecordSplitter splitter;
+        AquaHashWriter writer;
+        Record batch[BATCH];
+        size_t batch_size = 0;
+        size_t records = 0;
+        size_t line_size;
+        std::unique_ptr<char[]> output;
+        size_t used = 0;
+        bool status = true;
+
+        void add(const char *data, const size_t len, const uint64_t offset) {
+            batch[batch_size++] = Record{data, len, offset};
+            if (batch_size == BATCH) hash_batch();
+        }
+
+        void hash_batch() {
+            __m128i digests[BATCH];
+            for (size_t idx = 0; idx < batch_size; ++idx) {
+                digests[idx] = AquaHash::Hash(reinterpret_cast<const uint8_t *>(batch[idx].data), batch[idx].len);
+            }
+            for (size_t idx = 0; idx < batch_size; ++idx) write(batch[idx].offset, digests[idx]);
+            records += batch_size;
+            batch_size = 0;
+        }
+
+        void write(const uint64_t offset, const __m128i digest) {
+            char *ptr = output.get() + used;
+            if (options.binary) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(ptr), digest);
+                ptr += sizeof(__m128i);
+            } else {
+                memcpy(ptr, options.prefix.data(), options.prefix.size());
+                ptr += options.prefix.size();
+                char digits[MAX_OFFSET_DIGITS];
+                char *first = digits + MAX_OFFSET_DIGITS;
+                uint64_t value = offset;
+                do {
+                    *--first = static_cast<char>('0' + value % 10);
+                    value /= 10;
+                } while (value);
+                const size_t n = digits + MAX_OFFSET_DIGITS - first;
+                memcpy(ptr, first, n);
+                ptr += n;
+                *ptr++ = '\t';
+                ptr = writer.write(digest, ptr);
+                *ptr++ = '\n';
+            }
+            used = ptr - output.get();
+            if (used >= OUTPUT_SIZE) flush();
+        }
+
+        void flush() {
+            if (used && fwrite(output.get(), 1, used, options.output) != used) status = false;
+            used = 0;
+        }
+    };
+} // namespace aquahash
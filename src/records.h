@@ -0,0 +1,114 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <string>
+
+namespace aquahash {
+    // Return a mask which has bit i set if block[i] == delimiter for a 64-byte block.
+    inline uint64_t delimiter_mask(const char *block, const char delimiter) {
+#if defined(__AVX2__)
+        const __m256i pattern = _mm256_set1_epi8(delimiter);
+        const __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+        const __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+        const uint64_t m0 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x0, pattern)));
+        const uint64_t m1 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x1, pattern)));
+        return m0 | (m1 << 32);
+#else
+        const __m128i pattern = _mm_set1_epi8(delimiter);
+        uint64_t mask = 0;
+        for (int idx = 0; idx < 4; ++idx) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * idx));
+            mask |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, pattern))) << (16 * idx);
+        }
+        return mask;
+#endif
+    }
+
+    // Split a stream of buffers into records which end with a delimiter, or into records of a fixed size. A record
+    // which spans two or more buffers is assembled in an internal buffer, all other records point into the caller's
+    // buffer. Records passed to the callback stay valid until the next call.
+    class RecordSplitter {
+      public:
+        explicit RecordSplitter(const char delimiter = '\n', const size_t record_size = 0)
+            : delimiter(delimiter), record_size(record_size) {}
+
+        // Call f(record, length, offset) for every record which ends in this buffer. Delimiters are not part of
+        // records and offsets are relative to the first buffer.
+        template <typename Function> void operator()(const char *buffer, const size_t len, Function &&f) {
+            current ^= 1;
+            std::string &previous = carry[current ^ 1];
+            std::string &next = carry[current];
+            next.clear();
+
+            size_t start = 0;
+            bool has_previous = !previous.empty();
+            auto emit = [&](const size_t end, const size_t skip) {
+                if (has_previous) {
+                    previous.append(buffer, end);
+                    f(previous.data(), previous.size(), record_offset);
+                    has_previous = false;
+                } else {
+                    f(buffer + start, end - start, position + start);
+                }
+                start = end + skip;
+                record_offset = position + start;
+            };
+
+            if (record_size) {
+                size_t end = record_size - (has_previous ? previous.size() : 0);
+                for (; end <= len; end += record_size) emit(end, 0);
+            } else {
+                size_t pos = 0;
+                for (; pos + 64 <= len; pos += 64) {
+                    for (uint64_t mask = delimiter_mask(buffer + pos, delimiter); mask; mask &= mask - 1) {
+                        emit(pos + __builtin_ctzll(mask), 1);
+                    }
+                }
+                for (; pos < len; ++pos) {
+                    if (buffer[pos] == delimiter) emit(pos, 1);
+                }
+            }
+
+            // Keep the unfinished record, which may have started in an earlier buffer.
+            if (has_previous) {
+                next.swap(previous);
+                next.append(buffer, len);
+            } else {
+                next.assign(buffer + start, len - start);
+            }
+            position += len;
+        }
+
+        // Call f for the last record if the data does not end with a delimiter or a full fixed size record.
+        template <typename Function> void finish(Function &&f) {
+            const std::string &last = carry[current];
+            current ^= 1;
+            carry[current].clear();
+            if (!last.empty()) f(last.data(), last.size(), record_offset);
+        }
+
+      private:
+        char delimiter;
+        size_t record_size;
+        std::string carry[2];
+        int current = 0;
+        uint64_t position = 0;
+        uint64_t record_offset = 0;
+    };
+} // namespace aquahash
@@ -0,0 +1,109 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <string>
+#include <unordered_set>
+
+namespace aquahash {
+    // An order independent digest of a set or a multiset. The 128-bit digests of the elements are summed lane-wise
+    // modulo 2^64, so elements can be added and removed in any order and the accumulators of disjoint parts of a
+    // collection, for example one per thread, can be merged. The digest of the collection is an AquaHash of the sum
+    // and the number of elements.
+    class SetHash {
+      public:
+        void clear() noexcept {
+            sum = _mm_setzero_si128();
+            count = 0;
+        }
+
+        void add(const __m128i h) noexcept {
+            sum = _mm_add_epi64(sum, h);
+            ++count;
+        }
+
+        void remove(const __m128i h) noexcept {
+            sum = _mm_sub_epi64(sum, h);
+            --count;
+        }
+
+        void add(const uint8_t *key, const size_t len) { add(AquaHash::Hash(key, len)); }
+        void remove(const uint8_t *key, const size_t len) { remove(AquaHash::Hash(key, len)); }
+
+        // Elements of any type which has an aquahash::hash specialization.
+        template <typename T> void add(const T &key) { add(hash<T>().digest(key)); }
+        template <typename T> void remove(const T &key) { remove(hash<T>().digest(key)); }
+
+        // Add many digests at once. Four partial sums keep the additions independent.
+        void add_batch(const __m128i *digests, const size_t n) noexcept {
+            __m128i partial[4] = {sum, _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+            size_t pos = 0;
+            for (; pos + 4 <= n; pos += 4) {
+                for (size_t idx = 0; idx < 4; ++idx) partial[idx] = _mm_add_epi64(partial[idx], digests[pos + idx]);
+            }
+            for (; pos < n; ++pos) partial[0] = _mm_add_epi64(partial[0], digests[pos]);
+            sum = _mm_add_epi64(_mm_add_epi64(partial[0], partial[1]), _mm_add_epi64(partial[2], partial[3]));
+            count += n;
+        }
+
+        // Combine with the accumulator of another part of the collection.
+        void merge(const SetHash &other) noexcept {
+            sum = _mm_add_epi64(sum, other.sum);
+            count += other.count;
+        }
+
+        // The number of added minus the number of removed elements.
+        uint64_t size() const noexcept { return count; }
+
+        // The 128-bit digest of the collection.
+        __m128i digest(const __m128i seed = _mm_setzero_si128()) const noexcept {
+            alignas(16) uint8_t buffer[sizeof(__m128i) + sizeof(uint64_t)];
+            _mm_store_si128(reinterpret_cast<__m128i *>(buffer), sum);
+            memcpy(buffer + sizeof(__m128i), &count, sizeof(count));
+            return AquaHash::Hash(buffer, sizeof(buffer), seed);
+        }
+
+        bool operator==(const SetHash &other) const noexcept {
+            return count == other.count && _mm_movemask_epi8(_mm_cmpeq_epi8(sum, other.sum)) == 0xFFFF;
+        }
+        bool operator!=(const SetHash &other) const noexcept { return !(*this == other); }
+
+      private:
+        __m128i sum = _mm_setzero_si128();
+        uint64_t count = 0;
+    };
+
+    // Equal sets have the same hash code whatever their iteration order is.
+    template <typename T, typename Hash, typename Equal, typename Allocator>
+    struct hash<std::unordered_set<T, Hash, Equal, Allocator>> {
+        using key_type = std::unordered_set<T, Hash, Equal, Allocator>;
+        using result_type = std::size_t;
+        const __m128i kSeed = _mm_setzero_si128();
+
+        result_type operator()(const key_type &key) const noexcept { return convert<std::size_t>(digest(key)); }
+
+        // The full 128-bit hash code.
+        __m128i digest(const key_type &key) const noexcept {
+            SetHash accumulator;
+            for (auto const &item : key) accumulator.add(item);
+            return accumulator.digest(kSeed);
+        }
+    };
+} // namespace aquahash
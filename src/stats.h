@@ -0,0 +1,197 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace aquahash {
+    inline uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // Counters of one or more hashed files. Read and hash times are collected by FileReader, the rest is collected by
+    // StatsCollector.
+    struct Stats {
+        uint64_t bytes = 0;
+        uint64_t reads = 0; // read and pread system calls
+        uint64_t wall_ns = 0;
+        uint64_t read_ns = 0;
+        uint64_t hash_ns = 0;
+        uint64_t minor_faults = 0;
+        uint64_t major_faults = 0;
+        bool has_perf = false;
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        uint64_t llc_misses = 0;
+        bool cached = false; // The digest came from the digest cache.
+
+        Stats &operator+=(const Stats &other) {
+            bytes += other.bytes;
+            reads += other.reads;
+            wall_ns += other.wall_ns;
+            read_ns += other.read_ns;
+            hash_ns += other.hash_ns;
+            minor_faults += other.minor_faults;
+            major_faults += other.major_faults;
+            has_perf = has_perf || other.has_perf;
+            cycles += other.cycles;
+            instructions += other.instructions;
+            llc_misses += other.llc_misses;
+            return *this;
+        }
+
+        // One byte per nanosecond is one GB/s.
+        double gbps() const { return wall_ns ? static_cast<double>(bytes) / wall_ns : 0; }
+
+        // Return the counters as the members of a JSON object without the enclosing braces.
+        std::string json() const {
+            char buffer[512];
+            int len = snprintf(buffer, sizeof(buffer),
+                               "\"bytes\":%lu,\"wall_ns\":%lu,\"read_ns\":%lu,\"hash_ns\":%lu,\"reads\":%lu,"
+                               "\"gbps\":%.3f,\"minor_faults\":%lu,\"major_faults\":%lu",
+                               (unsigned long)bytes, (unsigned long)wall_ns, (unsigned long)read_ns,
+                               (unsigned long)hash_ns, (unsigned long)reads, gbps(), (unsigned long)minor_faults,
+                               (unsigned long)major_faults);
+            if (has_perf) {
+                snprintf(buffer + len, sizeof(buffer) - len, ",\"cycles\":%lu,\"instructions\":%lu,\"llc_misses\":%lu",
+                         (unsigned long)cycles, (unsigned long)instructions, (unsigned long)llc_misses);
+            }
+            return buffer;
+        }
+    };
+
+    inline std::string json_string(const std::string &value) {
+        std::string result = "\"";
+        for (const char c : value) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+                result += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                result += buffer;
+            } else {
+                result += c;
+            }
+        }
+        return result + "\"";
+    }
+
+    // Measure the wall time, page faults and, on Linux, CPU cycles, instructions and last level cache misses of the
+    // calling thread. Hardware counters are skipped if perf_event_open is not allowed, for example in containers or
+    // when kernel.perf_event_paranoid is too high.
+    class StatsCollector {
+      public:
+        StatsCollector() {
+#if defined(__linux__)
+            const uint64_t configs[NUMBER_OF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                          PERF_COUNT_HW_CACHE_MISSES};
+            // Kernel time includes copying file data to user space, retry without it if that is not allowed.
+            for (const int exclude_kernel : {0, 1}) {
+                close_counters();
+                for (int idx = 0; idx < NUMBER_OF_COUNTERS; ++idx) {
+                    struct perf_event_attr attr;
+                    memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = configs[idx];
+                    attr.disabled = (idx == 0);
+                    attr.exclude_kernel = exclude_kernel;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP;
+                    fds[idx] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, idx ? fds[0] : -1, 0));
+                    if (fds[idx] < 0) break;
+                }
+                if (has_counters()) break;
+            }
+            if (!has_counters()) close_counters();
+#endif
+        }
+
+        ~StatsCollector() { close_counters(); }
+
+        StatsCollector(const StatsCollector &) = delete;
+        StatsCollector &operator=(const StatsCollector &) = delete;
+
+        bool has_counters() const { return fds[NUMBER_OF_COUNTERS - 1] >= 0; }
+
+        void start() {
+            faults(start_minor, start_major);
+#if defined(__linux__)
+            if (has_counters()) {
+                ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+#endif
+            start_time = now_ns();
+        }
+
+        // Add the counters measured since start to stats.
+        void stop(Stats &stats) {
+            stats.wall_ns += now_ns() - start_time;
+#if defined(__linux__)
+            if (has_counters()) {
+                ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+                uint64_t values[1 + NUMBER_OF_COUNTERS];
+                if (::read(fds[0], values, sizeof(values)) == static_cast<ssize_t>(sizeof(values))) {
+                    stats.has_perf = true;
+                    stats.cycles += values[1];
+                    stats.instructions += values[2];
+                    stats.llc_misses += values[3];
+                }
+            }
+#endif
+            uint64_t minor, major;
+            faults(minor, major);
+            stats.minor_faults += minor - start_minor;
+            stats.major_faults += major - start_major;
+        }
+
+      private:
+        static constexpr int NUMBER_OF_COUNTERS = 3;
+        int fds[NUMBER_OF_COUNTERS] = {-1, -1, -1};
+        uint64_t start_time = 0;
+        uint64_t start_minor = 0;
+        uint64_t start_major = 0;
+
+        void close_counters() {
+            for (auto &fd : fds) {
+                if (fd >= 0) ::close(fd);
+                fd = -1;
+            }
+        }
+
+        static void faults(uint64_t &minor, uint64_t &major) {
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            minor = usage.ru_minflt;
+            major = usage.ru_majflt;
+        }
+    };
+} // namespace aquahash
@@ -0,0 +1,465 @@
+// Copyright 2019 Hung Dang
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "aquahash.h"
+#include "interface.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "records.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace aquahash {
+    // The 128-bit AquaHash digest of a record and the record offset in its file.
+    struct HashedRecord {
+        uint64_t low;
+        uint64_t high;
+        uint64_t offset;
+    };
+
+    // An open addressing set of 128-bit digests. The offset of every digest is only kept if records with equal
+    // digests have to be compared, otherwise a digest takes 16 bytes per slot.
+    class DigestSet {
+      public:
+        explicit DigestSet(const bool keep_offsets = false) : keep_offsets(keep_offsets) { reset(0); }
+
+        static size_t slot_bytes(const bool keep_offsets) {
+            return sizeof(Slot) + (keep_offsets ? sizeof(uint64_t) : 0);
+        }
+
+        // Clear the set and size it for count digests, or for as many as a table within limit bytes can take.
+        void reset(const size_t count, const size_t limit = SIZE_MAX) {
+            const size_t bytes = slot_bytes(keep_offsets);
+            size_t capacity = 16;
+            while (capacity < 2 * count && 6 * capacity * bytes <= limit) capacity <<= 1;
+            std::vector<Slot>().swap(slots);
+            std::vector<uint64_t>().swap(offsets);
+            slots.resize(capacity, Slot{0, 0});
+            offsets.resize(keep_offsets ? capacity : 0, 0);
+            mask = capacity - 1;
+            number = 0;
+            has_zero = false;
+        }
+
+        // Return true if the digest is new, otherwise set existing to the offset the digest was inserted with.
+        bool insert(const HashedRecord &item, uint64_t &existing) {
+            if ((item.low | item.high) == 0) return insert_zero(item.offset, existing);
+            if (2 * (number + 1) > slots.size()) grow();
+            const size_t pos = find(item.low, item.high);
+            if (!slots[pos].empty()) {
+                existing = keep_offsets ? offsets[pos] : 0;
+                return false;
+            }
+            slots[pos] = Slot{item.low, item.high};
+            if (keep_offsets) offsets[pos] = item.offset;
+            ++number;
+            return true;
+        }
+
+        // Return true if the next insert doubles the table and the old and the new table together exceed limit bytes.
+        bool full(const size_t limit) const {
+            return 2 * (number + 1) > slots.size() && 3 * memory() > limit;
+        }
+
+        size_t size() const { return number + has_zero; }
+        size_t memory() const { return slots.size() * slot_bytes(keep_offsets); }
+
+        // Call f(item) for every digest. Offsets are zero unless they are kept.
+        template <typename Function> void for_each(Function &&f) const {
+            if (has_zero) f(HashedRecord{0, 0, zero_offset});
+            for (size_t pos = 0; pos < slots.size(); ++pos) {
+                if (slots[pos].empty()) continue;
+                f(HashedRecord{slots[pos].low, slots[pos].high, keep_offsets ? offsets[pos] : 0});
+            }
+        }
+
+      private:
+        // The zero digest marks empty slots and is stored separately.
+        struct Slot {
+            uint64_t low;
+            uint64_t high;
+            bool empty() const { return (low | high) == 0; }
+        };
+
+        bool keep_offsets;
+        std::vector<Slot> slots;
+        std::vector<uint64_t> offsets;
+        size_t mask = 0;
+        size_t number = 0;
+        bool has_zero = false;
+        uint64_t zero_offset = 0;
+
+        size_t find(const uint64_t low, const uint64_t high) const {
+            size_t pos = low & mask;
+            while (!slots[pos].empty() && !(slots[pos].low == low && slots[pos].high == high)) pos = (pos + 1) & mask;
+            return pos;
+        }
+
+        bool insert_zero(const uint64_t offset, uint64_t &existing) {
+            if (has_zero) {
+                existing = zero_offset;
+                return false;
+            }
+            has_zero = true;
+            zero_offset = keep_offsets ? offset : 0;
+            return true;
+        }
+
+        void grow() {
+            std::vector<Slot> old_slots(2 * slots.size(), Slot{0, 0});
+            std::vector<uint64_t> old_offsets(keep_offsets ? old_slots.size() : 0, 0);
+            old_slots.swap(slots);
+            old_offsets.swap(offsets);
+            mask = slots.size() - 1;
+            for (size_t idx = 0; idx < old_slots.size(); ++idx) {
+                if (old_slots[idx].empty()) continue;
+                const size_t pos = find(old_slots[idx].low, old_slots[idx].high);
+                slots[pos] = old_slots[idx];
+                if (keep_offsets) offsets[pos] = old_offsets[idx];
+            }
+        }
+    };
+
+    struct UniqOptions {
+        char delimiter = '\n';
+        size_t record_size = 0;           // Split a file into records of this size instead of at delimiters.
+        bool verify = false;              // Compare records with equal digests instead of trusting the digests.
+        size_t memory = size_t(1) << 30;  // Bytes for digest sets and partition buffers of all threads.
+        std::string temp_dir = "/tmp";    // Where partitions are written.
+        size_t threads = default_threads();
+    };
+
+    // Remove duplicate records from a file and keep the first copy of every record in input order without sorting.
+    // Records are tracked by their 128-bit AquaHash digests in memory. If the digest set would outgrow the memory
+    // limit, the set and all remaining records are written as (digest, offset) runs into partitions chosen by the
+    // upper bits of the digests, so equal records always share a partition. Partitions are deduplicated in parallel
+    // and a partition whose digests do not fit the memory of one thread is split again by the next digest bits. The
+    // offsets of unique records are merged back into input order.
+    //
+    // Digest sets get 7/8 of the memory and partition writers get the rest. During deduplication every thread has
+    // memory / threads bytes. Writer buffers are never smaller than MIN_BUFFER, so a limit of a few KB is exceeded.
+    class Uniq {
+      public:
+        static constexpr size_t BATCH = 16;
+        static constexpr size_t MIN_BUFFER = 4096;
+
+        explicit Uniq(const UniqOptions &opts) : options(opts), digests(opts.verify) {
+            options.threads = std::max<size_t>(1, options.threads);
+        }
+
+        Uniq(const Uniq &) = delete;
+        Uniq &operator=(const Uniq &) = delete;
+        ~Uniq() { remove_partitions(); }
+
+        // Write every unique record of data followed by the delimiter, records of a fixed size are written as they
+        // are. Return false if partitions or the output cannot be written.
+        bool operator()(const uint8_t *data, const size_t len, FileWriter &output) {
+            input = reinterpret_cast<const char *>(data);
+            size = len;
+            writer = &output;
+
+            RecordSplitter splitter(options.delimiter, options.record_size);
+            auto add = [this](const char *record, const size_t n, const uint64_t offset) {
+                batch[batch_size++] = Record{record, n, offset};
+                if (batch_size == BATCH) hash_batch();
+            };
+            if (len) splitter(input, len, add);
+            splitter.finish(add);
+            hash_batch();
+
+            if (spill.active() && status) status = dedup_partitions() && merge_partitions();
+            remove_partitions();
+            return status;
+        }
+
+        size_t number_of_records() const { return records; }
+        size_t number_of_unique_records() const { return unique; }
+
+        // The number of partitions including the ones which were split again, zero if all digests fit in memory.
+        size_t number_of_partitions() const { return number_of_partitions_; }
+
+      private:
+        struct Record {
+            const char *data;
+            size_t len;
+            uint64_t offset;
+        };
+
+        // Records before the boundary were seen before the partition was written, their digests are only known.
+        // Shift is the number of upper digest bits which all digests of the partition share.
+        struct Partition {
+            size_t id;
+            uint64_t boundary;
+            size_t shift;
+        };
+
+        // The writers of partitions which split digests by the next bits after shift.
+        struct Spill {
+            std::vector<std::unique_ptr<FileWriter>> writers;
+            std::vector<Partition> partitions;
+            size_t shift = 0;
+            size_t bits = 0;
+
+            bool active() const { return !partitions.empty(); }
+            bool write(const HashedRecord &item) {
+                return writers[(item.high << shift) >> (64 - bits)]->write_value(item);
+            }
+        };
+
+        UniqOptions options;
+        DigestSet digests;
+        const char *input = nullptr;
+        size_t size = 0;
+        FileWriter *writer = nullptr;
+        Record batch[BATCH];
+        size_t batch_size = 0;
+        size_t records = 0;
+        size_t unique = 0;
+        bool status = true;
+
+        std::string directory;
+        Spill spill;
+        std::atomic<size_t> next_id{0};
+        size_t number_of_partitions_ = 0;
+
+        // The digest set and the writer share of a memory budget.
+        static size_t set_limit(const size_t budget) { return budget - budget / 8; }
+        static size_t writer_limit(const size_t budget) { return budget / 8; }
+        size_t thread_budget() const { return std::max<size_t>(1, options.memory / options.threads); }
+        static size_t buffer_size(const size_t budget) {
+            if (budget < MIN_BUFFER) return MIN_BUFFER;
+            return budget < FileWriter::BUFFER_SIZE ? budget : FileWriter::BUFFER_SIZE;
+        }
+
+        void hash_batch() {
+            __m128i hashes[BATCH];
+            for (size_t idx = 0; idx < batch_size; ++idx) {
+                hashes[idx] = AquaHash::Hash(reinterpret_cast<const uint8_t *>(batch[idx].data), batch[idx].len);
+            }
+
+            for (size_t idx = 0; status && idx < batch_size; ++idx) {
+                const Record &record = batch[idx];
+                const HashedRecord item{low_bits(hashes[idx]), high_bits(hashes[idx]), record.offset};
+                if (!spill.active() && digests.full(set_limit(options.memory))) start_spill(record.offset);
+                if (spill.active()) {
+                    status = spill.write(item) && status;
+                    continue;
+                }
+
+                uint64_t existing;
+                if (digests.insert(item, existing) || (options.verify && !equal(existing, record.data, record.len))) {
+                    write_record(record.data, record.len);
+                }
+            }
+            records += batch_size;
+            batch_size = 0;
+        }
+
+        void write_record(const char *data, const size_t len) {
+            status = writer->write(data, len) && status;
+            if (!options.record_size) status = writer->write(&options.delimiter, 1) && status;
+            ++unique;
+        }
+
+        // The length of the record which starts at a given offset.
+        size_t record_length(const uint64_t offset) const {
+            if (options.record_size) return std::min<uint64_t>(options.record_size, size - offset);
+            const void *end = memchr(input + offset, options.delimiter, size - offset);
+            return end != nullptr ? static_cast<const char *>(end) - (input + offset) : size - offset;
+        }
+
+        // A delimited record which starts with the same bytes is equal if it ends where the other one ends.
+        bool equal(const uint64_t offset, const char *data, const size_t len) const {
+            if (options.record_size) return record_length(offset) == len && memcmp(input + offset, data, len) == 0;
+            return size - offset >= len && memcmp(input + offset, data, len) == 0 &&
+                   (offset + len == size || input[offset + len] == options.delimiter);
+        }
+
+        std::string partition_path(const size_t id, const char *suffix) const {
+            return directory + "/" + std::to_string(id) + suffix;
+        }
+
+        // The number of digest bits to split about expected distinct digests by: enough for a partition to fit the
+        // digest set of one thread, and few enough for the writers of all partitions to fit their budget.
+        size_t partition_bits(const uint64_t expected, const size_t shift, const size_t budget) const {
+            const size_t limit = set_limit(thread_budget());
+            const size_t slot_bytes = DigestSet::slot_bytes(options.verify);
+            size_t bits = 1;
+            while (bits < 64 - shift && (MIN_BUFFER << (bits + 1)) <= budget &&
+                   6 * (expected >> bits) * slot_bytes > limit) {
+                ++bits;
+            }
+            return bits;
+        }
+
+        bool open_spill(Spill &out, const uint64_t boundary, const size_t shift, const size_t bits,
+                        const size_t budget) {
+            const size_t number = size_t(1) << bits;
+            const size_t buffer = buffer_size(budget / number);
+            out.shift = shift;
+            out.bits = bits;
+            bool ok = true;
+            for (size_t part = 0; part < number; ++part) {
+                const size_t id = next_id++;
+                out.writers.emplace_back(new FileWriter());
+                ok = out.writers.back()->open(partition_path(id, ".records"), buffer) && ok;
+                out.partitions.push_back(Partition{id, boundary, shift + bits});
+            }
+            return ok;
+        }
+
+        static bool close_spill(Spill &out) {
+            bool ok = true;
+            for (auto &partition : out.writers) ok = partition->close() && ok;
+            out.writers.clear();
+            return ok;
+        }
+
+        // Move the digest set and all records from offset on into partitions. The number of partitions is estimated
+        // from the records seen so far so that most partitions fit the memory of a thread.
+        void start_spill(const uint64_t offset) {
+            std::string pattern = options.temp_dir + "/aquahash-uniq-XXXXXX";
+            if (::mkdtemp(&pattern[0]) == nullptr) {
+                status = false;
+                return;
+            }
+            directory = pattern;
+
+            const uint64_t expected = (records + BATCH) * (size / std::max<uint64_t>(offset, 1) + 1);
+            const size_t budget = writer_limit(options.memory);
+            status = open_spill(spill, offset, 0, partition_bits(expected, 0, budget), budget) && status;
+            digests.for_each([this](const HashedRecord &item) { status = spill.write(item) && status; });
+            digests = DigestSet(options.verify);
+        }
+
+        // Write the sorted offsets of the unique records of a partition. If its digests outgrow the memory of a
+        // thread, the known digests and the remaining records are split into children.
+        bool dedup(const Partition &partition, DigestSet &set, Spill &children) {
+            const size_t budget = thread_budget();
+            const size_t writers = writer_limit(budget) / 2;
+            MappedFile file;
+            FileWriter offsets;
+            if (!file.open(partition_path(partition.id, ".records")) ||
+                !offsets.open(partition_path(partition.id, ".offsets"), buffer_size(writers))) {
+                return false;
+            }
+
+            // Digests before the boundary come first, they are known but their records are not written.
+            const HashedRecord *items = reinterpret_cast<const HashedRecord *>(file.data());
+            const size_t count = file.size() / sizeof(HashedRecord);
+            const size_t limit = partition.shift < 64 ? set_limit(budget) : SIZE_MAX;
+            bool ok = true;
+            set.reset(count, limit);
+            for (size_t idx = 0; idx < count; ++idx) {
+                const HashedRecord &item = items[idx];
+                if (!children.active() && set.full(limit)) {
+                    const uint64_t boundary = std::max(partition.boundary, item.offset);
+                    const size_t bits = partition_bits(count - idx + set.size(), partition.shift, writers);
+                    ok = open_spill(children, boundary, partition.shift, bits, writers) && ok;
+                    set.for_each([&children, &ok](const HashedRecord &known) { ok = children.write(known) && ok; });
+                    set.reset(0);
+                }
+                if (children.active()) {
+                    ok = children.write(item) && ok;
+                    continue;
+                }
+
+                uint64_t existing;
+                const bool inserted = set.insert(item, existing);
+                if (item.offset < partition.boundary) continue;
+                const char *record = input + item.offset;
+                if (inserted || (options.verify && !equal(existing, record, record_length(item.offset)))) {
+                    ok = offsets.write_value(item.offset) && ok;
+                }
+            }
+            set.reset(0);
+            file.close();
+            ::unlink(partition_path(partition.id, ".records").data());
+            return close_spill(children) && offsets.close() && ok;
+        }
+
+        // Deduplicate partitions in rounds, every round processes the children of the previous one.
+        bool dedup_partitions() {
+            if (!close_spill(spill)) return false;
+            std::vector<Partition> pending = spill.partitions;
+            std::vector<DigestSet> sets(options.threads, DigestSet(options.verify));
+            std::atomic<bool> succeeded(true);
+            while (succeeded && !pending.empty()) {
+                std::vector<Partition> next;
+                std::mutex lock;
+                parallel_for(pending.size(), options.threads, [&](const size_t task, const size_t tid) {
+                    Spill children;
+                    if (!dedup(pending[task], sets[tid], children)) succeeded = false;
+                    std::lock_guard<std::mutex> guard(lock);
+                    next.insert(next.end(), children.partitions.begin(), children.partitions.end());
+                });
+                pending.swap(next);
+            }
+            return succeeded;
+        }
+
+        // Write unique records in input order by merging the offsets of all partitions.
+        bool merge_partitions() {
+            using Head = std::pair<uint64_t, size_t>;
+            const size_t number = next_id;
+            std::vector<MappedFile> files(number);
+            std::vector<size_t> next(number, 0);
+            std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+            auto offset = [&files](const size_t part, const size_t idx) {
+                uint64_t value;
+                memcpy(&value, files[part].data() + idx * sizeof(value), sizeof(value));
+                return value;
+            };
+
+            for (size_t part = 0; part < number; ++part) {
+                if (!files[part].open(partition_path(part, ".offsets"))) return false;
+                if (files[part].size()) heads.emplace(offset(part, 0), part);
+            }
+
+            while (status && !heads.empty()) {
+                const Head head = heads.top();
+                heads.pop();
+                write_record(input + head.first, record_length(head.first));
+                const size_t part = head.second;
+                if (++next[part] < files[part].size() / sizeof(uint64_t)) heads.emplace(offset(part, next[part]), part);
+            }
+            return status;
+        }
+
+        void remove_partitions() {
+            if (directory.empty()) return;
+            spill = Spill();
+            number_of_partitions_ = next_id;
+            for (size_t id = 0; id < number_of_partitions_; ++id) {
+                ::unlink(partition_path(id, ".records").data());
+                ::unlink(partition_path(id, ".offsets").data());
+            }
+            ::rmdir(directory.data());
+            directory.clear();
+        }
+    };
+} // namespace aquahash
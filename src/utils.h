@@ -46,15 +46,20 @@ namespace aquahash {
         std::string operator()(__m128i value) {
             constexpr int BUFFER_SIZE = 32;
             char buffer[BUFFER_SIZE];
+            write(value, buffer);
+            return std::string(buffer, sizeof(__m128i) * 2);
+        }
+
+        // Write the 32 hex digits of a hash code without allocating a string.
+        char *write(__m128i value, char *ptr) const {
             alignas(16) uint8_t __attribute__((aligned(16))) v[sizeof(__m128i)];
             _mm_storeu_si128((__m128i *)v, value);
-            char *ptr = buffer;
-            for (int idx = 0; idx < sizeof(__m128i); ++idx) {
+            for (size_t idx = 0; idx < sizeof(__m128i); ++idx) {
                 const int pos = v[idx] * 2;
                 *ptr++ = data[pos];
                 *ptr++ = data[pos + 1];
             }
-            return std::string(buffer, sizeof(__m128i) * 2);
+            return ptr;
         }
 
       private:
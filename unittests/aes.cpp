@@ -0,0 +1,84 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define AQUAHASH_RUNTIME_DISPATCH
+#include "aes.h"
+#include "aquahash.h"
+#include "doctest/doctest.h"
+#include <random>
+#include <vector>
+
+namespace {
+    bool equal(const __m128i a, const __m128i b) { return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xffff; }
+
+    std::vector<uint8_t> create_data(const size_t n) {
+        std::mt19937_64 gen(17);
+        std::vector<uint8_t> data(n);
+        for (auto &c : data) c = static_cast<uint8_t>(gen());
+        return data;
+    }
+
+    std::vector<aquahash::Isa> supported_isas() {
+        std::vector<aquahash::Isa> isas{aquahash::Isa::SOFTWARE};
+        if (aquahash::detect_isa() >= aquahash::Isa::AESNI) isas.push_back(aquahash::Isa::AESNI);
+        if (aquahash::detect_isa() >= aquahash::Isa::VAES) isas.push_back(aquahash::Isa::VAES);
+        return isas;
+    }
+
+    __m128i incremental(const uint8_t *data, const size_t len, const __m128i seed) {
+        AquaHash hasher(seed);
+        for (size_t pos = 0; pos < len; pos += 100) hasher.Update(data + pos, std::min<size_t>(100, len - pos));
+        return hasher.Finalize();
+    }
+
+    using Reference = AquaHashKernel<aquahash::SoftwareAES>;
+    const __m128i seeds[] = {_mm_setzero_si128(), _mm_set1_epi64x(-1), _mm_set_epi64x(0x0123456789abcdef, 42)};
+} // namespace
+
+TEST_CASE("Software AES round") {
+    std::mt19937_64 gen(5);
+    for (int idx = 0; idx < 10000; ++idx) {
+        const __m128i state = _mm_set_epi64x(gen(), gen()), key = _mm_set_epi64x(gen(), gen());
+        CHECK(equal(aquahash::SoftwareAES::Round(state, key), _mm_aesenc_si128(state, key)));
+        CHECK(equal(aquahash::aesenc(state, key), _mm_aesenc_si128(state, key)));
+    }
+}
+
+TEST_CASE("Kernels give identical digests") {
+    const auto data = create_data(1024);
+    for (auto const seed : seeds) {
+        for (size_t len = 0; len <= data.size(); ++len) {
+            const __m128i expected = Reference::Hash(data.data(), len, seed);
+            CHECK(equal(AquaHashKernel<aquahash::HardwareAES>::Hash(data.data(), len, seed), expected));
+            if (aquahash::detect_isa() == aquahash::Isa::VAES) {
+                CHECK(equal(AquaHashKernel<aquahash::VectorAES>::Hash(data.data(), len, seed), expected));
+            }
+        }
+    }
+}
+
+TEST_CASE("Runtime dispatch") {
+    const auto data = create_data(4096 + 17);
+    CHECK(aquahash::Dispatcher::isa() == aquahash::detect_isa());
+    for (auto const isa : supported_isas()) {
+        CHECK(aquahash::Dispatcher::use(isa));
+        CHECK(aquahash::Dispatcher::isa() == isa);
+        for (size_t len : {0, 1, 15, 16, 63, 64, 65, 127, 128, 1000, 4096, 4096 + 17}) {
+            for (auto const seed : seeds) {
+                CHECK(equal(AquaHash::Hash(data.data(), len, seed), Reference::Hash(data.data(), len, seed)));
+                CHECK(equal(AquaHash::SmallKeyAlgorithm(data.data(), len, seed),
+                            Reference::SmallKeyAlgorithm(data.data(), len, seed)));
+                CHECK(equal(AquaHash::LargeKeyAlgorithm(data.data(), len, seed),
+                            Reference::LargeKeyAlgorithm(data.data(), len, seed)));
+                __m128i multi[3];
+                AquaHash::HashMulti(data.data(), len, seeds, 3, multi);
+                CHECK(equal(multi[2], Reference::Hash(data.data(), len, seeds[2])));
+
+                // Incremental hashing follows the same kernel.
+                CHECK(aquahash::Dispatcher::use(aquahash::Isa::SOFTWARE));
+                const __m128i expected = incremental(data.data(), len, seed);
+                CHECK(aquahash::Dispatcher::use(isa));
+                CHECK(equal(incremental(data.data(), len, seed), expected));
+            }
+        }
+    }
+    CHECK(aquahash::Dispatcher::use(aquahash::detect_isa()));
+}
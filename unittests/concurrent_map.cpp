@@ -0,0 +1,85 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "concurrent_map.h"
+#include "doctest/doctest.h"
+#include "interface.h"
+#include "utils.h"
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Basic operations") {
+    aquahash::concurrent_map<std::string, int> map(8);
+    CHECK(map.number_of_shards() == 8);
+    CHECK(map.insert("foo", 1));
+    CHECK(!map.insert("foo", 2));
+    CHECK(map.insert("bar", 3));
+    CHECK(map.size() == 2);
+
+    int value = 0;
+    CHECK(map.find("foo", value));
+    CHECK(value == 1);
+    CHECK(!map.find("baz", value));
+
+    CHECK(!map.insert_or_assign("foo", 5));
+    CHECK(map.find("foo", value));
+    CHECK(value == 5);
+
+    CHECK(map.erase("foo"));
+    CHECK(!map.erase("foo"));
+    CHECK(!map.contains("foo"));
+    CHECK(map.contains("bar"));
+    CHECK(map.size() == 1);
+
+    // Erased keys can be inserted again.
+    CHECK(map.insert("foo", 7));
+    CHECK(map.find("foo", value));
+    CHECK(value == 7);
+}
+
+TEST_CASE("Batch insert") {
+    aquahash::CharGenerator gen;
+    std::vector<std::pair<std::string, std::string>> items;
+    constexpr int N = 10000;
+    for (int idx = 0; idx < N; ++idx) items.emplace_back(gen(16), std::to_string(idx));
+
+    aquahash::concurrent_map<std::string, std::string> map;
+    CHECK(map.insert_batch(items.begin(), items.end()) == N);
+    CHECK(map.insert_batch(items.begin(), items.end()) == 0);
+    CHECK(map.size() == N);
+
+    std::string value;
+    for (auto const &item : items) {
+        CHECK(map.find(item.first, value));
+        CHECK(value == item.second);
+    }
+}
+
+TEST_CASE("Concurrent readers and writers") {
+    aquahash::CharGenerator gen;
+    constexpr int NTHREADS = 4;
+    constexpr int N = 20000;
+    std::vector<std::string> keys;
+    for (int idx = 0; idx < NTHREADS * N; ++idx) keys.push_back(gen(24));
+
+    aquahash::concurrent_map<std::string, int> map(16);
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < NTHREADS; ++tid) {
+        threads.emplace_back([&map, &keys, tid]() {
+            for (int idx = tid * N; idx < (tid + 1) * N; ++idx) map.insert(keys[idx], idx);
+        });
+        threads.emplace_back([&map, &keys, tid]() {
+            int value = 0;
+            for (int idx = tid * N; idx < (tid + 1) * N; ++idx) {
+                if (map.find(keys[idx], value) && value != idx) map.erase(keys[idx]); // Never happens.
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    CHECK(map.size() == NTHREADS * N);
+    int value = 0;
+    size_t count = 0;
+    for (int idx = 0; idx < NTHREADS * N; ++idx) count += map.find(keys[idx], value) && (value == idx);
+    CHECK(count == NTHREADS * N);
+}
@@ -0,0 +1,99 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "consistent_hash.h"
+#include "doctest/doctest.h"
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+    std::vector<std::string> create_names(const size_t n) {
+        std::vector<std::string> names;
+        for (size_t idx = 0; idx < n; ++idx) names.push_back("node-" + std::to_string(idx));
+        return names;
+    }
+
+    constexpr int NUMBER_OF_KEYS = 100000;
+    __m128i key(const int idx) { return aquahash::digest_of("key-" + std::to_string(idx)); }
+} // namespace
+
+TEST_CASE("Jump hash") {
+    std::vector<int> counts(10, 0);
+    size_t moved = 0;
+    for (int idx = 0; idx < NUMBER_OF_KEYS; ++idx) {
+        const int32_t before = aquahash::jump_hash(key(idx), 10);
+        const int32_t after = aquahash::jump_hash(key(idx), 11);
+        ++counts[before];
+        if (before != after) {
+            CHECK(after == 10); // Keys only move to the new bucket.
+            ++moved;
+        }
+    }
+    for (auto count : counts) CHECK(std::abs(count - NUMBER_OF_KEYS / 10) < NUMBER_OF_KEYS / 100);
+    CHECK(std::abs(static_cast<double>(moved) / NUMBER_OF_KEYS - 1.0 / 11) < 0.01);
+}
+
+TEST_CASE("Rendezvous") {
+    aquahash::Rendezvous hrw;
+    for (auto const &name : create_names(9)) hrw.add(name);
+    hrw.add("heavy", 2.0);
+
+    std::vector<int> counts(10, 0);
+    std::vector<size_t> owners;
+    for (int idx = 0; idx < NUMBER_OF_KEYS; ++idx) {
+        owners.push_back(hrw(key(idx)));
+        ++counts[owners.back()];
+    }
+
+    // The heavy node gets twice the share of the other nodes.
+    for (int idx = 0; idx < 9; ++idx) CHECK(std::abs(counts[idx] - NUMBER_OF_KEYS / 11) < NUMBER_OF_KEYS / 100);
+    CHECK(std::abs(counts[9] - 2 * NUMBER_OF_KEYS / 11) < NUMBER_OF_KEYS / 100);
+
+    // Only keys of a removed node move.
+    hrw.remove(3);
+    for (int idx = 0; idx < NUMBER_OF_KEYS; ++idx) {
+        const size_t owner = hrw(key(idx));
+        if (owners[idx] != 3) CHECK(owner == (owners[idx] > 3 ? owners[idx] - 1 : owners[idx]));
+    }
+}
+
+TEST_CASE("Maglev") {
+    const auto names = create_names(10);
+    aquahash::Maglev before(names, 65537);
+    std::vector<int> counts(10, 0);
+    for (int idx = 0; idx < NUMBER_OF_KEYS; ++idx) ++counts[before(key(idx))];
+    for (auto count : counts) CHECK(std::abs(count - NUMBER_OF_KEYS / 10) < NUMBER_OF_KEYS / 50);
+
+    // Removing one node moves few keys other than the ones it owned.
+    auto remaining = names;
+    remaining.erase(remaining.begin() + 5);
+    aquahash::Maglev after(remaining, 65537);
+    size_t moved = 0;
+    for (int idx = 0; idx < NUMBER_OF_KEYS; ++idx) {
+        const std::string &first = names[before(key(idx))];
+        const std::string &second = remaining[after(key(idx))];
+        moved += (first != second) && (first != names[5]);
+    }
+    CHECK(moved < NUMBER_OF_KEYS / 20);
+    CHECK(aquahash::Maglev(std::vector<std::string>())(key(0)) == -1);
+}
+
+TEST_CASE("Maglev table size") {
+    CHECK(aquahash::Maglev::next_prime(0) == 2);
+    CHECK(aquahash::Maglev::next_prime(2) == 2);
+    CHECK(aquahash::Maglev::next_prime(1000) == 1009);
+    CHECK(aquahash::Maglev::next_prime(65536) == 65537);
+
+    // Sizes which are not prime are rounded up, so every node can reach every slot and the table gets filled.
+    for (const size_t size : {0, 1, 2, 1000, 65536}) {
+        for (const size_t n : {1, 8, 10}) {
+            const aquahash::Maglev maglev(create_names(n), size);
+            CHECK(maglev.size() == aquahash::Maglev::next_prime(size));
+            for (int idx = 0; idx < 100; ++idx) {
+                const int32_t node = maglev(key(idx));
+                CHECK(node >= 0);
+                CHECK(node < static_cast<int32_t>(n));
+            }
+        }
+    }
+}
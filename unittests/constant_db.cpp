@@ -0,0 +1,142 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "constant_db.h"
+#include "doctest/doctest.h"
+#include <cstddef>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    std::string random_string(const size_t max_length, std::mt19937 &gen) {
+        std::string value(gen() % (max_length + 1), 0);
+        for (auto &c : value) c = static_cast<char>(gen());
+        return value;
+    }
+
+    std::string db_path() { return "constant_db_" + std::to_string(::getpid()) + ".cdb"; }
+
+    std::string value_of(const aquahash::ConstantDB::Value &value) {
+        return std::string(reinterpret_cast<const char *>(value.data), value.size);
+    }
+
+    // Build a database with a single key, overwrite part of the file and return the original header.
+    template <typename T>
+    aquahash::ConstantDB::Header write_corrupt_db(const std::string &path, const size_t offset, const T &value) {
+        aquahash::ConstantDBBuilder builder(1);
+        REQUIRE(builder.open(path));
+        REQUIRE(builder.add("key", "value"));
+        REQUIRE(builder.finish());
+        aquahash::ConstantDB::Header header{};
+        FILE *fp = fopen(path.data(), "r+b");
+        REQUIRE(fp != nullptr);
+        REQUIRE(fread(&header, sizeof(header), 1, fp) == 1);
+        REQUIRE(fseek(fp, static_cast<long>(offset), SEEK_SET) == 0);
+        REQUIRE(fwrite(&value, sizeof(value), 1, fp) == 1);
+        REQUIRE(fclose(fp) == 0);
+        return header;
+    }
+} // namespace
+
+TEST_CASE("Constant database") {
+    std::mt19937 gen(5);
+    const std::string path = db_path();
+    std::vector<std::string> keys, values;
+    for (size_t idx = 0; idx < 20000; ++idx) {
+        keys.push_back("key" + std::to_string(idx) + ":" + random_string(20, gen));
+        values.push_back(random_string(100, gen));
+    }
+
+    aquahash::ConstantDBBuilder builder(3);
+    REQUIRE(builder.open(path));
+    for (size_t idx = 0; idx < keys.size(); ++idx) REQUIRE(builder.add(keys[idx], values[idx]));
+    CHECK(builder.add("duplicate", "first"));
+    CHECK(builder.add("duplicate", "second"));
+    CHECK(builder.add("", "empty key"));
+    CHECK(builder.add("empty value", ""));
+    REQUIRE(builder.finish());
+
+    aquahash::ConstantDB db;
+    REQUIRE(db.open(path));
+    CHECK(db.size() == keys.size() + 4);
+
+    SUBCASE("Single lookups") {
+        for (size_t idx = 0; idx < keys.size(); ++idx) {
+            const auto value = db.find(keys[idx]);
+            REQUIRE(value.found());
+            CHECK(value_of(value) == values[idx]);
+        }
+        CHECK(value_of(db.find("duplicate")) == "first");
+        CHECK(value_of(db.find("")) == "empty key");
+        CHECK(db.find("empty value").found());
+        CHECK(db.find("empty value").size == 0);
+        CHECK_FALSE(db.find("missing").found());
+        for (size_t idx = 0; idx < 1000; ++idx) CHECK_FALSE(db.find("no" + random_string(30, gen)).found());
+    }
+
+    SUBCASE("Batched lookups") {
+        std::vector<std::string> queries;
+        for (size_t idx = 0; idx < 5000; ++idx) {
+            queries.push_back(gen() % 2 ? keys[gen() % keys.size()] : "no" + random_string(30, gen));
+        }
+        std::vector<aquahash::ConstantDB::Value> results(queries.size());
+        db.find(queries, results.data());
+        for (size_t idx = 0; idx < queries.size(); ++idx) {
+            const auto expected = db.find(queries[idx]);
+            CHECK(results[idx].found() == expected.found());
+            CHECK(results[idx].data == expected.data);
+        }
+    }
+
+    db.close();
+    ::unlink(path.data());
+}
+
+TEST_CASE("Constant database edge cases") {
+    const std::string path = db_path();
+
+    SUBCASE("An empty database") {
+        aquahash::ConstantDBBuilder builder;
+        REQUIRE(builder.open(path));
+        REQUIRE(builder.finish());
+        aquahash::ConstantDB db;
+        REQUIRE(db.open(path));
+        CHECK(db.size() == 0);
+        CHECK_FALSE(db.find("key").found());
+    }
+
+    SUBCASE("Invalid files") {
+        ::unlink(path.data());
+        aquahash::ConstantDB db;
+        CHECK_FALSE(db.open(path));
+        FILE *fp = fopen(path.data(), "wb");
+        REQUIRE(fp != nullptr);
+        const std::string garbage(256, 'x');
+        fwrite(garbage.data(), 1, garbage.size(), fp);
+        fclose(fp);
+        CHECK_FALSE(db.open(path));
+        CHECK_FALSE(db.find("key").found());
+        std::vector<std::string> keys{"key"};
+        aquahash::ConstantDB::Value value{nullptr, 0};
+        db.find(keys, &value);
+        CHECK_FALSE(value.found());
+
+        // A slot table offset which wraps around when the size of the table is added.
+        const uint64_t wrapped = UINT64_MAX - 15;
+        aquahash::ConstantDB::Header header =
+            write_corrupt_db(path, offsetof(aquahash::ConstantDB::Header, slots_offset), wrapped);
+        CHECK_FALSE(db.open(path));
+
+        // Buckets which are not a power of two or do not fit in the slot table.
+        using Bucket = aquahash::ConstantDB::Bucket;
+        for (const Bucket bucket : {Bucket{0, 3}, Bucket{1, 2}, Bucket{UINT64_MAX, 2}}) {
+            write_corrupt_db(path, header.buckets_offset, bucket);
+            CHECK_FALSE(db.open(path));
+        }
+        write_corrupt_db(path, header.buckets_offset, Bucket{0, 2});
+        REQUIRE(db.open(path));
+        CHECK(value_of(db.find("key")) == "value");
+    }
+
+    ::unlink(path.data());
+}
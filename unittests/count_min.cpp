@@ -0,0 +1,88 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "count_min.h"
+#include "doctest/doctest.h"
+#include "interface.h"
+#include <string>
+#include <vector>
+
+namespace {
+    // Key i appears (1000 / (i + 1)) times, i.e. a Zipf-like stream.
+    std::vector<std::string> create_stream() {
+        std::vector<std::string> stream;
+        for (int idx = 0; idx < 1000; ++idx) {
+            for (int count = 0; count < 1000 / (idx + 1); ++count) stream.push_back("key-" + std::to_string(idx));
+        }
+        return stream;
+    }
+
+    __m128i digest(const std::string &key) { return aquahash::hash<std::string>().digest(key); }
+
+    // Every key gets the same candidate table fingerprint.
+    struct CollidingHash {
+        __m128i digest(const std::string &key) const { return _mm_set_epi64x(aquahash::high_bits(::digest(key)), 42); }
+    };
+} // namespace
+
+TEST_CASE("Count-min sketch") {
+    const auto stream = create_stream();
+
+    SUBCASE("Estimates are never below the true counts") {
+        aquahash::CountMinSketch<4> regular(1024);
+        aquahash::CountMinSketch<4> conservative(1024, true);
+        for (auto const &key : stream) {
+            regular.update(digest(key));
+            conservative.update(digest(key));
+        }
+        for (int idx = 0; idx < 1000; ++idx) {
+            const auto h = digest("key-" + std::to_string(idx));
+            const uint32_t expected = 1000 / (idx + 1);
+            CHECK(regular.estimate(h) >= expected);
+            CHECK(conservative.estimate(h) >= expected);
+            CHECK(conservative.estimate(h) <= regular.estimate(h));
+        }
+        CHECK(regular.estimate(digest("key-0")) < 1010);
+    }
+
+    SUBCASE("Batch update and merge") {
+        __m128i digests[1000];
+        for (int idx = 0; idx < 1000; ++idx) digests[idx] = digest(stream[idx]);
+
+        aquahash::CountMinSketch<4> single(256), batch(256), first(256), second(256);
+        for (int idx = 0; idx < 1000; ++idx) single.update(digests[idx]);
+        batch.update_batch(digests, 1000);
+        first.update_batch(digests, 500);
+        second.update_batch(digests + 500, 500);
+        CHECK(first.merge(second));
+        CHECK(!first.merge(aquahash::CountMinSketch<4>(512)));
+        for (int idx = 0; idx < 1000; ++idx) {
+            CHECK(single.estimate(digests[idx]) == batch.estimate(digests[idx]));
+            CHECK(single.estimate(digests[idx]) == first.estimate(digests[idx]));
+        }
+    }
+}
+
+TEST_CASE("Heavy hitters") {
+    const auto stream = create_stream();
+    aquahash::HeavyHitters<std::string> all(5), even(5), odd(5);
+    all.update_batch(stream.begin(), stream.end());
+    for (size_t idx = 0; idx < stream.size(); ++idx) (idx % 2 ? odd : even).update(stream[idx]);
+
+    const auto top = all.top();
+    REQUIRE(top.size() == 5);
+    for (int idx = 0; idx < 5; ++idx) CHECK(top[idx].first == "key-" + std::to_string(idx));
+
+    CHECK(even.merge(odd));
+    const auto merged = even.top();
+    REQUIRE(merged.size() == 5);
+    for (int idx = 0; idx < 5; ++idx) CHECK(merged[idx].first == "key-" + std::to_string(idx));
+}
+
+TEST_CASE("Heavy hitters with colliding fingerprints") {
+    aquahash::HeavyHitters<std::string, 4, CollidingHash> hitters(5);
+    hitters.update("rare");
+    for (int idx = 0; idx < 100; ++idx) hitters.update("heavy");
+    const auto top = hitters.top();
+    REQUIRE(top.size() == 1);
+    CHECK(top[0].first == "heavy");
+    CHECK(top[0].second >= 100);
+}
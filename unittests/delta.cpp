@@ -0,0 +1,133 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "delta.h"
+#include "doctest/doctest.h"
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    struct MemoryWriter {
+        std::vector<uint8_t> data;
+        bool write(const void *ptr, const size_t len) {
+            data.insert(data.end(), static_cast<const uint8_t *>(ptr), static_cast<const uint8_t *>(ptr) + len);
+            return true;
+        }
+    };
+
+    uint32_t reference_checksum(const uint8_t *data, const size_t len) {
+        uint32_t a = 0, b = 0;
+        for (size_t idx = 0; idx < len; ++idx) {
+            a += data[idx];
+            b += static_cast<uint32_t>(len - idx) * data[idx];
+        }
+        return (a & 0xffff) | (b << 16);
+    }
+
+    std::vector<uint8_t> random_bytes(const size_t len, const uint64_t seed) {
+        std::mt19937_64 gen(seed);
+        std::vector<uint8_t> data(len);
+        for (auto &c : data) c = static_cast<uint8_t>(gen());
+        return data;
+    }
+
+    // Return the delta and check that it rebuilds the new data from the old data.
+    std::vector<uint8_t> round_trip(const std::vector<uint8_t> &old_data, const std::vector<uint8_t> &new_data,
+                                    const uint32_t block_size) {
+        aquahash::Signature sig;
+        CHECK(sig.compute(old_data.data(), old_data.size(), block_size));
+        MemoryWriter delta, result;
+        CHECK(aquahash::compute_delta(sig, new_data.data(), new_data.size(), delta));
+        CHECK(aquahash::apply_delta(old_data.data(), old_data.size(), delta.data.data(), delta.data.size(), result));
+        CHECK(result.data == new_data);
+        return delta.data;
+    }
+} // namespace
+
+TEST_CASE("Weak checksum") {
+    const auto data = random_bytes(5000, 1);
+    for (size_t len = 0; len < 300; ++len) {
+        CHECK(aquahash::weak_checksum(data.data(), len) == reference_checksum(data.data(), len));
+    }
+    CHECK(aquahash::weak_checksum(data.data(), 4096) == reference_checksum(data.data(), 4096));
+
+    // Rolling the window gives the same checksum as computing it from scratch.
+    const size_t window = 700;
+    aquahash::RollingChecksum checksum(data.data(), window);
+    for (size_t pos = 0; pos + window < data.size(); ++pos) {
+        checksum.roll(data[pos], data[pos + window]);
+        REQUIRE(checksum.value() == reference_checksum(data.data() + pos + 1, window));
+    }
+}
+
+TEST_CASE("Delta") {
+    const uint32_t block_size = 512;
+    const auto old_data = random_bytes(100000, 2);
+
+    SUBCASE("Identical files are all copies") {
+        const auto delta = round_trip(old_data, old_data, block_size);
+        CHECK(delta.size() < block_size);
+    }
+
+    SUBCASE("Inserts, deletes and changes") {
+        auto new_data = old_data;
+        new_data.insert(new_data.begin() + 1000, 37, 'x');
+        new_data.erase(new_data.begin() + 30000, new_data.begin() + 30100);
+        for (size_t idx = 60000; idx < 60010; ++idx) new_data[idx] ^= 0xff;
+        const auto delta = round_trip(old_data, new_data, block_size);
+
+        // Only the blocks around every edit are sent as literals.
+        CHECK(delta.size() < 8 * block_size);
+    }
+
+    SUBCASE("Unrelated, short and empty files") {
+        round_trip(old_data, random_bytes(5000, 3), block_size);
+        round_trip(old_data, std::vector<uint8_t>(100, 1), block_size);
+        round_trip(old_data, std::vector<uint8_t>(), block_size);
+        round_trip(std::vector<uint8_t>(), old_data, block_size);
+    }
+
+    SUBCASE("Repeated blocks") {
+        std::vector<uint8_t> zeros(64 * block_size, 0);
+        auto new_data = zeros;
+        new_data[10 * block_size + 3] = 1;
+        round_trip(zeros, new_data, block_size);
+    }
+
+    SUBCASE("Invalid deltas are rejected") {
+        aquahash::Signature sig;
+        sig.compute(old_data.data(), old_data.size(), block_size);
+        auto new_data = old_data;
+        new_data[5] = 0;
+        MemoryWriter delta, result;
+        aquahash::compute_delta(sig, new_data.data(), new_data.size(), delta);
+
+        // A different basis file gives a different digest.
+        auto other = old_data;
+        other[50000] ^= 1;
+        CHECK(!aquahash::apply_delta(other.data(), other.size(), delta.data.data(), delta.data.size(), result));
+
+        // A truncated delta.
+        CHECK(!aquahash::apply_delta(old_data.data(), old_data.size(), delta.data.data(), delta.data.size() - 1,
+                                     result));
+    }
+}
+
+TEST_CASE("Signature file") {
+    const std::string path = "delta_" + std::to_string(::getpid()) + ".sig";
+    const auto data = random_bytes(10000, 4);
+    aquahash::Signature sig, loaded;
+    CHECK(sig.compute(data.data(), data.size(), 1000, 12));
+    CHECK(sig.save(path));
+    CHECK(loaded.load(path));
+    CHECK(loaded.size() == 10);
+    CHECK(loaded.block_size() == 1000);
+    CHECK(loaded.strong_bytes() == 12);
+    CHECK(loaded.file_size() == data.size());
+    for (size_t block = 0; block < sig.size(); ++block) {
+        CHECK(loaded.weak(block) == sig.weak(block));
+        CHECK(memcmp(loaded.strong(block), sig.strong(block), 12) == 0);
+    }
+    ::unlink(path.data());
+    CHECK(!loaded.load(path));
+}
@@ -0,0 +1,74 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aquahash.h"
+#include "digest_cache.h"
+#include "doctest/doctest.h"
+#include <string>
+#include <unistd.h>
+
+namespace {
+    aquahash::DigestCache::Key create_key(const uint64_t ino) {
+        aquahash::DigestCache::Key key;
+        memset(&key, 0, sizeof(key));
+        key.dev = 42;
+        key.ino = ino;
+        key.size = 1024;
+        key.mtime_sec = 1500000000;
+        key.ctime_sec = 1500000000;
+        return key;
+    }
+
+    bool equal(const __m128i x, const __m128i y) { return _mm_test_all_ones(_mm_cmpeq_epi8(x, y)); }
+} // namespace
+
+TEST_CASE("Digest cache") {
+    const std::string path = "digest_cache_" + std::to_string(::getpid()) + ".cache";
+    const __m128i first = _mm_set_epi64x(1, 2);
+    const __m128i second = _mm_set_epi64x(3, 4);
+    __m128i digest;
+
+    SUBCASE("Lookup and insert") {
+        aquahash::DigestCache cache;
+        CHECK(cache.open(path, 1024));
+        CHECK(cache.capacity() == 1024);
+
+        auto key = create_key(1);
+        CHECK(!cache.lookup(key, digest));
+        CHECK(cache.insert(key, first));
+        CHECK(cache.lookup(key, digest));
+        CHECK(equal(digest, first));
+
+        // A modified file must not be answered from the cache.
+        key.mtime_nsec = 1;
+        CHECK(!cache.lookup(key, digest));
+        CHECK(cache.insert(key, second));
+        CHECK(cache.lookup(key, digest));
+        CHECK(equal(digest, second));
+    }
+
+    SUBCASE("Entries are persistent") {
+        aquahash::DigestCache cache;
+        CHECK(cache.open(path, 1024));
+        for (uint64_t ino = 0; ino < 256; ++ino) cache.insert(create_key(ino), _mm_set_epi64x(ino, ino));
+        cache.close();
+
+        CHECK(cache.open(path));
+        CHECK(cache.capacity() == 1024);
+        size_t hits = 0;
+        for (uint64_t ino = 0; ino < 256; ++ino) {
+            if (cache.lookup(create_key(ino), digest)) {
+                CHECK(equal(digest, _mm_set_epi64x(ino, ino)));
+                ++hits;
+            }
+        }
+        CHECK(hits == 256);
+    }
+
+    SUBCASE("Recent files are not stable") {
+        auto key = create_key(1);
+        CHECK(aquahash::DigestCache::is_stable(key));
+        key.mtime_sec = time(nullptr);
+        CHECK(!aquahash::DigestCache::is_stable(key));
+    }
+
+    ::unlink(path.data());
+}
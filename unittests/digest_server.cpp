@@ -0,0 +1,134 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aquahash.h"
+#include "digest_server.h"
+#include "doctest/doctest.h"
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    void write_file(const std::string &path, const std::string &content) {
+        FILE *fp = fopen(path.data(), "wb");
+        REQUIRE(fp != nullptr);
+        fwrite(content.data(), 1, content.size(), fp);
+        fclose(fp);
+    }
+
+    std::string absolute_path(const std::string &path) {
+        char buffer[PATH_MAX];
+        REQUIRE(realpath(path.data(), buffer) != nullptr);
+        return buffer;
+    }
+
+    bool equal(const uint64_t *digest, const std::string &content) {
+        const __m128i expected = AquaHash::Hash(reinterpret_cast<const uint8_t *>(content.data()), content.size());
+        return _mm_test_all_ones(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(digest)), expected));
+    }
+
+    std::vector<aquahash::DigestClient::Reply> query(const std::string &socket, const std::vector<std::string> &paths) {
+        std::vector<aquahash::DigestClient::Reply> replies;
+        REQUIRE(aquahash::DigestClient::query(socket, paths, replies));
+        REQUIRE(replies.size() == paths.size());
+        return replies;
+    }
+
+    // Events are processed in the background, so poll the daemon until it has the expected digest.
+    bool wait_for(const std::string &socket, const std::string &path, const std::string &content) {
+        for (int attempt = 0; attempt < 500; ++attempt) {
+            const auto replies = query(socket, {path});
+            if (replies[0].found && equal(replies[0].digest, content)) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+} // namespace
+
+TEST_CASE("Digest server") {
+    const std::string folder = "digest_server_" + std::to_string(::getpid());
+    const std::string socket = folder + ".sock";
+    REQUIRE(::mkdir(folder.data(), 0755) == 0);
+    REQUIRE(::mkdir((folder + "/src").data(), 0755) == 0);
+    write_file(folder + "/a.txt", "first file");
+    write_file(folder + "/src/b.txt", std::string(200000, 'b'));
+    const std::string a = absolute_path(folder + "/a.txt");
+    const std::string b = absolute_path(folder + "/src/b.txt");
+
+    {
+        aquahash::DigestServer server(2);
+        REQUIRE(server.listen(socket));
+        REQUIRE(server.watch(folder));
+        server.wait();
+        CHECK(server.size() == 2);
+        std::thread loop([&server] { server.run(); });
+
+        // Only one daemon can use a socket.
+        aquahash::DigestServer other(1);
+        CHECK(!other.listen(socket));
+
+        SUBCASE("Batched queries") {
+            const auto replies = query(socket, {a, b, absolute_path(folder) + "/missing.txt", ""});
+            CHECK(replies[0].found);
+            CHECK(equal(replies[0].digest, "first file"));
+            CHECK(replies[1].found);
+            CHECK(!replies[2].found);
+            CHECK(!replies[3].found);
+
+            // The digest of a large file is the same as the digest computed by the aquahash command.
+            aquahash::FileReader<aquahash::AquaHashPolicy> reader(aquahash::Params::QUIET);
+            CHECK(reader(b.data()));
+            const __m128i expected = reader.digest();
+            CHECK(memcmp(replies[1].digest, &expected, sizeof(expected)) == 0);
+        }
+
+        SUBCASE("Changes are picked up") {
+            write_file(a, "modified");
+            CHECK(wait_for(socket, a, "modified"));
+
+            // New folders are watched.
+            REQUIRE(::mkdir((folder + "/new").data(), 0755) == 0);
+            write_file(folder + "/new/c.txt", "new file");
+            CHECK(wait_for(socket, absolute_path(folder + "/new/c.txt"), "new file"));
+            write_file(folder + "/new/c.txt", "changed again");
+            CHECK(wait_for(socket, absolute_path(folder + "/new/c.txt"), "changed again"));
+            ::unlink((folder + "/new/c.txt").data());
+            ::rmdir((folder + "/new").data());
+
+            // Deleted files are never answered.
+            ::unlink(b.data());
+            CHECK(!query(socket, {b})[0].found);
+        }
+
+        SUBCASE("Removed files are forgotten") {
+            const size_t before = server.number_of_generations();
+            for (int idx = 0; idx < 100; ++idx) {
+                const std::string temp = folder + "/temp" + std::to_string(idx);
+                write_file(temp, "temporary");
+                ::unlink(temp.data());
+            }
+
+            // A query wakes up the event loop, which drops the generations once the workers are idle.
+            bool pruned = false;
+            for (int attempt = 0; attempt < 500 && !pruned; ++attempt) {
+                query(socket, {a});
+                pruned = server.number_of_generations() == before;
+                if (!pruned) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            CHECK(pruned);
+        }
+
+        server.stop();
+        loop.join();
+    }
+
+    // The socket is removed when the daemon exits.
+    std::vector<aquahash::DigestClient::Reply> replies;
+    CHECK(!aquahash::DigestClient::query(socket, {a}, replies));
+    ::unlink(a.data());
+    ::unlink(b.data());
+    ::rmdir((folder + "/src").data());
+    ::rmdir(folder.data());
+}
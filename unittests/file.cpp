@@ -16,3 +16,32 @@ TEST_CASE("Basic tests") {
     Hasher hasher(0);
     hasher("file.cpp");
 }
+
+TEST_CASE("Byte range") {
+    using Hasher = aquahash::FileReader<aquahash::AquaHashPolicy>;
+    FILE *fp = fopen("file.cpp", "rb");
+    std::string content(1 << 20, 0);
+    content.resize(fread(&content[0], 1, content.size(), fp));
+    fclose(fp);
+
+    SUBCASE("Whole file") {
+        Hasher hasher(0);
+        CHECK(hasher("file.cpp", 0, 0));
+        const __m128i expected = AquaHash::Hash((const uint8_t *)content.data(), content.size());
+        CHECK(_mm_test_all_ones(_mm_cmpeq_epi8(hasher.digest(), expected)));
+    }
+
+    SUBCASE("Partial range") {
+        Hasher hasher(0);
+        CHECK(hasher("file.cpp", 17, 100));
+        const __m128i expected = AquaHash::Hash((const uint8_t *)content.data() + 17, 100);
+        CHECK(_mm_test_all_ones(_mm_cmpeq_epi8(hasher.digest(), expected)));
+    }
+
+    SUBCASE("Sampled fingerprint") {
+        Hasher first(aquahash::Params::SAMPLED), second(aquahash::Params::SAMPLED);
+        CHECK(first.sample("file.cpp", 4));
+        CHECK(second.sample("file.cpp", 4));
+        CHECK(_mm_test_all_ones(_mm_cmpeq_epi8(first.digest(), second.digest())));
+    }
+}
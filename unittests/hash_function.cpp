@@ -1,10 +1,12 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "aquahash.h"
+#include "constexpr_hash.h"
 #include "doctest/doctest.h"
 #include "fmt/format.h"
 #include "interface.h"
 #include "utils.h"
 #include <string>
+#include <random>
 #include <tuple>
 #include <vector>
 #include <x86intrin.h>
@@ -201,3 +203,144 @@ TEST_CASE("Print") {
     fmt::print("Hashcode u8: {}\n", writer(hashcode));
     fmt::print("Hashcode u8: {}\n", result_u8);
 }
+
+namespace {
+    constexpr char small_key[] = "0123456789012345678901234567890";
+    constexpr char large_key[] = "01234567890123456789012345678901"
+                                 "23456789012345678901234567890123"
+                                 "45678901234567890123456789012345"
+                                 "6789012345678901234567890123456";
+
+    // Hash(test_key_small, 31, initialize_0) and Hash(test_key_large, 127, initialize_1) from the test vectors above.
+    static_assert(ConstexprAquaHash::Hash(small_key, 31).low == 0x77CB10C8CA44F74EULL, "small key");
+    static_assert(ConstexprAquaHash::Hash(small_key, 31).high == 0x9BBE6E0EDB9ED790ULL, "small key");
+    static_assert(ConstexprAquaHash::Hash(large_key, 127, {~0ULL, ~0ULL}).low == 0xC3FA4BB73A5ADD0EULL, "large key");
+    static_assert(ConstexprAquaHash::Hash(large_key, 127, {~0ULL, ~0ULL}).high == 0x13BFB98BA28473FFULL, "large key");
+
+    int dispatch(const std::string &command) {
+        using namespace aquahash::literals;
+        switch (aquahash::hash64(command)) {
+        case "add"_aqh:
+            return 1;
+        case "remove"_aqh:
+            return 2;
+        default:
+            return 0;
+        }
+    }
+} // namespace
+
+TEST_CASE("Constexpr hash") {
+    const aquahash::Block128 seeds[] = {{0, 0}, {~0ULL, ~0ULL}, {0x0123456789abcdefULL, 0xfedcba9876543210ULL}};
+    SUBCASE("Test vectors") {
+        for (auto const seed : seeds) {
+            const __m128i initialize = _mm_set_epi64x(seed.high, seed.low);
+            for (size_t len = 0; len <= strlen(large_key); ++len) {
+                const aquahash::Block128 expected = ConstexprAquaHash::Hash(large_key, len, seed);
+                const __m128i hash = AquaHash::Hash(reinterpret_cast<const uint8_t *>(large_key), len, initialize);
+                CHECK(aquahash::low_bits(hash) == expected.low);
+                CHECK(aquahash::high_bits(hash) == expected.high);
+            }
+        }
+    }
+
+    SUBCASE("Random keys") {
+        std::mt19937_64 gen(11);
+        std::string key(1000, 0);
+        for (auto &c : key) c = static_cast<char>(gen());
+        for (size_t len = 0; len <= key.size(); len += 7) {
+            const aquahash::Block128 expected = ConstexprAquaHash::Hash(key.data(), len);
+            const __m128i hash = AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.data()), len);
+            CHECK(aquahash::low_bits(hash) == expected.low);
+            CHECK(aquahash::high_bits(hash) == expected.high);
+        }
+    }
+
+    SUBCASE("Literals") {
+        using namespace aquahash::literals;
+        CHECK(aquahash::hash64("foo") == "foo"_aqh);
+        CHECK(aquahash::hash<std::string>()("foo") == "foo"_aqh);
+        CHECK(dispatch("add") == 1);
+        CHECK(dispatch("remove") == 2);
+        CHECK(dispatch("list") == 0);
+    }
+}
+
+TEST_CASE("Scatter/gather hash") {
+    std::mt19937_64 gen(23);
+    std::string key(600, 0);
+    for (auto &c : key) c = static_cast<char>(gen());
+    const __m128i initialize = _mm_set_epi64x(0x0123456789abcdefLL, 0x7edcba9876543210LL);
+
+    for (size_t len = 0; len <= key.size(); len += 3) {
+        const __m128i expected = AquaHash::Hash(reinterpret_cast<const uint8_t *>(key.data()), len, initialize);
+
+        // Split the key at random positions, including empty buffers.
+        for (size_t trial = 0; trial < 8; ++trial) {
+            std::vector<struct iovec> iov;
+            size_t pos = 0;
+            while (pos < len || iov.empty()) {
+                const size_t size = std::min<size_t>(len - pos, gen() % 80);
+                iov.push_back(iovec{const_cast<char *>(key.data()) + pos, size});
+                pos += size;
+            }
+            const __m128i hash = AquaHash::HashV(iov.data(), iov.size(), initialize);
+            CHECK(memcmp(&hash, &expected, sizeof(hash)) == 0);
+        }
+    }
+}
+
+TEST_CASE("Copy and hash") {
+    std::mt19937_64 gen(31);
+    std::vector<uint8_t> src(1000);
+    for (auto &c : src) c = static_cast<uint8_t>(gen());
+    const __m128i initialize = _mm_set_epi64x(0x0123456789abcdefLL, 0x7edcba9876543210LL);
+
+    SUBCASE("One-shot") {
+        for (const bool non_temporal : {false, true}) {
+            for (size_t len = 0; len <= 300; ++len) {
+                // An aligned and an unaligned destination.
+                alignas(16) uint8_t dst[320] = {};
+                const size_t offset = len % 2;
+                const __m128i hash = AquaHash::CopyAndHash(dst + offset, src.data(), len, initialize, non_temporal);
+                const __m128i expected = AquaHash::Hash(src.data(), len, initialize);
+                CHECK(memcmp(&hash, &expected, sizeof(hash)) == 0);
+                CHECK(memcmp(dst + offset, src.data(), len) == 0);
+            }
+        }
+    }
+
+    SUBCASE("Incremental") {
+        for (size_t chunk = 1; chunk <= 150; chunk += 7) {
+            std::vector<uint8_t> dst(src.size());
+            AquaHash copier(initialize), hasher(initialize);
+            for (size_t pos = 0; pos < src.size(); pos += chunk) {
+                const size_t len = std::min(chunk, src.size() - pos);
+                copier.CopyAndUpdate(dst.data() + pos, src.data() + pos, len, chunk % 2);
+                hasher.Update(src.data() + pos, len);
+            }
+            const __m128i hash = copier.Finalize(), expected = hasher.Finalize();
+            CHECK(memcmp(&hash, &expected, sizeof(hash)) == 0);
+            CHECK(dst == src);
+        }
+    }
+}
+
+TEST_CASE("Hash with multiple seeds") {
+    std::mt19937_64 gen(49);
+    std::vector<uint8_t> key(200);
+    for (auto &c : key) c = static_cast<uint8_t>(gen());
+    __m128i seeds[17];
+    for (auto &seed : seeds) seed = _mm_set_epi64x(gen(), gen());
+
+    for (size_t len = 0; len <= key.size(); ++len) {
+        for (size_t k = 1; k <= 17; ++k) {
+            __m128i hashes[17];
+            AquaHash::HashMulti(key.data(), len, seeds, k, hashes);
+            for (size_t j = 0; j < k; ++j) {
+                const __m128i expected = AquaHash::Hash(key.data(), len, seeds[j]);
+                CHECK(memcmp(&hashes[j], &expected, sizeof(expected)) == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "hash_join.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    std::vector<std::string> create_keys(const size_t n, const size_t distinct) {
+        std::vector<std::string> keys;
+        for (size_t idx = 0; idx < n; ++idx) keys.push_back("key-" + std::to_string((idx * 7919) % distinct));
+        return keys;
+    }
+} // namespace
+
+TEST_CASE("Radix partitions") {
+    const auto keys = create_keys(100000, 30000);
+    const aquahash::RadixPartitions parts(keys, 6, 4);
+    CHECK(parts.number_of_partitions() == 64);
+    CHECK(parts.size() == keys.size());
+
+    // Every row appears exactly once and equal keys share a partition.
+    std::vector<int> seen(keys.size(), 0);
+    std::map<std::string, size_t> owners;
+    for (size_t part = 0; part < parts.number_of_partitions(); ++part) {
+        for (auto it = parts.begin(part); it != parts.end(part); ++it) {
+            ++seen[it->row];
+            auto result = owners.emplace(keys[it->row], part);
+            CHECK(result.first->second == part);
+            CHECK(it->hash == aquahash::low_bits(aquahash::digest_of(keys[it->row])));
+        }
+    }
+    CHECK(std::all_of(seen.begin(), seen.end(), [](const int count) { return count == 1; }));
+}
+
+TEST_CASE("Hash join") {
+    for (const size_t threads : {0, 1, 4}) {
+        const auto build = create_keys(50000, 20000);
+        const auto probe = create_keys(80000, 40000);
+        auto matches = aquahash::hash_join(build, probe, threads);
+
+        std::multimap<std::string, uint64_t> expected_build;
+        for (size_t idx = 0; idx < build.size(); ++idx) expected_build.emplace(build[idx], idx);
+        std::vector<std::pair<uint64_t, uint64_t>> expected;
+        for (size_t idx = 0; idx < probe.size(); ++idx) {
+            auto range = expected_build.equal_range(probe[idx]);
+            for (auto it = range.first; it != range.second; ++it) expected.emplace_back(it->second, idx);
+        }
+
+        std::sort(matches.begin(), matches.end());
+        std::sort(expected.begin(), expected.end());
+        CHECK(matches == expected);
+    }
+}
+
+TEST_CASE("Group by") {
+    const auto keys = create_keys(100000, 12345);
+    auto groups = aquahash::group_by_count(keys, 4);
+    CHECK(groups.size() == 12345);
+
+    std::map<std::string, uint64_t> expected;
+    for (auto const &key : keys) ++expected[key];
+    size_t total = 0;
+    for (auto const &group : groups) {
+        CHECK(expected[keys[group.first]] == group.second);
+        total += group.second;
+    }
+    CHECK(total == keys.size());
+
+    // Zero threads is the same as one.
+    CHECK(aquahash::group_by_count(keys, 0).size() == 12345);
+}
@@ -0,0 +1,67 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "hyperloglog.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+    std::vector<std::string> create_keys(const size_t begin, const size_t end) {
+        std::vector<std::string> keys;
+        for (size_t idx = begin; idx < end; ++idx) keys.push_back("key-" + std::to_string(idx));
+        return keys;
+    }
+
+    bool is_close(const double estimate, const double expected, const double error) {
+        return std::abs(estimate - expected) <= error * expected;
+    }
+} // namespace
+
+TEST_CASE("Cardinality estimation") {
+    SUBCASE("Small sets stay sparse") {
+        aquahash::HyperLogLog hll(14);
+        hll.add_batch(create_keys(0, 100));
+        hll.add_batch(create_keys(0, 100));
+        CHECK(hll.is_sparse());
+        CHECK(is_close(hll.estimate(), 100, 0.02));
+    }
+
+    SUBCASE("Large sets") {
+        aquahash::HyperLogLog hll(14);
+        hll.add_batch(create_keys(0, 200000));
+        CHECK(!hll.is_sparse());
+        CHECK(is_close(hll.estimate(), 200000, 0.03));
+    }
+
+    SUBCASE("Merge") {
+        aquahash::HyperLogLog first(12), second(12), all(12);
+        const auto x = create_keys(0, 60000);
+        const auto y = create_keys(30000, 90000);
+        first.add_batch(x);
+        second.add_batch(y);
+        all.add_batch(x);
+        all.add_batch(y);
+        CHECK(first.merge(second));
+        CHECK(first.estimate() == all.estimate());
+
+        // Sparse sketches can be merged into dense ones and vice versa.
+        aquahash::HyperLogLog sparse(12);
+        sparse.add_batch(create_keys(0, 10));
+        CHECK(sparse.is_sparse());
+        CHECK(sparse.merge(all));
+        CHECK(sparse.estimate() == all.estimate());
+        CHECK(!first.merge(aquahash::HyperLogLog(10)));
+    }
+
+    SUBCASE("Precomputed digests") {
+        aquahash::HyperLogLog first(14), second(14);
+        const auto keys = create_keys(0, 1000);
+        __m128i digests[1000];
+        for (size_t idx = 0; idx < keys.size(); ++idx) {
+            digests[idx] = AquaHash::Hash((const uint8_t *)keys[idx].data(), keys[idx].size());
+        }
+        first.add_batch(keys);
+        second.add_batch(digests, keys.size());
+        CHECK(first.estimate() == second.estimate());
+    }
+}
@@ -0,0 +1,59 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "minhash.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+    template <size_t K> typename aquahash::MinHash<K>::Signature sketch(const int begin, const int end) {
+        aquahash::MinHash<K> minhash;
+        for (int idx = begin; idx < end; ++idx) minhash.add(reinterpret_cast<const uint8_t *>(&idx), sizeof(idx));
+        return minhash.signature();
+    }
+} // namespace
+
+TEST_CASE("MinHash") {
+    constexpr size_t K = 256;
+    const auto first = sketch<K>(0, 1000);
+    const auto second = sketch<K>(500, 1500);
+    const double expected = 500.0 / 1500.0;
+
+    SUBCASE("Jaccard estimate") {
+        CHECK(aquahash::MinHash<K>::jaccard(first, first) == 1.0);
+        CHECK(std::abs(aquahash::MinHash<K>::jaccard(first, second) - expected) < 0.1);
+        CHECK(aquahash::MinHash<K>::jaccard(first, sketch<K>(2000, 3000)) < 0.05);
+    }
+
+    SUBCASE("Batch update") {
+        aquahash::MinHash<K> minhash;
+        __m128i digests[1000];
+        for (int idx = 0; idx < 1000; ++idx) digests[idx] = AquaHash::Hash(reinterpret_cast<const uint8_t *>(&idx), 4);
+        minhash.add_batch(digests, 500);
+        minhash.add_batch(digests + 500, 500);
+        CHECK(minhash.signature() == first);
+
+        // The lane blocking must also handle a number of lanes that is not a multiple of the block size.
+        aquahash::MinHash<36> single, batch;
+        for (int idx = 0; idx < 1000; ++idx) single.add(digests[idx]);
+        batch.add_batch(digests, 1000);
+        CHECK(single.signature() == batch.signature());
+    }
+
+    SUBCASE("Shingles") {
+        const std::string text = "the quick brown fox jumps over the lazy dog";
+        aquahash::MinHash<64> first_text, second_text;
+        first_text.add_shingles(reinterpret_cast<const uint8_t *>(text.data()), text.size(), 4);
+        second_text.add_shingles(reinterpret_cast<const uint8_t *>(text.data()), text.size(), 4);
+        CHECK(first_text.signature() == second_text.signature());
+    }
+
+    SUBCASE("b-bit MinHash") {
+        using BBit = aquahash::BBitMinHash<2, K>;
+        const auto x = BBit::compress(first);
+        const auto y = BBit::compress(second);
+        CHECK(x.size() == 8);
+        CHECK(BBit::jaccard(x, x) == 1.0);
+        CHECK(std::abs(BBit::jaccard(x, y) - expected) < 0.15);
+    }
+}
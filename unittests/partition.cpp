@@ -0,0 +1,117 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aquahash.h"
+#include "doctest/doctest.h"
+#include "interface.h"
+#include "mapped_file.h"
+#include "partition.h"
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    // Tab separated records with a random id, a key from a small vocabulary and a payload of random length.
+    std::string random_records(const size_t number_of_records, const size_t max_payload, std::mt19937 &gen) {
+        std::string data;
+        for (size_t idx = 0; idx < number_of_records; ++idx) {
+            data += std::to_string(idx) + "\tkey" + std::to_string(gen() % 1000) + "\t" +
+                    std::string(gen() % (max_payload + 1), 'p') + "\n";
+        }
+        return data;
+    }
+
+    // The expected content of every partition, records keep their input order.
+    std::vector<std::string> expected_partitions(const std::string &data, const size_t partitions,
+                                                 const size_t key_field) {
+        std::vector<std::string> outputs(partitions);
+        size_t start = 0;
+        while (start < data.size()) {
+            size_t end = data.find('\n', start);
+            if (end == std::string::npos) end = data.size();
+            const auto key = aquahash::record_field(data.data() + start, end - start, key_field, '\t');
+            const size_t part = aquahash::shard(aquahash::digest_of(std::string(key.first, key.second)), partitions);
+            outputs[part] += data.substr(start, end - start) + "\n";
+            start = end + 1;
+        }
+        return outputs;
+    }
+
+    std::vector<std::string> run_partitioner(const std::string &data, const aquahash::PartitionOptions &options) {
+        const std::string input = "partition_" + std::to_string(::getpid()) + ".tsv";
+        const std::string prefix = input + ".";
+        FILE *fp = fopen(input.data(), "wb");
+        REQUIRE(fp != nullptr);
+        fwrite(data.data(), 1, data.size(), fp);
+        fclose(fp);
+
+        const int fd = ::open(input.data(), O_RDONLY);
+        REQUIRE(fd >= 0);
+        aquahash::Partitioner partitioner(options);
+        CHECK(partitioner(fd, prefix));
+        ::close(fd);
+        ::unlink(input.data());
+
+        std::vector<std::string> outputs;
+        size_t records = 0;
+        for (size_t part = 0; part < options.partitions; ++part) {
+            const std::string path = prefix + std::to_string(part);
+            aquahash::MappedFile file;
+            REQUIRE(file.open(path));
+            outputs.emplace_back(reinterpret_cast<const char *>(file.data()), file.size());
+            ::unlink(path.data());
+            records += partitioner.records_per_partition()[part];
+        }
+        CHECK(records == partitioner.number_of_records());
+        return outputs;
+    }
+} // namespace
+
+TEST_CASE("Record field") {
+    const std::string record = "a\tbc\t\tdef";
+    auto field = [&record](const size_t idx) {
+        const auto key = aquahash::record_field(record.data(), record.size(), idx, '\t');
+        return std::string(key.first, key.second);
+    };
+    CHECK(field(0) == record);
+    CHECK(field(1) == "a");
+    CHECK(field(2) == "bc");
+    CHECK(field(3).empty());
+    CHECK(field(4) == "def");
+    CHECK(field(5).empty());
+}
+
+TEST_CASE("Partitioner") {
+    std::mt19937 gen(4);
+    const std::string data = random_records(20000, 100, gen);
+
+    SUBCASE("Key field") {
+        for (const size_t partitions : {1, 7, 16}) {
+            aquahash::PartitionOptions options;
+            options.partitions = partitions;
+            options.key_field = 2;
+            options.threads = 3;
+            CHECK(run_partitioner(data, options) == expected_partitions(data, partitions, 2));
+        }
+    }
+
+    SUBCASE("Small chunks and records which are longer than a chunk") {
+        const std::string long_records = random_records(200, 5000, gen) + "last\tkey1\twithout a delimiter";
+        for (const size_t chunk_size : {1, 37, 4096}) {
+            aquahash::PartitionOptions options;
+            options.partitions = 5;
+            options.key_field = 2;
+            options.threads = 2;
+            options.chunk_size = chunk_size;
+            CHECK(run_partitioner(long_records, options) == expected_partitions(long_records, 5, 2));
+        }
+    }
+
+    SUBCASE("Whole records and an empty input") {
+        aquahash::PartitionOptions options;
+        options.partitions = 4;
+        options.threads = 1;
+        CHECK(run_partitioner(data, options) == expected_partitions(data, 4, 0));
+        CHECK(run_partitioner("", options) == std::vector<std::string>(4));
+    }
+}
@@ -0,0 +1,65 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "perfect_hash.h"
+#include "utils.h"
+#include <string>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    std::vector<std::string> create_keys(const size_t N) {
+        aquahash::CharGenerator gen;
+        std::unordered_set<std::string> keys;
+        while (keys.size() < N) keys.emplace(gen(8 + keys.size() % 64));
+        return std::vector<std::string>(keys.begin(), keys.end());
+    }
+
+    bool is_minimal_perfect(const aquahash::PerfectHash &f, const std::vector<std::string> &keys) {
+        std::vector<bool> used(keys.size(), false);
+        for (auto const &key : keys) {
+            const size_t pos = f(key);
+            if (pos >= keys.size() || used[pos]) return false;
+            used[pos] = true;
+        }
+        return true;
+    }
+} // namespace
+
+TEST_CASE("Minimal perfect hash") {
+    const auto keys = create_keys(200000);
+    aquahash::PerfectHashBuilder builder(4);
+    aquahash::PerfectHash f;
+
+    SUBCASE("Build") {
+        CHECK(builder.build(keys, f));
+        CHECK(f.size() == keys.size());
+        CHECK(is_minimal_perfect(f, keys));
+    }
+
+    SUBCASE("Save and memory map") {
+        const std::string path = "perfect_hash_" + std::to_string(::getpid()) + ".bin";
+        CHECK(builder.build(keys, f));
+        CHECK(f.save(path));
+
+        aquahash::PerfectHash g;
+        CHECK(g.open(path));
+        CHECK(g.size() == keys.size());
+        CHECK(is_minimal_perfect(g, keys));
+        for (size_t idx = 0; idx < 1000; ++idx) CHECK(f(keys[idx]) == g(keys[idx]));
+        ::unlink(path.data());
+    }
+
+    SUBCASE("Small key sets") {
+        for (size_t n : {1, 2, 3, 10, 100}) {
+            const std::vector<std::string> small(keys.begin(), keys.begin() + n);
+            CHECK(builder.build(small, f));
+            CHECK(is_minimal_perfect(f, small));
+        }
+    }
+
+    SUBCASE("Duplicate keys") {
+        const std::vector<std::string> duplicates{"foo", "bar", "foo"};
+        CHECK(!builder.build(duplicates, f));
+    }
+}
@@ -0,0 +1,173 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aquahash.h"
+#include "doctest/doctest.h"
+#include "reader.h"
+#include "record_policy.h"
+#include "records.h"
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    struct Record {
+        std::string data;
+        uint64_t offset;
+        bool operator==(const Record &other) const { return data == other.data && offset == other.offset; }
+    };
+
+    std::vector<Record> expected_records(const std::string &data, const char delimiter, const size_t record_size) {
+        std::vector<Record> records;
+        size_t start = 0;
+        for (size_t pos = 0; pos < data.size(); ++pos) {
+            if (record_size ? (pos + 1 - start == record_size) : (data[pos] == delimiter)) {
+                const size_t end = record_size ? pos + 1 : pos;
+                records.push_back(Record{data.substr(start, end - start), start});
+                start = pos + 1;
+            }
+        }
+        if (start < data.size()) records.push_back(Record{data.substr(start), start});
+        return records;
+    }
+
+    // Split data passed in buffers of random sizes up to max_buffer bytes.
+    std::vector<Record> split(const std::string &data, const char delimiter, const size_t record_size,
+                              const size_t max_buffer, std::mt19937 &gen) {
+        std::vector<Record> records;
+        auto collect = [&records](const char *record, const size_t len, const uint64_t offset) {
+            records.push_back(Record{std::string(record, len), offset});
+        };
+        aquahash::RecordSplitter splitter(delimiter, record_size);
+        for (size_t pos = 0; pos < data.size();) {
+            const size_t len = std::min<size_t>(data.size() - pos, 1 + gen() % max_buffer);
+            splitter(data.data() + pos, len, collect);
+            pos += len;
+        }
+        splitter.finish(collect);
+        return records;
+    }
+
+    // Random lines with lengths between 0 and max_length.
+    std::string random_lines(const size_t number_of_lines, const size_t max_length, std::mt19937 &gen) {
+        std::string data;
+        for (size_t line = 0; line < number_of_lines; ++line) {
+            const size_t len = gen() % (max_length + 1);
+            for (size_t idx = 0; idx < len; ++idx) data.push_back(static_cast<char>('a' + gen() % 26));
+            data.push_back('\n');
+        }
+        return data;
+    }
+} // namespace
+
+TEST_CASE("Delimiter mask") {
+    std::string block(64, 'x');
+    CHECK(aquahash::delimiter_mask(block.data(), '\n') == 0);
+    block[0] = block[17] = block[63] = '\n';
+    CHECK(aquahash::delimiter_mask(block.data(), '\n') == ((uint64_t(1) << 63) | (uint64_t(1) << 17) | 1));
+    block[5] = static_cast<char>(0xff);
+    CHECK(aquahash::delimiter_mask(block.data(), static_cast<char>(0xff)) == (uint64_t(1) << 5));
+}
+
+TEST_CASE("Record splitter") {
+    std::mt19937 gen(1);
+
+    SUBCASE("Lines") {
+        const std::string data = random_lines(2000, 150, gen);
+        for (const size_t max_buffer : {1, 7, 64, 100, 1000, 1 << 16}) {
+            CHECK(split(data, '\n', 0, max_buffer, gen) == expected_records(data, '\n', 0));
+        }
+    }
+
+    SUBCASE("Long lines span many buffers") {
+        const std::string data = random_lines(50, 5000, gen) + "last line without a delimiter";
+        CHECK(split(data, '\n', 0, 300, gen) == expected_records(data, '\n', 0));
+    }
+
+    SUBCASE("Empty records and other delimiters") {
+        const std::string data = std::string("\0\0a\0bc\0\0", 8) + std::string(200, '\0');
+        CHECK(split(data, '\0', 0, 13, gen) == expected_records(data, '\0', 0));
+        CHECK(split("", '\n', 0, 13, gen).empty());
+        const auto records = split("\n", '\n', 0, 13, gen);
+        CHECK(records.size() == 1);
+        CHECK(records[0].data.empty());
+    }
+
+    SUBCASE("The last record stays valid after finish") {
+        aquahash::RecordSplitter splitter;
+        const char *ptr = nullptr;
+        size_t len = 0;
+        splitter("ab\ncd", 5, [](const char *, const size_t, const uint64_t) {});
+        splitter.finish([&](const char *record, const size_t n, const uint64_t) {
+            ptr = record;
+            len = n;
+        });
+        REQUIRE(ptr != nullptr);
+        CHECK(std::string(ptr, len) == "cd");
+    }
+
+    SUBCASE("Fixed size records") {
+        const std::string data = random_lines(500, 100, gen);
+        for (const size_t record_size : {1, 10, 64, 1000, 100000}) {
+            for (const size_t max_buffer : {1, 33, 4096}) {
+                CHECK(split(data, '\n', record_size, max_buffer, gen) == expected_records(data, '\n', record_size));
+            }
+        }
+    }
+}
+
+TEST_CASE("Record policy") {
+    std::mt19937 gen(2);
+    const std::string path = "records_" + std::to_string(::getpid()) + ".txt";
+    const std::string data = random_lines(10000, 100, gen);
+    FILE *fp = fopen(path.data(), "wb");
+    REQUIRE(fp != nullptr);
+    fwrite(data.data(), 1, data.size(), fp);
+    fclose(fp);
+    const auto records = expected_records(data, '\n', 0);
+
+    aquahash::AquaHashWriter writer;
+
+    SUBCASE("Offsets and digests") {
+        aquahash::RecordOptions options;
+        options.output = tmpfile();
+        REQUIRE(options.output != nullptr);
+        options.prefix = "file:";
+        aquahash::FileReader<aquahash::RecordPolicy> reader(options);
+        CHECK(reader(path.data()));
+        CHECK(reader.good());
+        CHECK(reader.number_of_records() == records.size());
+
+        rewind(options.output);
+        char line[256];
+        for (auto const &record : records) {
+            REQUIRE(fgets(line, sizeof(line), options.output) != nullptr);
+            const __m128i digest =
+                AquaHash::Hash(reinterpret_cast<const uint8_t *>(record.data.data()), record.data.size());
+            CHECK(std::string(line) == "file:" + std::to_string(record.offset) + "\t" + writer(digest) + "\n");
+        }
+        CHECK(fgets(line, sizeof(line), options.output) == nullptr);
+        fclose(options.output);
+    }
+
+    SUBCASE("Binary digests") {
+        aquahash::RecordOptions options;
+        options.output = tmpfile();
+        REQUIRE(options.output != nullptr);
+        options.binary = true;
+        aquahash::FileReader<aquahash::RecordPolicy> reader(options);
+        CHECK(reader(path.data()));
+        CHECK(ftell(options.output) == static_cast<long>(records.size() * sizeof(__m128i)));
+
+        rewind(options.output);
+        for (auto const &record : records) {
+            __m128i digest;
+            REQUIRE(fread(&digest, sizeof(digest), 1, options.output) == 1);
+            const __m128i expected =
+                AquaHash::Hash(reinterpret_cast<const uint8_t *>(record.data.data()), record.data.size());
+            CHECK(writer(digest) == writer(expected));
+        }
+        fclose(options.output);
+    }
+
+    ::unlink(path.data());
+}
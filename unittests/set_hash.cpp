@@ -0,0 +1,106 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "interface.h"
+#include "parallel.h"
+#include "set_hash.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    std::vector<std::string> create_keys(const size_t n) {
+        std::vector<std::string> keys;
+        for (size_t idx = 0; idx < n; ++idx) keys.push_back("key:" + std::to_string(idx));
+        return keys;
+    }
+
+    bool equal(const __m128i first, const __m128i second) { return memcmp(&first, &second, sizeof(first)) == 0; }
+
+    template <typename Iterator> __m128i set_digest(Iterator first, Iterator last) {
+        aquahash::SetHash accumulator;
+        for (; first != last; ++first) accumulator.add(*first);
+        return accumulator.digest();
+    }
+} // namespace
+
+TEST_CASE("Set hash") {
+    std::mt19937 gen(50);
+    auto keys = create_keys(10000);
+    const __m128i expected = set_digest(keys.begin(), keys.end());
+
+    SUBCASE("Order independence") {
+        for (size_t trial = 0; trial < 5; ++trial) {
+            std::shuffle(keys.begin(), keys.end(), gen);
+            CHECK(equal(set_digest(keys.begin(), keys.end()), expected));
+        }
+        CHECK_FALSE(equal(set_digest(keys.begin() + 1, keys.end()), expected));
+        CHECK_FALSE(equal(aquahash::SetHash().digest(), expected));
+    }
+
+    SUBCASE("Add and remove") {
+        aquahash::SetHash accumulator;
+        for (auto const &key : keys) accumulator.add(key);
+        accumulator.add(std::string("extra"));
+        CHECK(accumulator.size() == keys.size() + 1);
+        CHECK_FALSE(equal(accumulator.digest(), expected));
+        accumulator.remove(std::string("extra"));
+        CHECK(accumulator.size() == keys.size());
+        CHECK(equal(accumulator.digest(), expected));
+
+        // A multiset counts every copy.
+        accumulator.add(keys[0]);
+        CHECK_FALSE(equal(accumulator.digest(), expected));
+        accumulator.remove(keys[0]);
+        CHECK(equal(accumulator.digest(), expected));
+    }
+
+    SUBCASE("Merge and batch update") {
+        constexpr size_t PARTS = 8;
+        std::vector<aquahash::SetHash> parts(PARTS);
+        aquahash::parallel_for(PARTS, 4, [&](const size_t part, const size_t) {
+            for (size_t idx = part; idx < keys.size(); idx += PARTS) parts[part].add(keys[idx]);
+        });
+        aquahash::SetHash merged;
+        for (auto const &part : parts) merged.merge(part);
+        CHECK(merged.size() == keys.size());
+        CHECK(equal(merged.digest(), expected));
+
+        static __m128i digests[10000];
+        for (size_t idx = 0; idx < keys.size(); ++idx) digests[idx] = aquahash::digest_of(keys[idx]);
+        for (size_t n : {0, 1, 3, 4, 7}) {
+            aquahash::SetHash batch, single;
+            batch.add_batch(digests, n);
+            for (size_t idx = 0; idx < n; ++idx) single.add(digests[idx]);
+            CHECK(batch == single);
+        }
+        aquahash::SetHash batch;
+        batch.add_batch(digests, keys.size());
+        CHECK(batch == merged);
+    }
+}
+
+TEST_CASE("Hash function for unordered sets") {
+    const auto keys = create_keys(1000);
+    std::unordered_set<std::string> first(keys.begin(), keys.end());
+    std::unordered_set<std::string, aquahash::hash<std::string>> second(keys.rbegin(), keys.rend());
+    second.rehash(4096);
+
+    const aquahash::hash<std::unordered_set<std::string>> first_hash;
+    const aquahash::hash<std::unordered_set<std::string, aquahash::hash<std::string>>> second_hash;
+    CHECK(equal(first_hash.digest(first), second_hash.digest(second)));
+    CHECK(first_hash(first) == second_hash(second));
+    CHECK(equal(first_hash.digest(first), set_digest(keys.begin(), keys.end())));
+
+    first.erase(keys[10]);
+    CHECK(first_hash(first) != second_hash(second));
+    CHECK(first_hash(std::unordered_set<std::string>()) != first_hash(std::unordered_set<std::string>{""}));
+
+    // Sets of sets.
+    std::unordered_set<std::unordered_set<std::string>, aquahash::hash<std::unordered_set<std::string>>> sets;
+    sets.insert(first);
+    sets.insert(std::unordered_set<std::string>(first.begin(), first.end()));
+    CHECK(sets.size() == 1);
+}
@@ -0,0 +1,143 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aquahash.h"
+#include "doctest/doctest.h"
+#include "mapped_file.h"
+#include "uniq.h"
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    // Lines drawn from a small vocabulary so there are many duplicates.
+    std::string random_lines(const size_t number_of_lines, const size_t vocabulary, std::mt19937 &gen) {
+        std::string data;
+        for (size_t line = 0; line < number_of_lines; ++line) {
+            const size_t word = gen() % vocabulary;
+            data += "line " + std::to_string(word) + std::string(word % 50, 'x') + "\n";
+        }
+        return data;
+    }
+
+    std::string expected_uniq(const std::string &data, const char delimiter) {
+        std::unordered_set<std::string> seen;
+        std::string output;
+        size_t start = 0;
+        while (start < data.size()) {
+            size_t end = data.find(delimiter, start);
+            if (end == std::string::npos) end = data.size();
+            const std::string record = data.substr(start, end - start);
+            if (seen.insert(record).second) output += record + delimiter;
+            start = end + 1;
+        }
+        return output;
+    }
+
+    std::string run_uniq(const std::string &data, const aquahash::UniqOptions &options, size_t *partitions) {
+        const std::string path = "uniq_" + std::to_string(::getpid()) + ".out";
+        aquahash::FileWriter writer;
+        REQUIRE(writer.open(path));
+        aquahash::Uniq uniq(options);
+        CHECK(uniq(reinterpret_cast<const uint8_t *>(data.data()), data.size(), writer));
+        CHECK(writer.close());
+        *partitions = uniq.number_of_partitions();
+
+        aquahash::MappedFile file;
+        REQUIRE(file.open(path));
+        const std::string output(reinterpret_cast<const char *>(file.data()), file.size());
+        ::unlink(path.data());
+        return output;
+    }
+} // namespace
+
+TEST_CASE("Digest set") {
+    aquahash::DigestSet set(true);
+    uint64_t existing = 0;
+    auto item = [](const uint64_t key, const uint64_t offset) {
+        const __m128i digest = AquaHash::Hash(reinterpret_cast<const uint8_t *>(&key), sizeof(key));
+        return aquahash::HashedRecord{aquahash::low_bits(digest), aquahash::high_bits(digest), offset};
+    };
+    for (uint64_t idx = 0; idx < 10000; ++idx) CHECK(set.insert(item(idx, idx), existing));
+    CHECK(set.size() == 10000);
+
+    for (uint64_t idx = 0; idx < 10000; idx += 7) {
+        CHECK_FALSE(set.insert(item(idx, 0), existing));
+        CHECK(existing == idx);
+    }
+
+    // The zero digest is the empty slot marker and is handled separately.
+    CHECK(set.insert(aquahash::HashedRecord{0, 0, 42}, existing));
+    CHECK_FALSE(set.insert(aquahash::HashedRecord{0, 0, 43}, existing));
+    CHECK(existing == 42);
+    CHECK(set.size() == 10001);
+
+    size_t count = 0;
+    set.for_each([&count](const aquahash::HashedRecord &) { ++count; });
+    CHECK(count == 10001);
+}
+
+TEST_CASE("Uniq") {
+    std::mt19937 gen(3);
+    const std::string data = random_lines(50000, 5000, gen);
+    const std::string expected = expected_uniq(data, '\n');
+    size_t partitions = 0;
+
+    SUBCASE("In memory") {
+        aquahash::UniqOptions options;
+        CHECK(run_uniq(data, options, &partitions) == expected);
+        CHECK(partitions == 0);
+        options.verify = true;
+        CHECK(run_uniq(data, options, &partitions) == expected);
+    }
+
+    SUBCASE("Partitioned") {
+        aquahash::UniqOptions options;
+        options.memory = 1 << 12;
+        options.threads = 3;
+        options.temp_dir = ".";
+        CHECK(run_uniq(data, options, &partitions) == expected);
+        CHECK(partitions > 1);
+        options.verify = true;
+        CHECK(run_uniq(data, options, &partitions) == expected);
+        CHECK(partitions > 1);
+    }
+
+    SUBCASE("Partitions which outgrow the memory of a thread are split again") {
+        const std::string distinct = random_lines(100000, 1000000, gen);
+        aquahash::UniqOptions options;
+        options.memory = 1 << 16;
+        options.threads = 2;
+        options.temp_dir = ".";
+        CHECK(run_uniq(distinct, options, &partitions) == expected_uniq(distinct, '\n'));
+        CHECK(partitions > 16);
+        options.verify = true;
+        CHECK(run_uniq(distinct, options, &partitions) == expected_uniq(distinct, '\n'));
+    }
+
+    SUBCASE("Last record without a delimiter and other delimiters") {
+        aquahash::UniqOptions options;
+        CHECK(run_uniq("a\nb\na\nb", options, &partitions) == "a\nb\n");
+        CHECK(run_uniq("", options, &partitions).empty());
+        options.delimiter = '\0';
+        const std::string records("x\0y\0\0x\0\0", 9);
+        CHECK(run_uniq(records, options, &partitions) == expected_uniq(records, '\0'));
+    }
+
+    SUBCASE("Fixed size records") {
+        aquahash::UniqOptions options;
+        options.record_size = 4;
+        CHECK(run_uniq("abcdabcdefghabcdefgh12", options, &partitions) == "abcdefgh12");
+        options.memory = 1 << 8;
+        options.temp_dir = ".";
+        std::string blocks;
+        for (size_t idx = 0; idx < 20000; ++idx) blocks += std::to_string(1000 + gen() % 3000);
+        std::string unique;
+        std::unordered_set<std::string> seen;
+        for (size_t pos = 0; pos < blocks.size(); pos += 4) {
+            if (seen.insert(blocks.substr(pos, 4)).second) unique += blocks.substr(pos, 4);
+        }
+        CHECK(run_uniq(blocks, options, &partitions) == unique);
+        CHECK(partitions > 1);
+    }
+}